@@ -22,7 +22,6 @@
 #include <cassert>
 #include <list>
 #include <map>
-#include <semaphore.h>
 #include <signal.h>
 #include <string>
 #include <sys/types.h>
@@ -310,9 +309,6 @@ namespace Wayland {
             , _pointer(nullptr)
             , _touch(nullptr)
             , _shell(nullptr)
-            , _trigger()
-            , _redraw()
-            , _tid()
             , _displayName(displayName)
             , _displayId()
             , _keyboardReceiver(nullptr)
@@ -660,16 +656,6 @@ namespace Wayland {
             return _eglDisplay;
         }
 
-        inline void Trigger()
-        {
-            sem_post(&_trigger);
-        }
-
-        inline void Redraw()
-        {
-            sem_post(&_redraw);
-        }
-
     private:
         void Initialize();
         void Deinitialize();
@@ -814,15 +800,10 @@ namespace Wayland {
         uint32_t _keyDelay;
         uint32_t _keyModifiers;
 
-        sem_t _trigger;
-        sem_t _redraw;
-
     private:
         friend class Surface;
         friend class Image;
 
-        pthread_t _tid;
-
         std::string _displayName;
         std::string _displayId;
         SurfaceImplementation* _keyboardReceiver;
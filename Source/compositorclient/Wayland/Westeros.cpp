@@ -616,10 +616,11 @@ namespace Wayland {
 
     void Display::SurfaceImplementation::Redraw()
     {
-        _display->Trigger();
+        // Flushed and swapped on the rendering thread itself: libwayland serializes the writes on the
+        // connection and EGL reads its events through a queue of its own (wl_display_prepare_read_queue),
+        // next to the dispatching of the display queue in Process().
+        wl_display_flush(_display->_display);
 
-        // wait for wayland to flush events
-        sem_wait(&(_display->_redraw));
         if (_native != nullptr) {
             eglSwapBuffers(_display->_eglDisplay, _eglSurfaceWindow);
         }
@@ -750,18 +751,6 @@ namespace Wayland {
 	}
     }
 
-    static void* Processor(void* data)
-    {
-        Wayland::Display& context = *(static_cast<Wayland::Display*>(data));
-
-        while ((sem_wait(&context._trigger) == 0) && (context._display != nullptr)) {
-            Trace("Flush Events\n");
-            wl_display_flush(context._display);
-
-            context.Redraw();
-        }
-        return nullptr;
-    }
     Display::~Display()
     {
         ASSERT(_refCount == 0);
@@ -806,14 +795,6 @@ namespace Wayland {
 
                 wl_registry_add_listener(_registry, &globalRegistryListener, this);
                 wl_display_roundtrip(_display);
-
-                sem_init(&_trigger, 0, 0);
-                sem_init(&_redraw, 0, 0);
-
-                Trace("creating communication thread\n");
-                if (pthread_create(&_tid, nullptr, Processor, this) != 0) {
-                    Trace("[Wayland] Error creating communication thread\n");
-                }
             }
         }
     }
@@ -985,10 +966,6 @@ namespace Wayland {
             _display = nullptr;
         }
         _adminLock.Unlock();
-
-        Trigger();
-
-        pthread_join(_tid, nullptr);
     }
 
     void Display::LoadSurfaces()
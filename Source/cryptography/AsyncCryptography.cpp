@@ -0,0 +1,239 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "AsyncCryptography.h"
+
+#include <algorithm>
+
+#ifdef __LINUX__
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+namespace WPEFramework {
+
+namespace Cryptography {
+
+    AsyncCryptography::AsyncCryptography(const uint8_t workers, const bool deferred)
+        : _deferred(deferred)
+        , _descriptor(-1)
+        , _lock()
+        , _signal()
+        , _jobs()
+        , _busy()
+        , _completed()
+        , _workers()
+        , _stopping(false)
+    {
+        ASSERT(workers > 0);
+
+#ifdef __LINUX__
+        if (_deferred == true) {
+            _descriptor = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+            if (_descriptor == -1) {
+                TRACE_L1("Failed to create the completion descriptor, completions have to be polled for");
+            }
+        }
+#endif
+
+        for (uint8_t index = 0; index < std::max(workers, static_cast<uint8_t>(1)); index++) {
+            _workers.emplace_back(&AsyncCryptography::Worker, this);
+        }
+    }
+
+    AsyncCryptography::~AsyncCryptography()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _stopping = true;
+        }
+
+        _signal.notify_all();
+
+        for (std::thread& worker : _workers) {
+            worker.join();
+        }
+
+        ASSERT(_jobs.empty() == true);
+
+#ifdef __LINUX__
+        if (_descriptor != -1) {
+            ::close(_descriptor);
+        }
+#endif
+    }
+
+    uint32_t AsyncCryptography::Dispatch()
+    {
+        std::vector<Completed> completed;
+
+#ifdef __LINUX__
+        if (_descriptor != -1) {
+            uint64_t count;
+            // Reset before taking the completions, so the ones added meanwhile signal again.
+            VARIABLE_IS_NOT_USED ssize_t consumed = ::read(_descriptor, &count, sizeof(count));
+        }
+#endif
+
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            completed.swap(_completed);
+        }
+
+        for (const Completed& entry : completed) {
+            entry.first(entry.second);
+        }
+
+        return (static_cast<uint32_t>(completed.size()));
+    }
+
+    void AsyncCryptography::Submit(const Core::IUnknown* object, const Operation& operation, const Completion& completion)
+    {
+        ASSERT(object != nullptr);
+        ASSERT(operation != nullptr);
+
+        // The object is kept alive until its operation has run.
+        object->AddRef();
+
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+
+            ASSERT(_stopping == false);
+
+            _jobs.push_back({ object, operation, completion });
+        }
+
+        _signal.notify_one();
+    }
+
+    void AsyncCryptography::Ingest(IHash* hash, const uint32_t length, const uint8_t data[], const Completion& completion)
+    {
+        Submit(hash, [=]() -> int32_t { return (hash->Ingest(length, data)); }, completion);
+    }
+
+    void AsyncCryptography::Calculate(IHash* hash, const uint8_t maxLength, uint8_t data[], const Completion& completion)
+    {
+        Submit(hash, [=]() -> int32_t { return (hash->Calculate(maxLength, data)); }, completion);
+    }
+
+    void AsyncCryptography::Encrypt(const ICipher* cipher, const uint8_t ivLength, const uint8_t iv[],
+        const uint32_t inputLength, const uint8_t input[],
+        const uint32_t maxOutputLength, uint8_t output[], const Completion& completion)
+    {
+        Submit(cipher, [=]() -> int32_t { return (cipher->Encrypt(ivLength, iv, inputLength, input, maxOutputLength, output)); }, completion);
+    }
+
+    void AsyncCryptography::Decrypt(const ICipher* cipher, const uint8_t ivLength, const uint8_t iv[],
+        const uint32_t inputLength, const uint8_t input[],
+        const uint32_t maxOutputLength, uint8_t output[], const Completion& completion)
+    {
+        Submit(cipher, [=]() -> int32_t { return (cipher->Decrypt(ivLength, iv, inputLength, input, maxOutputLength, output)); }, completion);
+    }
+
+    void AsyncCryptography::Generate(IDiffieHellman* diffieHellman, const uint8_t generator, const uint16_t modulusSize, const uint8_t modulus[],
+        uint32_t& privKeyId, uint32_t& pubKeyId, const Completion& completion)
+    {
+        uint32_t* privKey = &privKeyId;
+        uint32_t* pubKey = &pubKeyId;
+
+        Submit(diffieHellman, [=]() -> int32_t { return (diffieHellman->Generate(generator, modulusSize, modulus, *privKey, *pubKey)); }, completion);
+    }
+
+    void AsyncCryptography::Derive(IDiffieHellman* diffieHellman, const uint32_t privateKey, const uint32_t peerPublicKeyId,
+        uint32_t& secretId, const Completion& completion)
+    {
+        uint32_t* secret = &secretId;
+
+        Submit(diffieHellman, [=]() -> int32_t { return (diffieHellman->Derive(privateKey, peerPublicKeyId, *secret)); }, completion);
+    }
+
+    bool AsyncCryptography::IsBusy(const Core::IUnknown* object) const
+    {
+        return (std::find(_busy.begin(), _busy.end(), object) != _busy.end());
+    }
+
+    void AsyncCryptography::Complete(const Completion& completion, const int32_t result)
+    {
+        if (completion != nullptr) {
+            if (_deferred == false) {
+                completion(result);
+            } else {
+                {
+                    std::lock_guard<std::mutex> lock(_lock);
+                    _completed.emplace_back(completion, result);
+                }
+
+#ifdef __LINUX__
+                if (_descriptor != -1) {
+                    const uint64_t count = 1;
+                    VARIABLE_IS_NOT_USED ssize_t written = ::write(_descriptor, &count, sizeof(count));
+                }
+#endif
+            }
+        }
+    }
+
+    void AsyncCryptography::Worker()
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+
+        while (true) {
+            // The oldest job on an object no other worker is busy with, this keeps the jobs per object in order.
+            std::list<Job>::iterator entry = std::find_if(_jobs.begin(), _jobs.end(),
+                [this](const Job& job) { return (IsBusy(job.object) == false); });
+
+            if (entry != _jobs.end()) {
+                Job job(std::move(*entry));
+                _jobs.erase(entry);
+                _busy.push_back(job.object);
+
+                lock.unlock();
+
+                const int32_t result = job.operation();
+
+                Complete(job.completion, result);
+
+                lock.lock();
+
+                // Out of the busy list before the reference is dropped, a new object at the same address
+                // must not be held back by this job.
+                _busy.erase(std::find(_busy.begin(), _busy.end(), job.object));
+
+                // Jobs held back for this object can be picked up now.
+                if (_jobs.empty() == false) {
+                    _signal.notify_all();
+                }
+
+                lock.unlock();
+
+                job.object->Release();
+
+                lock.lock();
+            } else if ((_stopping == true) && (_jobs.empty() == true)) {
+                break;
+            } else {
+                _signal.wait(lock);
+            }
+        }
+    }
+
+} // namespace Cryptography
+
+} // namespace WPEFramework
@@ -0,0 +1,114 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Module.h"
+#include "ICryptography.h"
+
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace WPEFramework {
+
+namespace Cryptography {
+
+    // Runs the (blocking) cryptography calls on a pool of worker threads, so the calling thread can
+    // carry on meanwhile. Every call returns immediately, the return value of the operation is passed
+    // to the completion. Operations on the same object run in the order they were submitted, operations
+    // on different objects run side by side (for remote objects they are in flight over RPC together).
+    // Buffers passed in must stay valid until the completion of the operation has been called.
+    class EXTERNAL AsyncCryptography {
+    public:
+        using Completion = std::function<void(const int32_t result)>;
+        using Operation = std::function<int32_t()>;
+
+    private:
+        struct Job {
+            const Core::IUnknown* object;
+            Operation operation;
+            Completion completion;
+        };
+
+        using Completed = std::pair<Completion, int32_t>;
+
+    public:
+        AsyncCryptography() = delete;
+        AsyncCryptography(const AsyncCryptography&) = delete;
+        AsyncCryptography& operator=(const AsyncCryptography&) = delete;
+
+        // With deferred set, completions are not called on the worker threads but queued, Descriptor()
+        // becomes readable and Dispatch() calls them on the thread polling the descriptor (e.g. the UI thread).
+        AsyncCryptography(const uint8_t workers, const bool deferred = false);
+
+        // Operations still queued are run, deferred completions not dispatched yet are dropped.
+        ~AsyncCryptography();
+
+    public:
+        // Readable while deferred completions are pending, -1 if not available.
+        int Descriptor() const
+        {
+            return (_descriptor);
+        }
+
+        // Call the deferred completions pending (returns the number called)
+        uint32_t Dispatch();
+
+        // Run any operation on object, in order with the other operations on that object
+        void Submit(const Core::IUnknown* object, const Operation& operation, const Completion& completion);
+
+        void Ingest(IHash* hash, const uint32_t length, const uint8_t data[], const Completion& completion);
+        void Calculate(IHash* hash, const uint8_t maxLength, uint8_t data[], const Completion& completion);
+
+        void Encrypt(const ICipher* cipher, const uint8_t ivLength, const uint8_t iv[],
+                     const uint32_t inputLength, const uint8_t input[],
+                     const uint32_t maxOutputLength, uint8_t output[], const Completion& completion);
+        void Decrypt(const ICipher* cipher, const uint8_t ivLength, const uint8_t iv[],
+                     const uint32_t inputLength, const uint8_t input[],
+                     const uint32_t maxOutputLength, uint8_t output[], const Completion& completion);
+
+        void Generate(IDiffieHellman* diffieHellman, const uint8_t generator, const uint16_t modulusSize, const uint8_t modulus[],
+                      uint32_t& privKeyId, uint32_t& pubKeyId, const Completion& completion);
+        void Derive(IDiffieHellman* diffieHellman, const uint32_t privateKey, const uint32_t peerPublicKeyId,
+                    uint32_t& secretId, const Completion& completion);
+
+    private:
+        void Worker();
+        void Complete(const Completion& completion, const int32_t result);
+        bool IsBusy(const Core::IUnknown* object) const;
+
+    private:
+        const bool _deferred;
+        int _descriptor;
+        std::mutex _lock;
+        std::condition_variable _signal;
+        std::list<Job> _jobs;
+        std::vector<const Core::IUnknown*> _busy;
+        std::vector<Completed> _completed;
+        std::vector<std::thread> _workers;
+        bool _stopping;
+    };
+
+} // namespace Cryptography
+
+} // namespace WPEFramework
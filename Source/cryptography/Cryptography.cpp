@@ -24,9 +24,13 @@
 #include "implementation/cipher_implementation.h"
 #include "implementation/diffiehellman_implementation.h"
 #include "implementation/hash_implementation.h"
+#include "implementation/keyagreement_implementation.h"
 #include "implementation/vault_implementation.h"
 #include "implementation/persistent_implementation.h"
 
+#include <array>
+#include <thread>
+
 #include <com/com.h>
 #include <plugins/Types.h>
 
@@ -40,6 +44,137 @@ namespace Implementation {
     struct IRPCLink {
         virtual ~IRPCLink() = default;
         virtual void Clear() = 0;
+
+    private:
+        friend class LinkRegistry;
+
+        IRPCLink* _previous = nullptr;
+        IRPCLink* _next = nullptr;
+        bool _pinned = false;
+    };
+
+    // Keeps track of every proxy wrapper handed out, so a lost connection can detach them all.
+    // The wrappers are linked in intrusively and spread over shards, so adding a wrapper on
+    // creation and removing it on destruction is O(1) and creating threads hardly contend.
+    class LinkRegistry {
+    private:
+        static constexpr uint8_t SHARDS = 16;
+
+        struct alignas(64) Shard {
+            Core::CriticalSection lock;
+            IRPCLink* head = nullptr;
+        };
+
+        LinkRegistry() = default;
+
+    public:
+        LinkRegistry(const LinkRegistry&) = delete;
+        LinkRegistry& operator=(const LinkRegistry&) = delete;
+
+        // Not part of the CryptographyLink singleton, wrappers may outlive the link.
+        static LinkRegistry& Instance()
+        {
+            static LinkRegistry registry;
+            return (registry);
+        }
+
+    public:
+        void Add(IRPCLink* link)
+        {
+            Shard& shard(Lookup(link));
+
+            shard.lock.Lock();
+
+            link->_previous = nullptr;
+            link->_next = shard.head;
+
+            if (shard.head != nullptr) {
+                shard.head->_previous = link;
+            }
+
+            shard.head = link;
+
+            shard.lock.Unlock();
+        }
+        void Remove(IRPCLink* link)
+        {
+            Shard& shard(Lookup(link));
+
+            shard.lock.Lock();
+
+            // The link may be in the middle of being cleared, it has to stay until that is done.
+            while (link->_pinned == true) {
+                shard.lock.Unlock();
+                std::this_thread::yield();
+                shard.lock.Lock();
+            }
+
+            if (link->_previous != nullptr) {
+                link->_previous->_next = link->_next;
+            } else {
+                shard.head = link->_next;
+            }
+
+            if (link->_next != nullptr) {
+                link->_next->_previous = link->_previous;
+            }
+
+            shard.lock.Unlock();
+        }
+        void Clear()
+        {
+            for (Shard& shard : _shards) {
+                shard.lock.Lock();
+
+                IRPCLink* link = shard.head;
+
+                while (link != nullptr) {
+                    // Clearing waits for the calls in flight, which may be creating new wrappers
+                    // themselves, so the shard is not locked meanwhile. Pinning keeps the link
+                    // (and with that the position in the list) valid.
+                    link->_pinned = true;
+                    shard.lock.Unlock();
+
+                    link->Clear();
+
+                    shard.lock.Lock();
+                    link->_pinned = false;
+                    link = link->_next;
+                }
+
+                shard.lock.Unlock();
+            }
+        }
+
+    private:
+        Shard& Lookup(const IRPCLink* link)
+        {
+            return (_shards[(reinterpret_cast<uintptr_t>(link) >> 6) & (SHARDS - 1)]);
+        }
+
+    private:
+        std::array<Shard, SHARDS> _shards;
+    };
+
+    // Adds the wrapper to the registry for its entire lifetime. Being the most derived class,
+    // it is removed before any of the members of the wrapper are destructed.
+    template <typename TYPE>
+    class LinkType : public TYPE {
+    public:
+        LinkType() = delete;
+        LinkType(const LinkType<TYPE>&) = delete;
+        LinkType<TYPE>& operator=(const LinkType<TYPE>&) = delete;
+
+        template <typename... Args>
+        LinkType(Args&&... args)
+            : TYPE(std::forward<Args>(args)...)
+        {
+            LinkRegistry::Instance().Add(this);
+        }
+        ~LinkType() override
+        {
+            LinkRegistry::Instance().Remove(this);
+        }
     };
 
     class CryptographyLink : public RPC::SmartInterfaceType<PluginHost::IPlugin> {
@@ -49,13 +184,12 @@ namespace Implementation {
     public:
         CryptographyLink(const uint32_t waitTime, const Core::NodeId& thunder, const string& callsign)
             : BaseClass()
-            , _adminLock()
         {
             BaseClass::Open(waitTime, thunder, callsign);
         }
         ~CryptographyLink() override
         {
-            _interfaces.Clear();
+            LinkRegistry::Instance().Clear();
             BaseClass::Close(Core::infinite);
         }
         static CryptographyLink& Instance(const std::string& callsign = Callsign)
@@ -68,35 +202,139 @@ namespace Implementation {
         }
         Cryptography::ICryptography* Cryptography(const std::string& connectionPoint);
 
-        template <typename TYPE, typename... Args>
-        Core::ProxyType<Core::Service<TYPE>> Register(Args&&... args)
+        // Wraps a remote interface, the reference passed in is taken over by the wrapper.
+        // The wrapper is gone as soon as the caller releases it.
+        template <typename TYPE, typename INTERFACE>
+        INTERFACE* Register(INTERFACE* iface)
         {
-            Core::SafeSyncType<Core::CriticalSection> lock(_adminLock);
-            return _interfaces.template Instance<Core::Service<TYPE>>(std::forward<Args>(args)...);
+            INTERFACE* result = Core::Service<LinkType<TYPE>>::template Create<INTERFACE>(iface);
+
+            iface->Release();
+
+            return (result);
         }
 
     private:
         void Operational(const bool upAndRunning) override
         {
             if (upAndRunning == false) {
-                Core::SafeSyncType<Core::CriticalSection> lock(_adminLock);
-                _interfaces.Clear();
+                LinkRegistry::Instance().Clear();
+            }
+        }
+    };
+
+    // Keeps a remote interface alive for the duration of the calls made on it, without
+    // serializing those calls. A call only registers itself as a user of the interface,
+    // Clear() detaches the interface and waits for the calls still in flight to drain
+    // before it is released.
+    template <typename INTERFACE>
+    class AccessorType {
+    public:
+        class Guard {
+        public:
+            Guard() = delete;
+            Guard(const Guard&) = delete;
+            Guard& operator=(const Guard&) = delete;
+
+            Guard(const AccessorType<INTERFACE>& parent)
+                : _parent(parent)
+                , _accessor(parent.Acquire())
+            {
+            }
+            ~Guard()
+            {
+                if (_accessor != nullptr) {
+                    _parent.Drop();
+                }
+            }
+
+        public:
+            bool IsValid() const
+            {
+                return (_accessor != nullptr);
+            }
+            INTERFACE* operator->() const
+            {
+                ASSERT(_accessor != nullptr);
+                return (_accessor);
+            }
+
+        private:
+            const AccessorType<INTERFACE>& _parent;
+            INTERFACE* _accessor;
+        };
+
+    public:
+        AccessorType() = delete;
+        AccessorType(const AccessorType<INTERFACE>&) = delete;
+        AccessorType<INTERFACE>& operator=(const AccessorType<INTERFACE>&) = delete;
+
+        AccessorType(INTERFACE* iface)
+            : _accessor(iface)
+            , _users(0)
+            , _drained(false, true)
+        {
+            if (iface != nullptr) {
+                iface->AddRef();
+            }
+        }
+        ~AccessorType()
+        {
+            Clear();
+        }
+
+    public:
+        void Clear()
+        {
+            INTERFACE* iface = _accessor.exchange(nullptr);
+
+            if (iface != nullptr) {
+                // Calls are still running on the interface, wait for the last one to drop it. The event
+                // may still be set from before, or set by a drop right before it is reset, so the count
+                // is checked again after every wake up rather than trusting the event.
+                while (_users.load() != 0) {
+                    _drained.Lock(Core::infinite);
+                    _drained.ResetEvent();
+                }
+
+                iface->Release();
+            }
+        }
+
+    private:
+        INTERFACE* Acquire() const
+        {
+            _users++;
+
+            INTERFACE* iface = _accessor.load();
+
+            if (iface == nullptr) {
+                Drop();
+            }
+
+            return (iface);
+        }
+        void Drop() const
+        {
+            if ((--_users == 0) && (_accessor.load() == nullptr)) {
+                _drained.SetEvent();
             }
         }
 
     private:
-        mutable Core::CriticalSection _adminLock;
-        Core::ProxyListType<IRPCLink> _interfaces;
+        std::atomic<INTERFACE*> _accessor;
+        mutable std::atomic<uint32_t> _users;
+        mutable Core::Event _drained;
     };
 
     class RPCDiffieHellmanImpl : public IRPCLink, public Cryptography::IDiffieHellman {
+    private:
+        using Accessor = AccessorType<Cryptography::IDiffieHellman>;
+
     public:
         RPCDiffieHellmanImpl(Cryptography::IDiffieHellman* iface)
             : _accessor(iface)
         {
-            if (_accessor != nullptr) {
-                _accessor->AddRef();
-            }
         }
         ~RPCDiffieHellmanImpl()
         {
@@ -112,38 +350,121 @@ namespace Implementation {
             const uint16_t modulusSize, const uint8_t modulus[],
             uint32_t& privKeyId, uint32_t& pubKeyId) override
         {
-            Core::SafeSyncType<Core::CriticalSection> lock(_adminLock);
-            return (_accessor != nullptr) ? _accessor->Generate(generator, modulusSize, modulus, privKeyId, pubKeyId) : 0;
+            Accessor::Guard accessor(_accessor);
+            return (accessor.IsValid() == true ? accessor->Generate(generator, modulusSize, modulus, privKeyId, pubKeyId) : 0);
         }
 
         uint32_t Derive(const uint32_t privateKey, const uint32_t peerPublicKeyId, uint32_t& secretId) override
         {
-            Core::SafeSyncType<Core::CriticalSection> lock(_adminLock);
-            return (_accessor != nullptr) ? _accessor->Derive(privateKey, peerPublicKeyId, secretId) : 0;
+            Accessor::Guard accessor(_accessor);
+            return (accessor.IsValid() == true ? accessor->Derive(privateKey, peerPublicKeyId, secretId) : 0);
         }
 
         void Clear() override
         {
-            if (_accessor != nullptr) {
-                Core::SafeSyncType<Core::CriticalSection> lock(_adminLock);
-                _accessor->Release();
-                _accessor = nullptr;
-            }
+            _accessor.Clear();
+        }
+
+    private:
+        Accessor _accessor;
+    };
+
+    class RPCAuthenticatedCipherImpl : public IRPCLink, public Cryptography::IAuthenticatedCipher {
+    private:
+        using Accessor = AccessorType<Cryptography::IAuthenticatedCipher>;
+
+    public:
+        RPCAuthenticatedCipherImpl(Cryptography::IAuthenticatedCipher* iface)
+            : _accessor(iface)
+        {
+        }
+        ~RPCAuthenticatedCipherImpl()
+        {
+            Clear();
+        }
+
+        BEGIN_INTERFACE_MAP(RPCAuthenticatedCipherImpl)
+        INTERFACE_ENTRY(Cryptography::IAuthenticatedCipher)
+        END_INTERFACE_MAP
+
+    public:
+        int32_t Encrypt(const uint8_t ivLength, const uint8_t iv[],
+            const uint16_t aadLength, const uint8_t aad[],
+            const uint32_t inputLength, const uint8_t input[],
+            const uint32_t maxOutputLength, uint8_t output[],
+            const uint8_t tagLength, uint8_t tag[]) const override
+        {
+            Accessor::Guard accessor(_accessor);
+            return (accessor.IsValid() == true ? accessor->Encrypt(ivLength, iv, aadLength, aad, inputLength, input, maxOutputLength, output, tagLength, tag) : 0);
+        }
+
+        int32_t Decrypt(const uint8_t ivLength, const uint8_t iv[],
+            const uint16_t aadLength, const uint8_t aad[],
+            const uint32_t inputLength, const uint8_t input[],
+            const uint32_t maxOutputLength, uint8_t output[],
+            const uint8_t tagLength, const uint8_t tag[]) const override
+        {
+            Accessor::Guard accessor(_accessor);
+            return (accessor.IsValid() == true ? accessor->Decrypt(ivLength, iv, aadLength, aad, inputLength, input, maxOutputLength, output, tagLength, tag) : 0);
+        }
+
+        void Clear() override
+        {
+            _accessor.Clear();
+        }
+
+    private:
+        Accessor _accessor;
+    };
+
+    class RPCKeyAgreementImpl : public IRPCLink, public Cryptography::IKeyAgreement {
+    private:
+        using Accessor = AccessorType<Cryptography::IKeyAgreement>;
+
+    public:
+        RPCKeyAgreementImpl(Cryptography::IKeyAgreement* iface)
+            : _accessor(iface)
+        {
+        }
+        ~RPCKeyAgreementImpl()
+        {
+            Clear();
+        }
+
+        BEGIN_INTERFACE_MAP(RPCKeyAgreementImpl)
+        INTERFACE_ENTRY(Cryptography::IKeyAgreement)
+        END_INTERFACE_MAP
+
+    public:
+        uint32_t Generate(const curvetype curve, uint32_t& privKeyId, uint32_t& pubKeyId) override
+        {
+            Accessor::Guard accessor(_accessor);
+            return (accessor.IsValid() == true ? accessor->Generate(curve, privKeyId, pubKeyId) : 0);
+        }
+
+        uint32_t Derive(const uint32_t privateKey, const uint32_t peerPublicKeyId, uint32_t& secretId) override
+        {
+            Accessor::Guard accessor(_accessor);
+            return (accessor.IsValid() == true ? accessor->Derive(privateKey, peerPublicKeyId, secretId) : 0);
+        }
+
+        void Clear() override
+        {
+            _accessor.Clear();
         }
 
     private:
-        Core::CriticalSection _adminLock;
-        Cryptography::IDiffieHellman* _accessor;
+        Accessor _accessor;
     };
 
     class RPCCipherImpl : public IRPCLink, public Cryptography::ICipher {
+    private:
+        using Accessor = AccessorType<Cryptography::ICipher>;
+
     public:
         RPCCipherImpl(Cryptography::ICipher* iface)
             : _accessor(iface)
         {
-            if (_accessor != nullptr) {
-                _accessor->AddRef();
-            }
         }
         ~RPCCipherImpl()
         {
@@ -159,40 +480,59 @@ namespace Implementation {
             const uint32_t inputLength, const uint8_t input[],
             const uint32_t maxOutputLength, uint8_t output[]) const override
         {
-            Core::SafeSyncType<Core::CriticalSection> lock(_adminLock);
-            return (_accessor != nullptr) ? _accessor->Encrypt(ivLength, iv, inputLength, input, maxOutputLength, output) : 0;
+            Accessor::Guard accessor(_accessor);
+            return (accessor.IsValid() == true ? accessor->Encrypt(ivLength, iv, inputLength, input, maxOutputLength, output) : 0);
         }
 
         int32_t Decrypt(const uint8_t ivLength, const uint8_t iv[],
             const uint32_t inputLength, const uint8_t input[],
             const uint32_t maxOutputLength, uint8_t output[]) const override
         {
-            Core::SafeSyncType<Core::CriticalSection> lock(_adminLock);
-            return (_accessor != nullptr) ? _accessor->Decrypt(ivLength, iv, inputLength, input, maxOutputLength, output) : 0;
+            Accessor::Guard accessor(_accessor);
+            return (accessor.IsValid() == true ? accessor->Decrypt(ivLength, iv, inputLength, input, maxOutputLength, output) : 0);
         }
 
         void Clear() override
         {
-            if (_accessor != nullptr) {
-                Core::SafeSyncType<Core::CriticalSection> lock(_adminLock);
-                _accessor->Release();
-                _accessor = nullptr;
-            }
+            _accessor.Clear();
         }
 
     private:
-        mutable Core::CriticalSection _adminLock;
-        Cryptography::ICipher* _accessor;
+        Accessor _accessor;
     };
 
     class RPCHashImpl : public IRPCLink, public Cryptography::IHash {
+    private:
+        using Accessor = AccessorType<Cryptography::IHash>;
+
+        // Small Ingest() calls are collected up to this many bytes before they are sent over, so
+        // feeding a hash in small chunks does not cost a round trip per chunk. 0 sends every call.
+        static constexpr uint32_t DefaultIngestThreshold = (16 * 1024);
+
+        static uint32_t IngestThreshold()
+        {
+            static const uint32_t threshold = []() -> uint32_t {
+                uint32_t result = DefaultIngestThreshold;
+                string value;
+
+                if (Core::SystemInfo::GetEnvironment(_T("CRYPTOGRAPHY_HASH_INGEST_BUFFER"), value) == true) {
+                    result = static_cast<uint32_t>(::strtoul(value.c_str(), nullptr, 0));
+                }
+
+                return (result);
+            }();
+
+            return (threshold);
+        }
+
     public:
         RPCHashImpl(Cryptography::IHash* hash)
             : _accessor(hash)
+            , _lock()
+            , _pending()
+            , _threshold(IngestThreshold())
+            , _failed(false)
         {
-            if (_accessor != nullptr) {
-                _accessor->AddRef();
-            }
         }
         ~RPCHashImpl()
         {
@@ -207,39 +547,127 @@ namespace Implementation {
         /* Ingest data into the hash calculator (multiple calls possible) */
         virtual uint32_t Ingest(const uint32_t length, const uint8_t data[] /* @length:length */) override
         {
-            Core::SafeSyncType<Core::CriticalSection> lock(_adminLock);
-            return (_accessor != nullptr ? _accessor->Ingest(length, data) : 0);
+            uint32_t result = 0;
+
+            Accessor::Guard accessor(_accessor);
+
+            if (accessor.IsValid() == true) {
+                Core::SafeSyncType<Core::CriticalSection> lock(_lock);
+
+                if ((_pending.size() + length) > _threshold) {
+                    Flush(accessor);
+                }
+
+                if (length >= _threshold) {
+                    result = accessor->Ingest(length, data);
+                } else {
+                    _pending.insert(_pending.end(), data, (data + length));
+                    result = length;
+                }
+            }
+
+            return (result);
         }
 
         /* Calculate the hash from all ingested data */
         uint8_t Calculate(const uint8_t maxLength, uint8_t data[] /* @out @maxlength:maxLength */) override
         {
-            Core::SafeSyncType<Core::CriticalSection> lock(_adminLock);
-            return (_accessor != nullptr ? _accessor->Calculate(maxLength, data) : 0);
+            uint8_t result = 0;
+
+            Accessor::Guard accessor(_accessor);
+
+            if (accessor.IsValid() == true) {
+                Core::SafeSyncType<Core::CriticalSection> lock(_lock);
+
+                // Data accepted earlier but lost on the way makes the hash worthless
+                if (Flush(accessor) == true) {
+                    result = accessor->Calculate(maxLength, data);
+                }
+            }
+
+            return (result);
+        }
+
+        /* Restart the calculation, the hash type and key (if any) are retained */
+        uint32_t Reset() override
+        {
+            uint32_t result = Core::ERROR_UNAVAILABLE;
+
+            Accessor::Guard accessor(_accessor);
+
+            if (accessor.IsValid() == true) {
+                Core::SafeSyncType<Core::CriticalSection> lock(_lock);
+
+                _pending.clear();
+                _failed = false;
+
+                result = accessor->Reset();
+            }
+
+            return (result);
+        }
+
+        /* Fork the calculation including all ingested data */
+        Cryptography::IHash* Copy() const override
+        {
+            Cryptography::IHash* iface = nullptr;
+
+            Accessor::Guard accessor(_accessor);
+
+            if (accessor.IsValid() == true) {
+                Core::SafeSyncType<Core::CriticalSection> lock(_lock);
+
+                if (Flush(accessor) == true) {
+                    iface = accessor->Copy();
+                }
+
+                if (iface != nullptr) {
+                    iface = CryptographyLink::Instance().Register<RPCHashImpl>(iface);
+
+                    ASSERT(iface != nullptr);
+                }
+            }
+
+            return iface;
         }
 
         void Clear() override
         {
-            if (_accessor != nullptr) {
-                Core::SafeSyncType<Core::CriticalSection> lock(_adminLock);
-                _accessor->Release();
-                _accessor = nullptr;
+            _accessor.Clear();
+        }
+
+    private:
+        // Hand the collected data to the remote side in one call, called with _lock taken
+        bool Flush(const Accessor::Guard& accessor) const
+        {
+            if (_pending.empty() == false) {
+                if (accessor->Ingest(static_cast<uint32_t>(_pending.size()), _pending.data()) != _pending.size()) {
+                    TRACE_L1("Failed to ingest %u buffered bytes", static_cast<uint32_t>(_pending.size()));
+                    _failed = true;
+                }
+
+                _pending.clear();
             }
+
+            return (_failed == false);
         }
 
     private:
-        Core::CriticalSection _adminLock;
-        Cryptography::IHash* _accessor;
+        Accessor _accessor;
+        mutable Core::CriticalSection _lock;
+        mutable std::vector<uint8_t> _pending;
+        const uint32_t _threshold;
+        mutable bool _failed;
     };
 
     class RPCVaultImpl : virtual public IRPCLink, public Cryptography::IVault {
+    private:
+        using Accessor = AccessorType<Cryptography::IVault>;
+
     public:
         RPCVaultImpl(Cryptography::IVault* vault)
             : _accessor(vault)
         {
-            if (_accessor != nullptr) {
-                _accessor->AddRef();
-            }
         }
         ~RPCVaultImpl()
         {
@@ -255,44 +683,44 @@ namespace Implementation {
         // (-1 if the blob exists in the vault but is not extractable and 0 if the ID does not exist)
         uint16_t Size(const uint32_t id) const override
         {
-            Core::SafeSyncType<Core::CriticalSection> lock(_adminLock);
-            return (_accessor != nullptr ? _accessor->Size(id) : 0);
+            Accessor::Guard accessor(_accessor);
+            return (accessor.IsValid() == true ? accessor->Size(id) : 0);
         }
 
         // Import unencrypted data blob into the vault (returns blob ID)
         // Note: User IDs are always greater than 0x80000000, values below 0x80000000 are reserved for implementation-specific internal data blobs.
         uint32_t Import(const uint16_t length, const uint8_t blob[] /* @length:length */) override
         {
-            Core::SafeSyncType<Core::CriticalSection> lock(_adminLock);
-            return (_accessor != nullptr ? _accessor->Import(length, blob) : 0);
+            Accessor::Guard accessor(_accessor);
+            return (accessor.IsValid() == true ? accessor->Import(length, blob) : 0);
         }
 
         // Export unencrypted data blob out of the vault (returns blob ID), only public blobs are exportable
         uint16_t Export(const uint32_t id, const uint16_t maxLength, uint8_t blob[] /* @out @maxlength:maxLength */) const override
         {
-            Core::SafeSyncType<Core::CriticalSection> lock(_adminLock);
-            return (_accessor != nullptr ? _accessor->Export(id, maxLength, blob) : 0);
+            Accessor::Guard accessor(_accessor);
+            return (accessor.IsValid() == true ? accessor->Export(id, maxLength, blob) : 0);
         }
 
         // Set encrypted data blob in the vault (returns blob ID)
         uint32_t Set(const uint16_t length, const uint8_t blob[] /* @length:length */) override
         {
-            Core::SafeSyncType<Core::CriticalSection> lock(_adminLock);
-            return (_accessor != nullptr ? _accessor->Set(length, blob) : 0);
+            Accessor::Guard accessor(_accessor);
+            return (accessor.IsValid() == true ? accessor->Set(length, blob) : 0);
         }
 
         // Get encrypted data blob out of the vault (data identified by ID, returns size of the retrieved data)
         uint16_t Get(const uint32_t id, const uint16_t maxLength, uint8_t blob[] /* @out @maxlength:maxLength */) const override
         {
-            Core::SafeSyncType<Core::CriticalSection> lock(_adminLock);
-            return (_accessor != nullptr ? _accessor->Get(id, maxLength, blob) : 0);
+            Accessor::Guard accessor(_accessor);
+            return (accessor.IsValid() == true ? accessor->Get(id, maxLength, blob) : 0);
         }
 
         // Delete a data blob from the vault
         bool Delete(const uint32_t id) override
         {
-            Core::SafeSyncType<Core::CriticalSection> lock(_adminLock);
-            return (_accessor != nullptr ? _accessor->Delete(id) : false);
+            Accessor::Guard accessor(_accessor);
+            return (accessor.IsValid() == true ? accessor->Delete(id) : false);
         }
 
         // Crypto operations using the vault for key storage
@@ -303,20 +731,16 @@ namespace Implementation {
         {
             Cryptography::IHash* iface = nullptr;
 
-            Core::SafeSyncType<Core::CriticalSection> lock(_adminLock);
+            Accessor::Guard accessor(_accessor);
 
-            if (_accessor != nullptr) {
+            if (accessor.IsValid() == true) {
 
-                iface = _accessor->HMAC(hashType, keyId);
+                iface = accessor->HMAC(hashType, keyId);
 
                 if (iface != nullptr) {
-                    Core::ProxyType<Core::Service<RPCHashImpl>> object = CryptographyLink::Instance().Register<RPCHashImpl>(iface);
-
-                    ASSERT(object.IsValid() == true);
-
-                    iface->Release();
+                    iface = CryptographyLink::Instance().Register<RPCHashImpl>(iface);
 
-                    iface = reinterpret_cast<Cryptography::IHash*>(object->QueryInterface(Cryptography::IHash::ID));
+                    ASSERT(iface != nullptr);
                 }
             }
 
@@ -328,20 +752,16 @@ namespace Implementation {
         {
             Cryptography::ICipher* iface = nullptr;
 
-            Core::SafeSyncType<Core::CriticalSection> lock(_adminLock);
+            Accessor::Guard accessor(_accessor);
 
-            if (_accessor != nullptr) {
+            if (accessor.IsValid() == true) {
 
-                iface = _accessor->AES(aesMode, keyId);
+                iface = accessor->AES(aesMode, keyId);
 
                 if (iface != nullptr) {
-                    Core::ProxyType<Core::Service<RPCCipherImpl>> object = CryptographyLink::Instance().Register<RPCCipherImpl>(iface);
+                    iface = CryptographyLink::Instance().Register<RPCCipherImpl>(iface);
 
-                    ASSERT(object.IsValid() == true);
-
-                    iface->Release();
-
-                    iface = reinterpret_cast<Cryptography::ICipher*>(object->QueryInterface(Cryptography::ICipher::ID));
+                    ASSERT(iface != nullptr);
                 }
             }
 
@@ -353,41 +773,107 @@ namespace Implementation {
         {
             Cryptography::IDiffieHellman* iface = nullptr;
 
-            Core::SafeSyncType<Core::CriticalSection> lock(_adminLock);
+            Accessor::Guard accessor(_accessor);
 
-            if (_accessor != nullptr) {
+            if (accessor.IsValid() == true) {
 
-                iface = _accessor->DiffieHellman();
+                iface = accessor->DiffieHellman();
 
                 if (iface != nullptr) {
-                    Core::ProxyType<Core::Service<RPCDiffieHellmanImpl>> object = CryptographyLink::Instance().Register<RPCDiffieHellmanImpl>(iface);
+                    iface = CryptographyLink::Instance().Register<RPCDiffieHellmanImpl>(iface);
 
-                    ASSERT(object.IsValid() == true);
+                    ASSERT(iface != nullptr);
+                }
+            }
 
-                    iface->Release();
+            return iface;
+        }
 
-                    iface = reinterpret_cast<Cryptography::IDiffieHellman*>(object->QueryInterface(Cryptography::IDiffieHellman::ID));
+        // Calculate the HMAC of a single buffer in one go
+        uint8_t Sign(const Cryptography::hashtype hashType, const uint32_t keyId,
+            const uint32_t length, const uint8_t data[] /* @length:length */,
+            const uint8_t maxLength, uint8_t hmac[] /* @out @maxlength:maxLength */) override
+        {
+            Accessor::Guard accessor(_accessor);
+            return (accessor.IsValid() == true ? accessor->Sign(hashType, keyId, length, data, maxLength, hmac) : 0);
+        }
+
+        // Calculate the HMACs of a series of messages with the same key in one go
+        uint16_t SignBatch(const Cryptography::hashtype hashType, const uint32_t keyId,
+            const uint16_t count, const uint32_t lengths[] /* @length:count */,
+            const uint32_t length, const uint8_t data[] /* @length:length */,
+            const uint32_t maxLength, uint8_t hmacs[] /* @out @maxlength:maxLength */) override
+        {
+            Accessor::Guard accessor(_accessor);
+            return (accessor.IsValid() == true ? accessor->SignBatch(hashType, keyId, count, lengths, length, data, maxLength, hmacs) : 0);
+        }
+
+        // Verify the HMACs of a series of messages with the same key in one go
+        uint16_t VerifyBatch(const Cryptography::hashtype hashType, const uint32_t keyId,
+            const uint16_t count, const uint32_t lengths[] /* @length:count */,
+            const uint32_t length, const uint8_t data[] /* @length:length */,
+            const uint32_t hmacsLength, const uint8_t hmacs[] /* @length:hmacsLength */,
+            uint8_t results[] /* @out @length:count */) override
+        {
+            Accessor::Guard accessor(_accessor);
+            return (accessor.IsValid() == true ? accessor->VerifyBatch(hashType, keyId, count, lengths, length, data, hmacsLength, hmacs, results) : 0);
+        }
+
+        // Retrieve an elliptic curve key agreement
+        Cryptography::IKeyAgreement* KeyAgreement() override
+        {
+            Cryptography::IKeyAgreement* iface = nullptr;
+
+            Accessor::Guard accessor(_accessor);
+
+            if (accessor.IsValid() == true) {
+
+                iface = accessor->KeyAgreement();
+
+                if (iface != nullptr) {
+                    iface = CryptographyLink::Instance().Register<RPCKeyAgreementImpl>(iface);
+
+                    ASSERT(iface != nullptr);
                 }
             }
 
             return iface;
         }
 
-        void Clear() override
+        // Retrieve an authenticated (AEAD) encryptor/decryptor
+        Cryptography::IAuthenticatedCipher* AEAD(const Cryptography::aeadmode aeadMode, const uint32_t keyId) override
         {
-            if (_accessor != nullptr) {
-                Core::SafeSyncType<Core::CriticalSection> lock(_adminLock);
-                _accessor->Release();
-                _accessor = nullptr;
+            Cryptography::IAuthenticatedCipher* iface = nullptr;
+
+            Accessor::Guard accessor(_accessor);
+
+            if (accessor.IsValid() == true) {
+
+                iface = accessor->AEAD(aeadMode, keyId);
+
+                if (iface != nullptr) {
+                    iface = CryptographyLink::Instance().Register<RPCAuthenticatedCipherImpl>(iface);
+
+                    ASSERT(iface != nullptr);
+                }
             }
+
+            return iface;
+        }
+
+        void Clear() override
+        {
+            _accessor.Clear();
         }
 
     private:
-        mutable Core::CriticalSection _adminLock;
-        Cryptography::IVault* _accessor;
+        Accessor _accessor;
     };
 
     class RPCCryptographyImpl : public IRPCLink, public Cryptography::ICryptography {
+    private:
+        using Accessor = AccessorType<Cryptography::ICryptography>;
+
     public:
         RPCCryptographyImpl() = delete;
         RPCCryptographyImpl(const RPCCryptographyImpl&) = delete;
@@ -396,7 +882,6 @@ namespace Implementation {
         RPCCryptographyImpl(Cryptography::ICryptography* iface)
             : _accessor(iface)
         {
-            _accessor->AddRef();
         }
         ~RPCCryptographyImpl()
         {
@@ -413,20 +898,16 @@ namespace Implementation {
         {
             Cryptography::IHash* iface = nullptr;
 
-            Core::SafeSyncType<Core::CriticalSection> lock(_adminLock);
+            Accessor::Guard accessor(_accessor);
 
-            if (_accessor != nullptr) {
+            if (accessor.IsValid() == true) {
 
-                iface = _accessor->Hash(hashType);
+                iface = accessor->Hash(hashType);
 
                 if (iface != nullptr) {
-                    Core::ProxyType<Core::Service<RPCHashImpl>> object = CryptographyLink::Instance().Register<RPCHashImpl>(iface);
-
-                    ASSERT(object.IsValid() == true);
-
-                    iface->Release();
+                    iface = CryptographyLink::Instance().Register<RPCHashImpl>(iface);
 
-                    iface = reinterpret_cast<Cryptography::IHash*>(object->QueryInterface(Cryptography::IHash::ID));
+                    ASSERT(iface != nullptr);
                 }
             }
 
@@ -438,54 +919,48 @@ namespace Implementation {
         {
             Cryptography::IVault* iface = nullptr;
 
-            Core::SafeSyncType<Core::CriticalSection> lock(_adminLock);
+            Accessor::Guard accessor(_accessor);
 
-            if (_accessor != nullptr) {
+            if (accessor.IsValid() == true) {
 
-                iface = _accessor->Vault(id);
+                iface = accessor->Vault(id);
 
                 if (iface != nullptr) {
-                    Core::ProxyType<Core::Service<RPCVaultImpl>> object = CryptographyLink::Instance().Register<RPCVaultImpl>(iface);
+                    iface = CryptographyLink::Instance().Register<RPCVaultImpl>(iface);
 
-                    ASSERT(object.IsValid() == true);
-
-                    iface->Release();
-
-                    iface = reinterpret_cast<Cryptography::IVault*>(object->QueryInterface(Cryptography::IVault::ID));
+                    ASSERT(iface != nullptr);
                 }
             }
 
             return iface;
         }
 
+        // Calculate the hash of a single buffer in one go
+        uint8_t Digest(const Cryptography::hashtype hashType,
+            const uint32_t length, const uint8_t data[] /* @length:length */,
+            const uint8_t maxLength, uint8_t hash[] /* @out @maxlength:maxLength */) override
+        {
+            Accessor::Guard accessor(_accessor);
+            return (accessor.IsValid() == true ? accessor->Digest(hashType, length, data, maxLength, hash) : 0);
+        }
+
         void Clear() override
         {
-            Core::SafeSyncType<Core::CriticalSection> lock(_adminLock);
-            if (_accessor != nullptr) {
-                _accessor->Release();
-                _accessor = nullptr;
-            }
+            _accessor.Clear();
         }
 
     private:
-        mutable Core::CriticalSection _adminLock;
-        Cryptography::ICryptography* _accessor;
+        Accessor _accessor;
     };
 
     Cryptography::ICryptography* CryptographyLink::Cryptography(const std::string& connectionPoint)
     {
         Cryptography::ICryptography* iface = BaseClass::Aquire<Cryptography::ICryptography>(3000, Core::NodeId(connectionPoint.c_str()), _T(""), ~0);
 
-        // Core::SafeSyncType<Core::CriticalSection> lock(_adminLock);
-
         if (iface != nullptr) {
-            Core::ProxyType<Core::Service<RPCCryptographyImpl>> object = Register<RPCCryptographyImpl>(iface);
+            iface = Register<RPCCryptographyImpl>(iface);
 
-            ASSERT(object.IsValid() == true);
-
-            iface->Release();
-
-            iface = reinterpret_cast<Cryptography::ICryptography*>(object->QueryInterface(Cryptography::ICryptography::ID));
+            ASSERT(iface != nullptr);
         }
 
         return iface;
@@ -519,6 +994,35 @@ namespace Implementation {
             return (hash_calculate(_implementation, maxLength, data));
         }
 
+        uint32_t Reset() override
+        {
+            return (hash_reset(_implementation));
+        }
+
+        WPEFramework::Cryptography::IHash* Copy() const override
+        {
+            WPEFramework::Cryptography::IHash* hash(nullptr);
+
+            HashImplementation* impl = hash_copy(_implementation);
+
+            if (impl != nullptr) {
+                hash = Clone(impl);
+                ASSERT(hash != nullptr);
+
+                if (hash == nullptr) {
+                    hash_destroy(impl);
+                }
+            }
+
+            return (hash);
+        }
+
+    protected:
+        virtual WPEFramework::Cryptography::IHash* Clone(HashImplementation* impl) const
+        {
+            return (WPEFramework::Core::Service<HashImpl>::Create<WPEFramework::Cryptography::IHash>(impl));
+        }
+
     public:
         BEGIN_INTERFACE_MAP(HashImpl)
         INTERFACE_ENTRY(WPEFramework::Cryptography::IHash)
@@ -622,6 +1126,12 @@ namespace Implementation {
                 _vault->Release();
             }
 
+        protected:
+            WPEFramework::Cryptography::IHash* Clone(HashImplementation* impl) const override
+            {
+                return (WPEFramework::Core::Service<HMACImpl>::Create<WPEFramework::Cryptography::IHash>(_vault, impl));
+            }
+
         private:
             VaultImpl* _vault;
         }; // class HMACImpl
@@ -672,6 +1182,56 @@ namespace Implementation {
             CipherImplementation* _implementation;
         }; // class CipherImpl
 
+        class AuthenticatedCipherImpl : virtual public WPEFramework::Cryptography::IAuthenticatedCipher {
+        public:
+            AuthenticatedCipherImpl() = delete;
+            AuthenticatedCipherImpl(const AuthenticatedCipherImpl&) = delete;
+            AuthenticatedCipherImpl& operator=(const AuthenticatedCipherImpl&) = delete;
+
+            AuthenticatedCipherImpl(VaultImpl* vault, CipherImplementation* implementation)
+                : _vault(vault)
+                , _implementation(implementation)
+            {
+                ASSERT(_implementation != nullptr);
+                ASSERT(_vault != nullptr);
+                _vault->AddRef();
+            }
+
+            ~AuthenticatedCipherImpl() override
+            {
+                cipher_destroy(_implementation);
+                _vault->Release();
+            }
+
+        public:
+            int32_t Encrypt(const uint8_t ivLength, const uint8_t iv[],
+                const uint16_t aadLength, const uint8_t aad[],
+                const uint32_t inputLength, const uint8_t input[],
+                const uint32_t maxOutputLength, uint8_t output[],
+                const uint8_t tagLength, uint8_t tag[]) const override
+            {
+                return (cipher_aead_encrypt(_implementation, ivLength, iv, aadLength, aad, inputLength, input, maxOutputLength, output, tagLength, tag));
+            }
+
+            int32_t Decrypt(const uint8_t ivLength, const uint8_t iv[],
+                const uint16_t aadLength, const uint8_t aad[],
+                const uint32_t inputLength, const uint8_t input[],
+                const uint32_t maxOutputLength, uint8_t output[],
+                const uint8_t tagLength, const uint8_t tag[]) const override
+            {
+                return (cipher_aead_decrypt(_implementation, ivLength, iv, aadLength, aad, inputLength, input, maxOutputLength, output, tagLength, tag));
+            }
+
+        public:
+            BEGIN_INTERFACE_MAP(AuthenticatedCipherImpl)
+            INTERFACE_ENTRY(WPEFramework::Cryptography::IAuthenticatedCipher)
+            END_INTERFACE_MAP
+
+        private:
+            VaultImpl* _vault;
+            CipherImplementation* _implementation;
+        }; // class AuthenticatedCipherImpl
+
         class DiffieHellmanImpl : virtual public WPEFramework::Cryptography::IDiffieHellman {
         public:
             DiffieHellmanImpl() = delete;
@@ -711,6 +1271,44 @@ namespace Implementation {
             VaultImpl* _vault;
         }; // class DiffieHellmanImpl
 
+        class KeyAgreementImpl : virtual public WPEFramework::Cryptography::IKeyAgreement {
+        public:
+            KeyAgreementImpl() = delete;
+            KeyAgreementImpl(const KeyAgreementImpl&) = delete;
+            KeyAgreementImpl& operator=(const KeyAgreementImpl&) = delete;
+
+            KeyAgreementImpl(VaultImpl* vault)
+                : _vault(vault)
+            {
+                ASSERT(_vault != nullptr);
+                _vault->AddRef();
+            }
+
+            ~KeyAgreementImpl() override
+            {
+                _vault->Release();
+            }
+
+        public:
+            uint32_t Generate(const curvetype curve, uint32_t& privKeyId, uint32_t& pubKeyId) override
+            {
+                return (keyagreement_generate(_vault->Implementation(), static_cast<key_agreement_curve>(curve), &privKeyId, &pubKeyId));
+            }
+
+            uint32_t Derive(const uint32_t privateKeyId, const uint32_t peerPublicKeyId, uint32_t& secretId) override
+            {
+                return (keyagreement_derive(_vault->Implementation(), privateKeyId, peerPublicKeyId, &secretId));
+            }
+
+        public:
+            BEGIN_INTERFACE_MAP(KeyAgreementImpl)
+            INTERFACE_ENTRY(WPEFramework::Cryptography::IKeyAgreement)
+            END_INTERFACE_MAP
+
+        private:
+            VaultImpl* _vault;
+        }; // class KeyAgreementImpl
+
         WPEFramework::Cryptography::IHash* HMAC(const WPEFramework::Cryptography::hashtype hashType,
             const uint32_t secretId) override
         {
@@ -756,6 +1354,103 @@ namespace Implementation {
             return (dh);
         }
 
+        uint8_t Sign(const WPEFramework::Cryptography::hashtype hashType, const uint32_t keyId,
+            const uint32_t length, const uint8_t data[], const uint8_t maxLength, uint8_t hmac[]) override
+        {
+            return (hash_hmac(_implementation, static_cast<hash_type>(hashType), keyId, length, data, maxLength, hmac));
+        }
+
+        uint16_t SignBatch(const WPEFramework::Cryptography::hashtype hashType, const uint32_t keyId,
+            const uint16_t count, const uint32_t lengths[], const uint32_t length, const uint8_t data[],
+            const uint32_t maxLength, uint8_t hmacs[]) override
+        {
+            uint16_t result = 0;
+
+            if (Fits(count, lengths, length) == true) {
+                result = hash_hmac_batch(_implementation, static_cast<hash_type>(hashType), keyId, count, lengths, data, maxLength, hmacs);
+            }
+
+            return (result);
+        }
+
+        uint16_t VerifyBatch(const WPEFramework::Cryptography::hashtype hashType, const uint32_t keyId,
+            const uint16_t count, const uint32_t lengths[], const uint32_t length, const uint8_t data[],
+            const uint32_t hmacsLength, const uint8_t hmacs[], uint8_t results[]) override
+        {
+            uint16_t result = 0;
+            const uint32_t size = static_cast<uint32_t>(hashType);
+
+            ::memset(results, 0, count);
+
+            if ((Fits(count, lengths, length) == true) && (hmacsLength >= (count * size))) {
+                uint8_t* calculated = new uint8_t[count * size];
+
+                uint16_t available = hash_hmac_batch(_implementation, static_cast<hash_type>(hashType), keyId, count, lengths, data, (count * size), calculated);
+
+                for (uint16_t index = 0; index < available; index++) {
+                    if (Equal(calculated + (index * size), hmacs + (index * size), size) == true) {
+                        results[index] = 1;
+                        result++;
+                    }
+                }
+
+                ::memset(calculated, 0, (count * size));
+                delete[] calculated;
+            }
+
+            return (result);
+        }
+
+        WPEFramework::Cryptography::IKeyAgreement* KeyAgreement() override
+        {
+            WPEFramework::Cryptography::IKeyAgreement* ka = Core::Service<KeyAgreementImpl>::Create<WPEFramework::Cryptography::IKeyAgreement>(this);
+            ASSERT(ka != nullptr);
+            return (ka);
+        }
+
+        WPEFramework::Cryptography::IAuthenticatedCipher* AEAD(const WPEFramework::Cryptography::aeadmode aeadMode,
+            const uint32_t keyId) override
+        {
+            WPEFramework::Cryptography::IAuthenticatedCipher* cipher(nullptr);
+
+            CipherImplementation* impl = cipher_create_aead(_implementation, static_cast<aead_mode>(aeadMode), keyId);
+
+            if (impl != nullptr) {
+                cipher = Core::Service<AuthenticatedCipherImpl>::Create<WPEFramework::Cryptography::IAuthenticatedCipher>(this, impl);
+                ASSERT(cipher != nullptr);
+
+                if (cipher == nullptr) {
+                    cipher_destroy(impl);
+                }
+            }
+
+            return (cipher);
+        }
+
+    private:
+        static bool Fits(const uint16_t count, const uint32_t lengths[], const uint32_t length)
+        {
+            uint64_t total = 0;
+
+            for (uint16_t index = 0; index < count; index++) {
+                total += lengths[index];
+            }
+
+            return (total <= length);
+        }
+
+        // Compare without bailing out on the first difference, so the time taken does not reveal where a mismatch is.
+        static bool Equal(const uint8_t lhs[], const uint8_t rhs[], const uint32_t length)
+        {
+            uint8_t difference = 0;
+
+            for (uint32_t index = 0; index < length; index++) {
+                difference |= (lhs[index] ^ rhs[index]);
+            }
+
+            return (difference == 0);
+        }
+
     public:
         BEGIN_INTERFACE_MAP(VaultImpl)
         INTERFACE_ENTRY(WPEFramework::Cryptography::IVault)
@@ -804,12 +1499,68 @@ namespace Implementation {
             return (vault);
         }
 
+        uint8_t Digest(const WPEFramework::Cryptography::hashtype hashType,
+            const uint32_t length, const uint8_t data[], const uint8_t maxLength, uint8_t hash[]) override
+        {
+            return (hash_digest(static_cast<hash_type>(hashType), length, data, maxLength, hash));
+        }
+
     public:
         BEGIN_INTERFACE_MAP(CryptographyImpl)
         INTERFACE_ENTRY(WPEFramework::Cryptography::ICryptography)
         END_INTERFACE_MAP
     }; // class CryptographyImpl
 
+    // Keeps the secrets on the other side of the connection point: the vaults are the remote ones,
+    // the hashing is done by the local implementation.
+    class HybridCryptographyImpl : virtual public WPEFramework::Cryptography::ICryptography {
+    public:
+        HybridCryptographyImpl() = delete;
+        HybridCryptographyImpl(const HybridCryptographyImpl&) = delete;
+        HybridCryptographyImpl& operator=(const HybridCryptographyImpl&) = delete;
+
+        HybridCryptographyImpl(WPEFramework::Cryptography::ICryptography* local, WPEFramework::Cryptography::ICryptography* remote)
+            : _local(local)
+            , _remote(remote)
+        {
+            ASSERT(_local != nullptr);
+            ASSERT(_remote != nullptr);
+            _local->AddRef();
+            _remote->AddRef();
+        }
+        ~HybridCryptographyImpl() override
+        {
+            _remote->Release();
+            _local->Release();
+        }
+
+    public:
+        WPEFramework::Cryptography::IHash* Hash(const WPEFramework::Cryptography::hashtype hashType) override
+        {
+            return (_local->Hash(hashType));
+        }
+
+        WPEFramework::Cryptography::IVault* Vault(const cryptographyvault id) override
+        {
+            return (_remote->Vault(id));
+        }
+
+        uint8_t Digest(const WPEFramework::Cryptography::hashtype hashType,
+            const uint32_t length, const uint8_t data[], const uint8_t maxLength, uint8_t hash[]) override
+        {
+            return (_local->Digest(hashType, length, data, maxLength, hash));
+        }
+
+    public:
+        BEGIN_INTERFACE_MAP(HybridCryptographyImpl)
+        INTERFACE_ENTRY(WPEFramework::Cryptography::ICryptography)
+        END_INTERFACE_MAP
+
+    private:
+        WPEFramework::Cryptography::ICryptography* _local;
+        WPEFramework::Cryptography::ICryptography* _remote;
+    }; // class HybridCryptographyImpl
+
 } // namespace Implementation
 
 /* static */ Cryptography::ICryptography* Cryptography::ICryptography::Instance(const std::string& connectionPoint)
@@ -826,4 +1577,28 @@ namespace Implementation {
     return result;
 }
 
+/* static */ Cryptography::ICryptography* Cryptography::ICryptography::Instance(const std::string& connectionPoint, const bool hybrid)
+{
+    Cryptography::ICryptography* result(nullptr);
+
+    if ((hybrid == false) || (connectionPoint.empty() == true)) {
+        result = Instance(connectionPoint);
+    } else {
+        Cryptography::ICryptography* remote = Implementation::CryptographyLink::Instance().Cryptography(connectionPoint);
+
+        if (remote != nullptr) {
+            Cryptography::ICryptography* local = Core::Service<Implementation::CryptographyImpl>::Create<Cryptography::ICryptography>();
+            ASSERT(local != nullptr);
+
+            result = Core::Service<Implementation::HybridCryptographyImpl>::Create<Cryptography::ICryptography>(local, remote);
+            ASSERT(result != nullptr);
+
+            local->Release();
+            remote->Release();
+        }
+    }
+
+    return result;
+}
+
 } // namespace WPEFramework
@@ -35,7 +35,9 @@ namespace Cryptography {
         ID_CIPHER,
         ID_DIFFIE_HELLMAN,
         ID_CRYPTOGRAPHY,
-        ID_PERSISTENT
+        ID_PERSISTENT,
+        ID_KEY_AGREEMENT,
+        ID_AUTHENTICATED_CIPHER
     };
 
     enum aesmode : uint8_t {
@@ -48,6 +50,11 @@ namespace Cryptography {
         CTR
     };
 
+    enum aeadmode : uint8_t {
+        AES_GCM,
+        CHACHA20_POLY1305
+    };
+
     enum hashtype : uint8_t {
         SHA1 = 20,
         SHA224 = 28,
@@ -69,6 +76,12 @@ namespace Cryptography {
 
         /* Calculate the hash from all ingested data */
         virtual uint8_t Calculate(const uint8_t maxLength, uint8_t data[] /* @out @maxlength:maxLength */) = 0;
+
+        /* Restart the calculation, the hash type and key (if any) are retained */
+        virtual uint32_t Reset() = 0;
+
+        /* Fork the calculation including all ingested data, e.g. for messages sharing a common prefix */
+        virtual IHash* Copy() const = 0;
     };
 
     struct EXTERNAL ICipher : virtual public Core::IUnknown {
@@ -92,6 +105,31 @@ namespace Cryptography {
                                 const uint32_t maxOutputLength, uint8_t output[] /* @out @maxlength:maxOutputLength */) const = 0;
     };
 
+    struct EXTERNAL IAuthenticatedCipher : virtual public Core::IUnknown {
+
+        enum { ID = ID_AUTHENTICATED_CIPHER };
+
+        ~IAuthenticatedCipher() override = default;
+
+        // Encryption and authentication in a single pass. The IV is 12 bytes, the tag 12 to 16 bytes; the additional
+        // data is authenticated only. Output length conventions are as for ICipher. The input can not be empty,
+        // 0 is returned for it as for any failure (so also for a tag that does not match).
+
+        /* Encrypt data and calculate the tag */
+        virtual int32_t Encrypt(const uint8_t ivLength, const uint8_t iv[] /* @length:ivLength */,
+                                const uint16_t aadLength, const uint8_t aad[] /* @length:aadLength */,
+                                const uint32_t inputLength, const uint8_t input[] /* @length:inputLength */,
+                                const uint32_t maxOutputLength, uint8_t output[] /* @out @maxlength:maxOutputLength */,
+                                const uint8_t tagLength, uint8_t tag[] /* @out @length:tagLength */) const = 0;
+
+        /* Decrypt data and verify the tag, nothing is returned if the tag does not match */
+        virtual int32_t Decrypt(const uint8_t ivLength, const uint8_t iv[] /* @length:ivLength */,
+                                const uint16_t aadLength, const uint8_t aad[] /* @length:aadLength */,
+                                const uint32_t inputLength, const uint8_t input[] /* @length:inputLength */,
+                                const uint32_t maxOutputLength, uint8_t output[] /* @out @maxlength:maxOutputLength */,
+                                const uint8_t tagLength, const uint8_t tag[] /* @length:tagLength */) const = 0;
+    };
+
     struct EXTERNAL IDiffieHellman : virtual public Core::IUnknown {
 
         enum { ID = ID_DIFFIE_HELLMAN };
@@ -106,6 +144,25 @@ namespace Cryptography {
         virtual uint32_t Derive(const uint32_t privateKey, const uint32_t peerPublicKeyId, uint32_t& secretId /* @out */) = 0;
     };
 
+    struct EXTERNAL IKeyAgreement : virtual public Core::IUnknown {
+
+        enum { ID = ID_KEY_AGREEMENT };
+
+        enum curvetype : uint8_t {
+            X25519,
+            P256
+        };
+
+        ~IKeyAgreement() override = default;
+
+        /* Generate an elliptic curve private/public key pair, the public key is exported in its raw
+           (X25519) or uncompressed point (P-256) encoding */
+        virtual uint32_t Generate(const curvetype curve, uint32_t& privKeyId /* @out */, uint32_t& pubKeyId /* @out */) = 0;
+
+        /* Calculate an ECDH shared secret */
+        virtual uint32_t Derive(const uint32_t privateKey, const uint32_t peerPublicKeyId, uint32_t& secretId /* @out */) = 0;
+    };
+
     struct IPersistent : virtual public Core::IUnknown {
 
     enum { ID = ID_PERSISTENT };
@@ -176,6 +233,32 @@ namespace Cryptography {
 
         // Retrieve a Diffie-Hellman key creator
         virtual IDiffieHellman* DiffieHellman() = 0;
+
+        // Calculate the HMAC of a single buffer in one go (returns size of the HMAC)
+        virtual uint8_t Sign(const hashtype hashType, const uint32_t keyId,
+                             const uint32_t length, const uint8_t data[] /* @length:length */,
+                             const uint8_t maxLength, uint8_t hmac[] /* @out @maxlength:maxLength */) = 0;
+
+        // Calculate the HMACs of a series of messages with the same key in one go. The messages are passed back to back
+        // in data with their sizes in lengths, the HMACs are returned back to back (returns the number of HMACs calculated)
+        virtual uint16_t SignBatch(const hashtype hashType, const uint32_t keyId,
+                                   const uint16_t count, const uint32_t lengths[] /* @length:count */,
+                                   const uint32_t length, const uint8_t data[] /* @length:length */,
+                                   const uint32_t maxLength, uint8_t hmacs[] /* @out @maxlength:maxLength */) = 0;
+
+        // Verify the HMACs of a series of messages with the same key in one go, laid out as for SignBatch.
+        // results[n] is set to 1 if the HMAC of message n matches (returns the number of matching messages)
+        virtual uint16_t VerifyBatch(const hashtype hashType, const uint32_t keyId,
+                                     const uint16_t count, const uint32_t lengths[] /* @length:count */,
+                                     const uint32_t length, const uint8_t data[] /* @length:length */,
+                                     const uint32_t hmacsLength, const uint8_t hmacs[] /* @length:hmacsLength */,
+                                     uint8_t results[] /* @out @length:count */) = 0;
+
+        // Retrieve an elliptic curve (X25519/P-256) key agreement
+        virtual IKeyAgreement* KeyAgreement() = 0;
+
+        // Retrieve an authenticated (AEAD) encryptor/decryptor
+        virtual IAuthenticatedCipher* AEAD(const aeadmode aeadMode, const uint32_t keyId) = 0;
     };
 
     struct EXTERNAL ICryptography : virtual public Core::IUnknown {
@@ -185,11 +268,20 @@ namespace Cryptography {
 
         static ICryptography* Instance(const std::string& connectionPoint);
 
+        // With hybrid set, only the vaults are taken from the connection point; keyless operations
+        // (Hash, Digest) are done in-process, so they do not cost a round trip per call.
+        static ICryptography* Instance(const std::string& connectionPoint, const bool hybrid);
+
         // Retrieve a hash calculator
         virtual IHash* Hash(const hashtype hashType) = 0;
 
         // Retrieve a vault (TEE identified by ID)
         virtual IVault* Vault(const cryptographyvault id) = 0;
+
+        // Calculate the hash of a single buffer in one go (returns size of the hash)
+        virtual uint8_t Digest(const hashtype hashType,
+                               const uint32_t length, const uint8_t data[] /* @length:length */,
+                               const uint8_t maxLength, uint8_t hash[] /* @out @maxlength:maxLength */) = 0;
     };
 
 } // namespace Cryptography
@@ -43,7 +43,8 @@ struct INetflixSecurity : public Core::IUnknown
     /* Retrieve the pre-shared wrapping key */
     virtual uint32_t WrappingKey() const = 0;
 
-    /* Derive encryption keys based on an authenticated Diffie-Hellman procedure */
+    /* Derive encryption keys based on an authenticated Diffie-Hellman procedure. With the derived key cache
+       enabled, the same source keys give the same (shared) key ids until one of the keys is deleted. */
     virtual uint32_t DeriveKeys(const uint32_t privateDhKeyId, const uint32_t peerPublicDhKeyId, const uint32_t derivationKeyId,
                                 uint32_t& encryptionKeyId /* @out */, uint32_t& hmacKeyId /* @out */, uint32_t& wrappingKeyId /* @out */) = 0;
 
@@ -20,4 +20,5 @@
 #pragma once
 
 #include "ICryptography.h"
+#include "AsyncCryptography.h"
 #include "INetflixSecurity.h"
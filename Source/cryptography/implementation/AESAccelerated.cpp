@@ -0,0 +1,386 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "AESAccelerated.h"
+
+#include <string.h>
+
+// Only the kernels are compiled for the AES instructions, so the library still runs on CPUs without them;
+// Available() tells whether they can be used.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define AES_AESNI 1
+#include <cpuid.h>
+#include <wmmintrin.h>
+#include <emmintrin.h>
+#define AES_TARGET __attribute__((target("aes,sse2")))
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__) && defined(__linux__)
+#define AES_ARMV8 1
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#if defined(__clang__)
+#define AES_TARGET __attribute__((target("crypto")))
+#else
+#define AES_TARGET __attribute__((target("+crypto")))
+#endif
+#endif
+
+namespace Implementation {
+
+namespace AESAccelerated {
+
+#if defined(AES_AESNI) || defined(AES_ARMV8)
+
+namespace {
+
+    // Blocks in flight for the modes that allow it, enough to cover the latency of the AES units.
+    static constexpr uint8_t PIPELINE = 4;
+
+#if defined(AES_AESNI)
+    typedef __m128i Block;
+
+    AES_TARGET inline Block Load(const uint8_t data[])
+    {
+        return (_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)));
+    }
+    AES_TARGET inline void Store(uint8_t data[], const Block block)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data), block);
+    }
+    AES_TARGET inline Block Xor(const Block a, const Block b)
+    {
+        return (_mm_xor_si128(a, b));
+    }
+    AES_TARGET inline uint32_t SubWord(const uint32_t word)
+    {
+        // All columns equal, so ShiftRows is a no-op and only SubBytes remains
+        return (static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_aesenclast_si128(_mm_set1_epi32(static_cast<int>(word)), _mm_setzero_si128()))));
+    }
+    AES_TARGET inline Block InverseMixColumns(const Block block)
+    {
+        return (_mm_aesimc_si128(block));
+    }
+
+    template <uint8_t COUNT>
+    AES_TARGET inline void Encrypt(const Block schedule[], const uint8_t rounds, Block blocks[])
+    {
+        for (uint8_t i = 0; i < COUNT; i++) {
+            blocks[i] = _mm_xor_si128(blocks[i], schedule[0]);
+        }
+        for (uint8_t round = 1; round < rounds; round++) {
+            for (uint8_t i = 0; i < COUNT; i++) {
+                blocks[i] = _mm_aesenc_si128(blocks[i], schedule[round]);
+            }
+        }
+        for (uint8_t i = 0; i < COUNT; i++) {
+            blocks[i] = _mm_aesenclast_si128(blocks[i], schedule[rounds]);
+        }
+    }
+
+    template <uint8_t COUNT>
+    AES_TARGET inline void Decrypt(const Block schedule[], const uint8_t rounds, Block blocks[])
+    {
+        for (uint8_t i = 0; i < COUNT; i++) {
+            blocks[i] = _mm_xor_si128(blocks[i], schedule[0]);
+        }
+        for (uint8_t round = 1; round < rounds; round++) {
+            for (uint8_t i = 0; i < COUNT; i++) {
+                blocks[i] = _mm_aesdec_si128(blocks[i], schedule[round]);
+            }
+        }
+        for (uint8_t i = 0; i < COUNT; i++) {
+            blocks[i] = _mm_aesdeclast_si128(blocks[i], schedule[rounds]);
+        }
+    }
+
+    bool Detect()
+    {
+        unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+        return ((__get_cpuid(1, &eax, &ebx, &ecx, &edx) != 0) && ((ecx & bit_AES) != 0) && ((edx & bit_SSE2) != 0));
+    }
+#else
+    typedef uint8x16_t Block;
+
+    AES_TARGET inline Block Load(const uint8_t data[])
+    {
+        return (vld1q_u8(data));
+    }
+    AES_TARGET inline void Store(uint8_t data[], const Block block)
+    {
+        vst1q_u8(data, block);
+    }
+    AES_TARGET inline Block Xor(const Block a, const Block b)
+    {
+        return (veorq_u8(a, b));
+    }
+    AES_TARGET inline uint32_t SubWord(const uint32_t word)
+    {
+        // All columns equal, so ShiftRows is a no-op and only SubBytes remains
+        return (vgetq_lane_u32(vreinterpretq_u32_u8(vaeseq_u8(vreinterpretq_u8_u32(vdupq_n_u32(word)), vdupq_n_u8(0))), 0));
+    }
+    AES_TARGET inline Block InverseMixColumns(const Block block)
+    {
+        return (vaesimcq_u8(block));
+    }
+
+    // AESE/AESD add the round key first, so the last round key is added separately.
+    template <uint8_t COUNT>
+    AES_TARGET inline void Encrypt(const Block schedule[], const uint8_t rounds, Block blocks[])
+    {
+        for (uint8_t round = 0; round < (rounds - 1); round++) {
+            for (uint8_t i = 0; i < COUNT; i++) {
+                blocks[i] = vaesmcq_u8(vaeseq_u8(blocks[i], schedule[round]));
+            }
+        }
+        for (uint8_t i = 0; i < COUNT; i++) {
+            blocks[i] = veorq_u8(vaeseq_u8(blocks[i], schedule[rounds - 1]), schedule[rounds]);
+        }
+    }
+
+    template <uint8_t COUNT>
+    AES_TARGET inline void Decrypt(const Block schedule[], const uint8_t rounds, Block blocks[])
+    {
+        for (uint8_t round = 0; round < (rounds - 1); round++) {
+            for (uint8_t i = 0; i < COUNT; i++) {
+                blocks[i] = vaesimcq_u8(vaesdq_u8(blocks[i], schedule[round]));
+            }
+        }
+        for (uint8_t i = 0; i < COUNT; i++) {
+            blocks[i] = veorq_u8(vaesdq_u8(blocks[i], schedule[rounds - 1]), schedule[rounds]);
+        }
+    }
+
+    bool Detect()
+    {
+        return ((getauxval(AT_HWCAP) & HWCAP_AES) != 0);
+    }
+#endif
+
+    AES_TARGET inline void LoadSchedule(const uint8_t source[][16], const uint8_t rounds, Block schedule[])
+    {
+        for (uint8_t round = 0; round <= rounds; round++) {
+            schedule[round] = Load(source[round]);
+        }
+    }
+
+    inline void Increment(uint8_t counter[16])
+    {
+        uint8_t index = 16;
+        while ((index > 0) && (++counter[--index] == 0)) {
+        }
+    }
+
+} // namespace
+
+bool Available()
+{
+    static const bool available = Detect();
+    return (available);
+}
+
+AES_TARGET bool Prepare(const uint8_t length, const uint8_t key[], Key& prepared)
+{
+    bool result = false;
+
+    if ((length == 16) || (length == 24) || (length == 32)) {
+        // FIPS-197 key expansion in native words, SubWord is done by the AES unit itself
+        const uint8_t nk = (length / 4);
+        const uint8_t rounds = (nk + 6);
+        const uint8_t total = (4 * (rounds + 1));
+        uint32_t words[4 * 15];
+        uint32_t rcon = 0x01;
+
+        ::memcpy(words, key, length);
+
+        for (uint8_t i = nk; i < total; i++) {
+            uint32_t temp = words[i - 1];
+
+            if ((i % nk) == 0) {
+                // RotWord on a little endian word, Rcon goes into the first byte
+                temp = (SubWord((temp >> 8) | (temp << 24)) ^ rcon);
+                rcon = ((rcon << 1) ^ (((rcon >> 7) & 1) * 0x11B));
+            } else if ((nk > 6) && ((i % nk) == 4)) {
+                temp = SubWord(temp);
+            }
+
+            words[i] = (words[i - nk] ^ temp);
+        }
+
+        ::memcpy(prepared.encrypt, words, (total * sizeof(uint32_t)));
+        ::memset(words, 0, sizeof(words));
+
+        // Equivalent inverse cipher: the rounds reversed, the inner ones through InvMixColumns
+        Store(prepared.decrypt[0], Load(prepared.encrypt[rounds]));
+        for (uint8_t round = 1; round < rounds; round++) {
+            Store(prepared.decrypt[round], InverseMixColumns(Load(prepared.encrypt[rounds - round])));
+        }
+        Store(prepared.decrypt[rounds], Load(prepared.encrypt[0]));
+
+        prepared.rounds = rounds;
+        result = true;
+    }
+
+    return (result);
+}
+
+AES_TARGET void ECB(const Key& key, const bool encrypt, const uint32_t length, const uint8_t input[], uint8_t output[])
+{
+    Block schedule[15];
+    Block blocks[PIPELINE];
+    uint32_t offset = 0;
+
+    LoadSchedule((encrypt == true ? key.encrypt : key.decrypt), key.rounds, schedule);
+
+    for (; (offset + (PIPELINE * 16)) <= length; offset += (PIPELINE * 16)) {
+        for (uint8_t i = 0; i < PIPELINE; i++) {
+            blocks[i] = Load(input + offset + (i * 16));
+        }
+        if (encrypt == true) {
+            Encrypt<PIPELINE>(schedule, key.rounds, blocks);
+        } else {
+            Decrypt<PIPELINE>(schedule, key.rounds, blocks);
+        }
+        for (uint8_t i = 0; i < PIPELINE; i++) {
+            Store(output + offset + (i * 16), blocks[i]);
+        }
+    }
+
+    for (; (offset + 16) <= length; offset += 16) {
+        blocks[0] = Load(input + offset);
+        if (encrypt == true) {
+            Encrypt<1>(schedule, key.rounds, blocks);
+        } else {
+            Decrypt<1>(schedule, key.rounds, blocks);
+        }
+        Store(output + offset, blocks[0]);
+    }
+}
+
+AES_TARGET void CBC(const Key& key, const bool encrypt, uint8_t iv[16], const uint32_t length, const uint8_t input[], uint8_t output[])
+{
+    Block schedule[15];
+    Block blocks[PIPELINE];
+    Block chain = Load(iv);
+    uint32_t offset = 0;
+
+    if (encrypt == true) {
+        // Every block depends on the previous one, so encryption stays serial
+        LoadSchedule(key.encrypt, key.rounds, schedule);
+
+        for (; (offset + 16) <= length; offset += 16) {
+            blocks[0] = Xor(Load(input + offset), chain);
+            Encrypt<1>(schedule, key.rounds, blocks);
+            chain = blocks[0];
+            Store(output + offset, chain);
+        }
+    } else {
+        LoadSchedule(key.decrypt, key.rounds, schedule);
+
+        for (; (offset + (PIPELINE * 16)) <= length; offset += (PIPELINE * 16)) {
+            Block previous[PIPELINE];
+            for (uint8_t i = 0; i < PIPELINE; i++) {
+                previous[i] = Load(input + offset + (i * 16));
+                blocks[i] = previous[i];
+            }
+            Decrypt<PIPELINE>(schedule, key.rounds, blocks);
+            Store(output + offset, Xor(blocks[0], chain));
+            for (uint8_t i = 1; i < PIPELINE; i++) {
+                Store(output + offset + (i * 16), Xor(blocks[i], previous[i - 1]));
+            }
+            chain = previous[PIPELINE - 1];
+        }
+
+        for (; (offset + 16) <= length; offset += 16) {
+            const Block previous = Load(input + offset);
+            blocks[0] = previous;
+            Decrypt<1>(schedule, key.rounds, blocks);
+            Store(output + offset, Xor(blocks[0], chain));
+            chain = previous;
+        }
+    }
+
+    Store(iv, chain);
+}
+
+AES_TARGET void CTR(const Key& key, uint8_t counter[16], const uint32_t length, const uint8_t input[], uint8_t output[])
+{
+    Block schedule[15];
+    Block blocks[PIPELINE];
+    uint32_t offset = 0;
+
+    LoadSchedule(key.encrypt, key.rounds, schedule);
+
+    for (; (offset + (PIPELINE * 16)) <= length; offset += (PIPELINE * 16)) {
+        for (uint8_t i = 0; i < PIPELINE; i++) {
+            blocks[i] = Load(counter);
+            Increment(counter);
+        }
+        Encrypt<PIPELINE>(schedule, key.rounds, blocks);
+        for (uint8_t i = 0; i < PIPELINE; i++) {
+            Store(output + offset + (i * 16), Xor(blocks[i], Load(input + offset + (i * 16))));
+        }
+    }
+
+    for (; offset < length; offset += 16) {
+        blocks[0] = Load(counter);
+        Increment(counter);
+        Encrypt<1>(schedule, key.rounds, blocks);
+
+        if ((offset + 16) <= length) {
+            Store(output + offset, Xor(blocks[0], Load(input + offset)));
+        } else {
+            uint8_t stream[16];
+            Store(stream, blocks[0]);
+            for (uint32_t index = offset; index < length; index++) {
+                output[index] = (input[index] ^ stream[index - offset]);
+            }
+            ::memset(stream, 0, sizeof(stream));
+        }
+    }
+}
+
+#else
+
+bool Available()
+{
+    return (false);
+}
+
+bool Prepare(const uint8_t, const uint8_t[], Key&)
+{
+    return (false);
+}
+
+void ECB(const Key&, const bool, const uint32_t, const uint8_t[], uint8_t[])
+{
+}
+
+void CBC(const Key&, const bool, uint8_t[16], const uint32_t, const uint8_t[], uint8_t[])
+{
+}
+
+void CTR(const Key&, uint8_t[16], const uint32_t, const uint8_t[], uint8_t[])
+{
+}
+
+#endif
+
+} // namespace AESAccelerated
+
+} // namespace Implementation
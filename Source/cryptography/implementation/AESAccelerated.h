@@ -0,0 +1,52 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace Implementation {
+
+namespace AESAccelerated {
+
+    // True if the kernels are built in and the CPU has the AES instructions (AES-NI on x86,
+    // the Crypto Extensions on ARMv8), checked once at runtime.
+    bool Available();
+
+    // Expanded key, decrypt holds the schedule for the equivalent inverse cipher.
+    struct Key {
+        uint8_t rounds;
+        uint8_t encrypt[15][16];
+        uint8_t decrypt[15][16];
+    };
+
+    // Key lengths of 16, 24 and 32 bytes are supported.
+    bool Prepare(const uint8_t length, const uint8_t key[], Key& prepared);
+
+    // ECB and CBC process whole blocks only, so length has to be a multiple of 16. CBC updates iv
+    // to the last ciphertext block.
+    void ECB(const Key& key, const bool encrypt, const uint32_t length, const uint8_t input[], uint8_t output[]);
+    void CBC(const Key& key, const bool encrypt, uint8_t iv[16], const uint32_t length, const uint8_t input[], uint8_t output[]);
+
+    // Any length, counter is the big endian initial counter block and is advanced past the data.
+    void CTR(const Key& key, uint8_t counter[16], const uint32_t length, const uint8_t input[], uint8_t output[]);
+
+} // namespace AESAccelerated
+
+} // namespace Implementation
@@ -30,8 +30,10 @@
 #include <openssl/hmac.h>
 #include <openssl/sha.h>
 
+#include <atomic>
 #include <limits.h>
 
+#include "../Parallel.h"
 #include "Vault.h"
 
 struct CipherImplementation {
@@ -43,6 +45,27 @@ struct CipherImplementation {
         const uint32_t inputLength, const uint8_t input[],
         const uint32_t maxOutputLength, uint8_t output[]) const = 0;
 
+    // Authenticated encryption, only available on ciphers created with cipher_create_aead()
+    virtual int32_t Seal(const uint8_t /* ivLength */, const uint8_t /* iv */[],
+        const uint16_t /* aadLength */, const uint8_t /* aad */[],
+        const uint32_t /* inputLength */, const uint8_t /* input */[],
+        const uint32_t /* maxOutputLength */, uint8_t /* output */[],
+        const uint8_t /* tagLength */, uint8_t /* tag */[]) const
+    {
+        TRACE_L1("Not an authenticated cipher");
+        return (0);
+    }
+
+    virtual int32_t Open(const uint8_t /* ivLength */, const uint8_t /* iv */[],
+        const uint16_t /* aadLength */, const uint8_t /* aad */[],
+        const uint32_t /* inputLength */, const uint8_t /* input */[],
+        const uint32_t /* maxOutputLength */, uint8_t /* output */[],
+        const uint8_t /* tagLength */, const uint8_t /* tag */[]) const
+    {
+        TRACE_L1("Not an authenticated cipher");
+        return (0);
+    }
+
     virtual ~CipherImplementation() {}
 };
 
@@ -65,30 +88,18 @@ public:
     Cipher& operator=(const Cipher) = delete;
     Cipher() = delete;
 
-    Cipher(const Implementation::Vault* vault, const EVP_CIPHER* cipher, const uint32_t keyId, const uint8_t keyLength, const uint8_t ivLength)
-        : _context(nullptr)
-        , _vault(vault)
+    Cipher(const std::shared_ptr<const Implementation::Vault::PreparedKey>& key, const EVP_CIPHER* cipher, const uint8_t ivLength, const bool parallel)
+        : _key(key)
         , _cipher(cipher)
-        , _keyId(keyId)
-        , _keyLength(keyLength)
         , _ivLength(ivLength)
+        , _parallel(parallel)
     {
-        ASSERT(vault != nullptr);
+        ASSERT(key != nullptr);
         ASSERT(cipher != nullptr);
-        ASSERT(keyId != 0);
-        ASSERT(keyLength != 0);
         ASSERT(ivLength != 0);
-
-        _context = EVP_CIPHER_CTX_new();
-        ASSERT(_context != nullptr);
     }
 
-    ~Cipher() override
-    {
-        if (_context != nullptr) {
-            EVP_CIPHER_CTX_free(_context);
-        }
-    }
+    ~Cipher() override = default;
 
     int32_t Encrypt(const uint8_t ivLength, const uint8_t iv[],
         const uint32_t inputLength, const uint8_t input[],
@@ -124,39 +135,239 @@ private:
             TRACE_L1("Too small output buffer, expected: %i bytes", inputLength);
             result = (-static_cast<int32_t>(inputLength + (16 - (inputLength % 16))));
         } else {
-            uint8_t* keyBuf = reinterpret_cast<uint8_t*>(ALLOCA(_keyLength));
-            ASSERT(keyBuf != nullptr);
+            const uint16_t chunks = (_parallel == true ? Parallel::Instance().Chunks(inputLength) : 1);
+
+            if (chunks > 1) {
+                result = Split(encrypt, chunks, iv, inputLength, input, output);
+            } else {
+                result = Process(encrypt, iv, inputLength, input, output, true);
+            }
 
-            uint16_t length = _vault->Export(_keyId, _keyLength, keyBuf, true);
-            ASSERT(length != 0);
+            if (result != 0) {
+                TRACE_L2("Completed %scryption, input size: %i, output size: %i",
+                    (encrypt ? "en" : "de"), inputLength, result);
+            }
+        }
 
-            if (length != _keyLength) {
-                TRACE_L1("Failed to retrieve a valid encryption key from id 0x%08x", _keyId);
+        return (result);
+    }
+
+    // ECB and CTR only: the input is cut in block aligned chunks that are run on the worker pool,
+    // each with its own context and the CTR counter advanced to the first block of the chunk.
+    int32_t Split(bool encrypt, const uint16_t chunks, const uint8_t iv[],
+        const uint32_t inputLength, const uint8_t input[], uint8_t output[]) const
+    {
+        int32_t result = 0;
+
+        // The last two blocks stay with the tail, so the padding (ECB) is added or checked as in a single
+        // pass and the tail always has output, even if the last block is padding only.
+        const uint32_t bulk = (((inputLength / Parallel::BlockSize) - 2) * Parallel::BlockSize);
+        std::atomic<bool> failed(false);
+
+        Parallel::Instance().Run(chunks, [&](const uint16_t chunk) {
+            const uint32_t begin = Parallel::Offset(bulk, chunks, chunk);
+            const uint32_t length = (Parallel::Offset(bulk, chunks, chunk + 1) - begin);
+
+            uint8_t counter[Parallel::BlockSize];
+            ::memcpy(counter, iv, sizeof(counter));
+            Parallel::Advance(counter, (begin / Parallel::BlockSize));
+
+            if (Process(encrypt, counter, length, (input + begin), (output + begin), false) != static_cast<int32_t>(length)) {
+                failed = true;
+            }
+        });
+
+        if (failed == false) {
+            uint8_t counter[Parallel::BlockSize];
+            ::memcpy(counter, iv, sizeof(counter));
+            Parallel::Advance(counter, (bulk / Parallel::BlockSize));
+
+            const int32_t tail = Process(encrypt, counter, (inputLength - bulk), (input + bulk), (output + bulk), true);
+
+            if (tail != 0) {
+                result = (bulk + tail);
+            }
+        }
+
+        return (result);
+    }
+
+    int32_t Process(bool encrypt, const uint8_t iv[],
+        const uint32_t inputLength, const uint8_t input[], uint8_t output[], const bool padding) const
+    {
+        int32_t result = 0;
+
+        // A context per operation, so concurrent callers of the same cipher do not share state.
+        // It is copied from the prepared key, so the key schedule is not set up again.
+        EVP_CIPHER_CTX* context = EVP_CIPHER_CTX_new();
+        ASSERT(context != nullptr);
+
+        ERR_clear_error();
+        int len = 0;
+        int initResult = 0;
+
+        if ((context != nullptr) && (_key->Cipher(_cipher, encrypt, context) == true)) {
+            initResult = EVP_CipherInit_ex(context, nullptr, nullptr, nullptr, iv, -1);
+
+            if ((initResult != 0) && (padding == false)) {
+                EVP_CIPHER_CTX_set_padding(context, 0);
+            }
+        }
+
+        if (initResult == 0) {
+            TRACE_L1("EVP_CipherInit_ex() failed: %s", GetSSLError().c_str());
+        } else {
+            if (EVP_CipherUpdate(context, output, &len, input, inputLength) == 0) {
+                TRACE_L1("EVP_CipherUpdate() failed: %s", GetSSLError().c_str());
             } else {
-                ERR_clear_error();
-                int len = 0;
-                int initResult = EVP_CipherInit_ex(_context, _cipher, nullptr, keyBuf, iv, encrypt);
-                ::memset(keyBuf, 0xFF, length);
+                result = len;
+                len = 0;
+                // Note: EVP_CipherFinal_ex() can still write to the output buffer!
+                if (EVP_CipherFinal_ex(context, (output + result), &len) == 0) {
+                    TRACE_L1("EVP_CipherFinal_ex() failed: %s", GetSSLError().c_str());
+                    result = 0;
+                } else {
+                    result += len;
+                }
+            }
+        }
+
+        if (context != nullptr) {
+            EVP_CIPHER_CTX_free(context);
+        }
+
+        return (result);
+    }
+
+private:
+    std::shared_ptr<const Implementation::Vault::PreparedKey> _key;
+    const EVP_CIPHER* _cipher;
+    uint8_t _ivLength;
+    bool _parallel;
+};
+
+// AES-GCM and ChaCha20-Poly1305, the cipher and the authenticator run in the same pass over the data.
+class AuthenticatedCipher : public CipherImplementation {
+public:
+    static constexpr uint8_t IV_LENGTH = 12;
+    static constexpr uint8_t MIN_TAG_LENGTH = 12;
+    static constexpr uint8_t MAX_TAG_LENGTH = 16;
+
+public:
+    AuthenticatedCipher(const AuthenticatedCipher&) = delete;
+    AuthenticatedCipher& operator=(const AuthenticatedCipher) = delete;
+    AuthenticatedCipher() = delete;
+
+    AuthenticatedCipher(const std::shared_ptr<const Implementation::Vault::PreparedKey>& key, const EVP_CIPHER* cipher)
+        : _key(key)
+        , _cipher(cipher)
+    {
+        ASSERT(key != nullptr);
+        ASSERT(cipher != nullptr);
+    }
+
+    ~AuthenticatedCipher() override = default;
+
+    int32_t Encrypt(const uint8_t, const uint8_t[], const uint32_t, const uint8_t[], const uint32_t, uint8_t[]) const override
+    {
+        TRACE_L1("An authenticated cipher requires a tag");
+        return (0);
+    }
+
+    int32_t Decrypt(const uint8_t, const uint8_t[], const uint32_t, const uint8_t[], const uint32_t, uint8_t[]) const override
+    {
+        TRACE_L1("An authenticated cipher requires a tag");
+        return (0);
+    }
+
+    int32_t Seal(const uint8_t ivLength, const uint8_t iv[],
+        const uint16_t aadLength, const uint8_t aad[],
+        const uint32_t inputLength, const uint8_t input[],
+        const uint32_t maxOutputLength, uint8_t output[],
+        const uint8_t tagLength, uint8_t tag[]) const override
+    {
+        return (Operation(true, ivLength, iv, aadLength, aad, inputLength, input, maxOutputLength, output, tagLength, tag));
+    }
+
+    int32_t Open(const uint8_t ivLength, const uint8_t iv[],
+        const uint16_t aadLength, const uint8_t aad[],
+        const uint32_t inputLength, const uint8_t input[],
+        const uint32_t maxOutputLength, uint8_t output[],
+        const uint8_t tagLength, const uint8_t tag[]) const override
+    {
+        return (Operation(false, ivLength, iv, aadLength, aad, inputLength, input, maxOutputLength, output, tagLength, const_cast<uint8_t*>(tag)));
+    }
 
-                if (initResult == 0) {
-                    TRACE_L1("EVP_CipherInit_ex() failed: %s", GetSSLError().c_str());
+private:
+    int32_t Operation(bool encrypt,
+        const uint8_t ivLength, const uint8_t iv[],
+        const uint16_t aadLength, const uint8_t aad[],
+        const uint32_t inputLength, const uint8_t input[],
+        const uint32_t maxOutputLength, uint8_t output[],
+        const uint8_t tagLength, uint8_t tag[]) const
+    {
+        int32_t result = 0;
+
+        ASSERT(iv != nullptr);
+        ASSERT(tag != nullptr);
+        ASSERT((aad != nullptr) || (aadLength == 0));
+
+        // A success on an empty plaintext would return 0 as well, as a failure or a forged tag does,
+        // so it is refused rather than reported ambiguously.
+        if (inputLength == 0) {
+            TRACE_L1("Empty plaintext, authenticated ciphers need at least one byte of input");
+        } else if (ivLength != IV_LENGTH) {
+            TRACE_L1("Invalid IV length! [%i]", ivLength);
+        } else if ((tagLength < MIN_TAG_LENGTH) || (tagLength > MAX_TAG_LENGTH)) {
+            TRACE_L1("Invalid tag length! [%i]", tagLength);
+        } else if (maxOutputLength < inputLength) {
+            // Stream modes, no padding involved
+            TRACE_L1("Too small output buffer, expected: %i bytes", inputLength);
+            result = (-static_cast<int32_t>(inputLength));
+        } else {
+            EVP_CIPHER_CTX* context = EVP_CIPHER_CTX_new();
+            ASSERT(context != nullptr);
+
+            ERR_clear_error();
+            int len = 0;
+            bool success = (context != nullptr)
+                && (_key->Cipher(_cipher, encrypt, context) == true)
+                && (EVP_CipherInit_ex(context, nullptr, nullptr, nullptr, iv, -1) != 0)
+                && ((aadLength == 0) || (EVP_CipherUpdate(context, nullptr, &len, aad, aadLength) != 0))
+                && (EVP_CipherUpdate(context, output, &len, input, inputLength) != 0);
+
+            if (success == false) {
+                TRACE_L1("Authenticated %scryption failed: %s", (encrypt ? "en" : "de"), GetSSLError().c_str());
+            } else {
+                result = len;
+                len = 0;
+
+                if (encrypt == true) {
+                    if ((EVP_CipherFinal_ex(context, (output + result), &len) == 0)
+                        || (EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_AEAD_GET_TAG, tagLength, tag) == 0)) {
+                        TRACE_L1("Failed to calculate the tag: %s", GetSSLError().c_str());
+                        result = 0;
+                    } else {
+                        result += len;
+                    }
                 } else {
-                    if (EVP_CipherUpdate(_context, output, &len, input, inputLength) == 0) {
-                        TRACE_L1("EVP_CipherUpdate() failed: %s", GetSSLError().c_str());
+                    // The tag is checked by the final call, on mismatch the plaintext is not handed out.
+                    if ((EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_AEAD_SET_TAG, tagLength, tag) == 0)
+                        || (EVP_CipherFinal_ex(context, (output + result), &len) <= 0)) {
+                        TRACE_L1("Tag verification failed");
+                        OPENSSL_cleanse(output, inputLength);
+                        result = 0;
                     } else {
-                        result = len;
-                        len = 0;
-                        // Note: EVP_CipherFinal_ex() can still write to the output buffer!
-                        if (EVP_CipherFinal_ex(_context, (output + result), &len) == 0) {
-                            TRACE_L1("EVP_CipherFinal_ex() failed: %s", GetSSLError().c_str());
-                            result = 0;
-                        } else {
-                            result += len;
-                            TRACE_L2("Completed %scryption, input size: %i, output size: %i",
-                                (encrypt ? "en" : "de"), inputLength, result);
-                        }
+                        result += len;
                     }
                 }
+
+                TRACE_L2("Completed authenticated %scryption, input size: %i, output size: %i",
+                    (encrypt ? "en" : "de"), inputLength, result);
+            }
+
+            if (context != nullptr) {
+                EVP_CIPHER_CTX_free(context);
             }
         }
 
@@ -164,12 +375,8 @@ private:
     }
 
 private:
-    EVP_CIPHER_CTX* _context;
-    const Implementation::Vault* _vault;
+    std::shared_ptr<const Implementation::Vault::PreparedKey> _key;
     const EVP_CIPHER* _cipher;
-    uint32_t _keyId;
-    uint8_t _keyLength;
-    uint8_t _ivLength;
 };
 
 const EVP_CIPHER* AESCipher(const uint8_t keySize, const aes_mode mode)
@@ -237,14 +444,65 @@ struct CipherImplementation* cipher_create_aes(const struct VaultImplementation*
     CipherImplementation* cipher = nullptr;
     const Implementation::Vault* vaultImpl = reinterpret_cast<const Implementation::Vault*>(vault);
 
-    uint16_t keyLength = vaultImpl->Size(key_id, true);
-    if ((keyLength == 0) || (keyLength > 0xFF)) {
+    std::shared_ptr<const Implementation::Vault::PreparedKey> key = vaultImpl->Prepare(key_id);
+    if ((key == nullptr) || (key->Length() > 0xFF)) {
         TRACE_L1("Key 0x%08x does not exist", key_id);
     } else {
-        const EVP_CIPHER* evpcipher = Implementation::AESCipher(static_cast<uint8_t>(keyLength), mode);
+        const EVP_CIPHER* evpcipher = Implementation::AESCipher(static_cast<uint8_t>(key->Length()), mode);
         ASSERT(evpcipher != nullptr);
         if (evpcipher != nullptr) {
-            cipher = new Implementation::Cipher(vaultImpl, evpcipher, key_id, static_cast<uint8_t>(keyLength), 16);
+            // Only the modes without chaining between the blocks can be split over the worker pool.
+            cipher = new Implementation::Cipher(key, evpcipher, 16, ((mode == aes_mode::AES_MODE_ECB) || (mode == aes_mode::AES_MODE_CTR)));
+        }
+    }
+
+    return (cipher);
+}
+
+struct CipherImplementation* cipher_create_aead(const struct VaultImplementation* vault, const aead_mode mode, const uint32_t key_id)
+{
+    ASSERT(vault != nullptr);
+
+    CipherImplementation* cipher = nullptr;
+    const Implementation::Vault* vaultImpl = reinterpret_cast<const Implementation::Vault*>(vault);
+
+    std::shared_ptr<const Implementation::Vault::PreparedKey> key = vaultImpl->Prepare(key_id);
+    if (key == nullptr) {
+        TRACE_L1("Key 0x%08x does not exist", key_id);
+    } else {
+        const EVP_CIPHER* evpcipher = nullptr;
+
+        if (mode == aead_mode::AEAD_MODE_AES_GCM) {
+            switch (key->Length()) {
+            case 16:
+                evpcipher = EVP_aes_128_gcm();
+                break;
+            case 24:
+                evpcipher = EVP_aes_192_gcm();
+                break;
+            case 32:
+                evpcipher = EVP_aes_256_gcm();
+                break;
+            default:
+                TRACE_L1("Unsupported AES key size: %i bits", (key->Length() * 8));
+                break;
+            }
+        } else if (mode == aead_mode::AEAD_MODE_CHACHA20_POLY1305) {
+#if (OPENSSL_VERSION_NUMBER >= 0x10100000L) && !defined(OPENSSL_NO_CHACHA) && !defined(OPENSSL_NO_POLY1305)
+            if (key->Length() == 32) {
+                evpcipher = EVP_chacha20_poly1305();
+            } else {
+                TRACE_L1("Unsupported ChaCha20 key size: %i bits", (key->Length() * 8));
+            }
+#else
+            TRACE_L1("ChaCha20-Poly1305 is not available in this OpenSSL build");
+#endif
+        } else {
+            TRACE_L1("Unsupported AEAD mode %i", mode);
+        }
+
+        if (evpcipher != nullptr) {
+            cipher = new Implementation::AuthenticatedCipher(key, evpcipher);
         }
     }
 
@@ -271,4 +529,22 @@ int32_t cipher_decrypt(const struct CipherImplementation* cipher, const uint8_t
     return (cipher->Decrypt(iv_length, iv, input_length, input, max_output_length, output));
 }
 
+int32_t cipher_aead_encrypt(const struct CipherImplementation* cipher, const uint8_t iv_length, const uint8_t iv[],
+    const uint16_t aad_length, const uint8_t aad[],
+    const uint32_t input_length, const uint8_t input[], const uint32_t max_output_length, uint8_t output[],
+    const uint8_t tag_length, uint8_t tag[])
+{
+    ASSERT(cipher != nullptr);
+    return (cipher->Seal(iv_length, iv, aad_length, aad, input_length, input, max_output_length, output, tag_length, tag));
+}
+
+int32_t cipher_aead_decrypt(const struct CipherImplementation* cipher, const uint8_t iv_length, const uint8_t iv[],
+    const uint16_t aad_length, const uint8_t aad[],
+    const uint32_t input_length, const uint8_t input[], const uint32_t max_output_length, uint8_t output[],
+    const uint8_t tag_length, const uint8_t tag[])
+{
+    ASSERT(cipher != nullptr);
+    return (cipher->Open(iv_length, iv, aad_length, aad, input_length, input, max_output_length, output, tag_length, tag));
+}
+
 } // extern "C"
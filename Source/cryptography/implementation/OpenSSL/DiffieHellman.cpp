@@ -28,6 +28,13 @@
 #include <openssl/rsa.h>
 
 #include <diffiehellman_implementation.h>
+
+#include <algorithm>
+#include <list>
+#include <map>
+#include <memory>
+#include <tuple>
+
 #include "Vault.h"
 #include "Derive.h"
 
@@ -67,30 +74,19 @@ public:
         return (_vault->Import(keySize, keyBuf, exportable));
     }
 
-    uint32_t Serialize(const DH* key)
+    uint32_t Serialize(const BIGNUM* p, const BIGNUM* g, const BIGNUM* privateKey, const BIGNUM* publicKey)
     {
-        ASSERT(key != nullptr);
+        ASSERT(p != nullptr);
+        ASSERT(g != nullptr);
+        ASSERT(privateKey != nullptr);
+        ASSERT(publicKey != nullptr);
 
         DHKeyHeader header;
 
-        #if OPENSSL_VERSION_NUMBER  >= 0x10100000L 
-        const BIGNUM* p;
-        const BIGNUM* g;
-        const BIGNUM* pub_key;
-        const BIGNUM* priv_key;
-
-        DH_get0_pqg(key, &p, nullptr, &g);
-        DH_get0_key(key, &pub_key, &priv_key);
         header.primeSize = BN_num_bytes(p);
         header.generatorSize = BN_num_bytes(g);
-        header.privateKeySize = BN_num_bytes(priv_key);
-        header.publicKeySize = BN_num_bytes(pub_key);
-        #else
-        header.primeSize = BN_num_bytes(key->p);
-        header.generatorSize = BN_num_bytes(key->g);
-        header.privateKeySize = BN_num_bytes(key->priv_key);
-        header.publicKeySize = BN_num_bytes(key->pub_key);
-        #endif
+        header.privateKeySize = BN_num_bytes(privateKey);
+        header.publicKeySize = BN_num_bytes(publicKey);
 
         uint32_t keySize = (sizeof(header) + header.primeSize + header.generatorSize + header.privateKeySize + header.publicKeySize);
         ASSERT(keySize < USHRT_MAX);
@@ -101,22 +97,15 @@ public:
         ::memcpy(keyBuf, &header, sizeof(header));
         uint16_t offset = sizeof(header);
 
-#if OPENSSL_VERSION_NUMBER  >= 0x10100000L 
-        DH_get0_pqg(key, &p, nullptr, &g);
-        DH_get0_key(key, &pub_key, &priv_key);
-
         offset += BN_bn2bin(p, keyBuf + offset);
         offset += BN_bn2bin(g, keyBuf + offset);
-        offset += BN_bn2bin(priv_key, keyBuf + offset);
-        offset += BN_bn2bin(pub_key, keyBuf + offset);
-#else
-        offset += BN_bn2bin(key->p, keyBuf + offset);
-        offset += BN_bn2bin(key->g, keyBuf + offset);
-        offset += BN_bn2bin(key->priv_key, keyBuf + offset);
-        offset += BN_bn2bin(key->pub_key, keyBuf + offset);
-#endif
+        offset += BN_bn2bin(privateKey, keyBuf + offset);
+        offset += BN_bn2bin(publicKey, keyBuf + offset);
 
-        return (_vault->Import(keySize, keyBuf, false /* DH private key always sealed */));
+        uint32_t id = _vault->Import(keySize, keyBuf, false /* DH private key always sealed */);
+        ::memset(keyBuf, 0xFF, keySize);
+
+        return (id);
     }
 
     void Deserialize(const uint32_t keyId, DH*& key)
@@ -211,6 +200,335 @@ private:
     Implementation::Vault* _vault;
 }; //class KeyStore
 
+// Parsing and checking the group parameters and setting up the Montgomery context is done once per group,
+// and a few key pairs per group are generated ahead of time on a background thread, so generating a key
+// pair is mostly a matter of handing out a precomputed one.
+class DiffieHellmanGroups {
+private:
+    static constexpr uint8_t MAX_GROUPS = 8;
+    static constexpr uint8_t POOL_SIZE = 4;
+
+public:
+    struct KeyPair {
+        BIGNUM* privateKey;
+        BIGNUM* publicKey;
+    };
+
+    class Group {
+    public:
+        Group() = delete;
+        Group(const Group&) = delete;
+        Group& operator=(const Group&) = delete;
+
+        Group(const uint8_t generator, const uint16_t modulusSize, const uint8_t modulus[])
+            : _lock()
+            , _pool()
+            , _p(BN_bin2bn(modulus, modulusSize, nullptr))
+            , _g(BN_new())
+            , _mont(BN_MONT_CTX_new())
+            , _valid(false)
+        {
+            ASSERT(_p != nullptr);
+            ASSERT(_g != nullptr);
+            ASSERT(_mont != nullptr);
+
+            if ((_p != nullptr) && (_g != nullptr) && (_mont != nullptr) && (BN_set_word(_g, generator) != 0)) {
+                _valid = (Check() == true) && (Montgomery() == true);
+            }
+        }
+        ~Group()
+        {
+            Clear();
+
+            BN_MONT_CTX_free(_mont);
+            BN_free(_g);
+            BN_free(_p);
+        }
+
+    public:
+        bool IsValid() const
+        {
+            return (_valid);
+        }
+        const BIGNUM* Prime() const
+        {
+            return (_p);
+        }
+        const BIGNUM* Generator() const
+        {
+            return (_g);
+        }
+
+        // Same key size as DH_generate_key(), the public key is calculated with the cached Montgomery context.
+        bool Generate(KeyPair& pair) const
+        {
+            bool result = false;
+
+            BN_CTX* ctx = BN_CTX_new();
+            pair.privateKey = BN_new();
+            pair.publicKey = BN_new();
+
+            if ((ctx != nullptr) && (pair.privateKey != nullptr) && (pair.publicKey != nullptr)) {
+                do {
+                    // top -1: any number of bits, bottom 0: may be even
+                    result = (BN_rand(pair.privateKey, (BN_num_bits(_p) - 1), -1, 0) != 0);
+                } while ((result == true) && (BN_is_zero(pair.privateKey) == 1));
+
+                result = (result == true)
+                    && (BN_mod_exp_mont_consttime(pair.publicKey, _g, pair.privateKey, _p, ctx, _mont) != 0);
+            }
+
+            if (result == false) {
+                TRACE_L1("Failed to generate a Diffie-Hellman key pair");
+                BN_clear_free(pair.privateKey);
+                BN_free(pair.publicKey);
+                pair.privateKey = nullptr;
+                pair.publicKey = nullptr;
+            }
+
+            BN_CTX_free(ctx);
+
+            return (result);
+        }
+
+        bool Take(KeyPair& pair)
+        {
+            bool result = false;
+
+            _lock.Lock();
+            if (_pool.empty() == false) {
+                pair = _pool.back();
+                _pool.pop_back();
+                result = true;
+            }
+            _lock.Unlock();
+
+            return (result);
+        }
+
+        // Wipes the pregenerated key pairs, their private keys are in the clear.
+        void Clear()
+        {
+            _lock.Lock();
+
+            for (KeyPair& pair : _pool) {
+                BN_clear_free(pair.privateKey);
+                BN_free(pair.publicKey);
+            }
+
+            _pool.clear();
+
+            _lock.Unlock();
+        }
+
+        // Adds a pregenerated key pair if the pool is not full yet, returns true if one was added.
+        bool Replenish()
+        {
+            bool result = false;
+
+            _lock.Lock();
+            bool needed = (_pool.size() < POOL_SIZE);
+            _lock.Unlock();
+
+            if (needed == true) {
+                KeyPair pair;
+
+                if (Generate(pair) == true) {
+                    _lock.Lock();
+                    _pool.push_back(pair);
+                    _lock.Unlock();
+                    result = true;
+                }
+            }
+
+            return (result);
+        }
+
+    private:
+        bool Check() const
+        {
+            bool result = false;
+
+            DH* dh = DH_new();
+            BIGNUM* p = BN_dup(_p);
+            BIGNUM* g = BN_dup(_g);
+
+            if ((dh != nullptr) && (p != nullptr) && (g != nullptr)) {
+#if OPENSSL_VERSION_NUMBER  >= 0x10100000L
+                DH_set0_pqg(dh, p, nullptr, g);
+#else
+                dh->p = p;
+                dh->g = g;
+#endif
+                p = nullptr;
+                g = nullptr;
+
+                int codes = 0;
+                if ((DH_check(dh, &codes) == 0) || (codes != 0)) {
+                    TRACE_L1("DH parameters are invalid [0x%08x]!", codes);
+                } else {
+                    result = true;
+                }
+            }
+
+            BN_free(p);
+            BN_free(g);
+            DH_free(dh);
+
+            return (result);
+        }
+
+        bool Montgomery()
+        {
+            BN_CTX* ctx = BN_CTX_new();
+            bool result = ((ctx != nullptr) && (BN_MONT_CTX_set(_mont, _p, ctx) != 0));
+            BN_CTX_free(ctx);
+
+            return (result);
+        }
+
+    private:
+        WPEFramework::Core::CriticalSection _lock;
+        std::list<KeyPair> _pool;
+        BIGNUM* _p;
+        BIGNUM* _g;
+        BN_MONT_CTX* _mont;
+        bool _valid;
+    };
+
+private:
+    class Filler : public WPEFramework::Core::Thread {
+    public:
+        Filler() = delete;
+        Filler(const Filler&) = delete;
+        Filler& operator=(const Filler&) = delete;
+
+        Filler(DiffieHellmanGroups& parent)
+            : WPEFramework::Core::Thread(WPEFramework::Core::Thread::DefaultStackSize(), _T("DiffieHellmanPool"))
+            , _parent(parent)
+        {
+        }
+        ~Filler() override = default;
+
+    private:
+        uint32_t Worker() override
+        {
+            _parent.Fill();
+            Block();
+            return (WPEFramework::Core::infinite);
+        }
+
+    private:
+        DiffieHellmanGroups& _parent;
+    };
+
+    friend class WPEFramework::Core::SingletonType<DiffieHellmanGroups>;
+
+    DiffieHellmanGroups()
+        : _lock()
+        , _groups()
+        , _filler(*this)
+    {
+    }
+
+public:
+    DiffieHellmanGroups(const DiffieHellmanGroups&) = delete;
+    DiffieHellmanGroups& operator=(const DiffieHellmanGroups&) = delete;
+
+    // Torn down with Core::Singleton::Dispose(), not in static destruction, as the filler thread has to be
+    // stopped while the rest of the process is still there.
+    ~DiffieHellmanGroups()
+    {
+        _filler.Stop();
+        _filler.Wait(WPEFramework::Core::Thread::STOPPED | WPEFramework::Core::Thread::BLOCKED, WPEFramework::Core::infinite);
+
+        _lock.Lock();
+
+        // A group may still be held by a caller, so do not leave the pregenerated keys to its destruction
+        for (auto& entry : _groups) {
+            entry.second->Clear();
+        }
+
+        _groups.clear();
+
+        _lock.Unlock();
+    }
+
+    static DiffieHellmanGroups& Instance()
+    {
+        return (WPEFramework::Core::SingletonType<DiffieHellmanGroups>::Instance());
+    }
+
+public:
+    std::shared_ptr<Group> Find(const uint8_t generator, const uint16_t modulusSize, const uint8_t modulus[])
+    {
+        std::shared_ptr<Group> group;
+
+        string key(1, static_cast<char>(generator));
+        key.append(reinterpret_cast<const char*>(modulus), modulusSize);
+
+        _lock.Lock();
+
+        auto it = _groups.find(key);
+        if (it != _groups.end()) {
+            group = (*it).second;
+        }
+
+        _lock.Unlock();
+
+        if (group == nullptr) {
+            // Checked outside of the lock, DH_check() is slow
+            group = std::make_shared<Group>(generator, modulusSize, modulus);
+
+            if (group->IsValid() == true) {
+                _lock.Lock();
+
+                if (_groups.size() < MAX_GROUPS) {
+                    group = (*(_groups.emplace(key, group).first)).second;
+                } else {
+                    TRACE_L2("Diffie-Hellman group cache is full, group is not kept");
+                }
+
+                _lock.Unlock();
+            }
+        }
+
+        return (group);
+    }
+
+    void Replenish()
+    {
+        _filler.Run();
+    }
+
+private:
+    void Fill()
+    {
+        bool added = true;
+
+        while ((added == true) && (_filler.IsRunning() == true)) {
+            std::list<std::shared_ptr<Group>> groups;
+
+            _lock.Lock();
+            for (auto& entry : _groups) {
+                groups.push_back(entry.second);
+            }
+            _lock.Unlock();
+
+            added = false;
+
+            for (auto& group : groups) {
+                added = (group->Replenish() || added);
+            }
+        }
+    }
+
+private:
+    WPEFramework::Core::CriticalSection _lock;
+    std::map<string, std::shared_ptr<Group>> _groups;
+    Filler _filler;
+};
+
 uint32_t GenerateDiffieHellmanKeys(KeyStore& store,
                                    const uint8_t generator, const uint16_t modulusSize, const uint8_t modulus[],
                                    uint32_t& privateKeyId, uint32_t& publicKeyId)
@@ -227,58 +545,30 @@ uint32_t GenerateDiffieHellmanKeys(KeyStore& store,
     TRACE_L2("Generator: %i", generator);
     TRACE_L2("Modulus: %02x %02x %02x... (%i bytes)", modulus[0], modulus[1], modulus[2], modulusSize);
 
-    DH* dh = DH_new();
-    ASSERT(dh != nullptr);
+    std::shared_ptr<DiffieHellmanGroups::Group> group = DiffieHellmanGroups::Instance().Find(generator, modulusSize, modulus);
 
-    if (dh == nullptr) {
-        TRACE_L1("DH_new() failed");
+    if (group->IsValid() == false) {
+        TRACE_L1("Invalid Diffie-Hellman group");
     } else {
-#if OPENSSL_VERSION_NUMBER  >= 0x10100000L
-        BIGNUM* p = BN_bin2bn(modulus, modulusSize, NULL);
-        BIGNUM* g = BN_new();
-        ASSERT(p != nullptr);
-        ASSERT(g != nullptr);
-
-        BN_set_word(g, generator);
-
-        if (DH_set0_pqg(dh, p, nullptr, g) == 0) {
-            ASSERT(false);
-        }
-#else
-        dh->p = BN_bin2bn(modulus, modulusSize, NULL);
-        dh->g = BN_new();
-        ASSERT(dh->p != nullptr);
-        ASSERT(dh->g != nullptr);
-
-        BN_set_word(dh->g, generator);
-#endif
+        DiffieHellmanGroups::KeyPair pair;
 
-        int codes = 0;
-        if ((DH_check(dh, &codes) == 0) || (codes != 0)) {
-            TRACE_L1("DH parameters are invalid [0x%08x]!", codes);
-        } else {
-            if (DH_generate_key(dh) == 0) {
-                TRACE_L1("DH_generate_key() failed");
-            } else {
-                privateKeyId = store.Serialize(dh);
-#if OPENSSL_VERSION_NUMBER  >= 0x10100000L
-                const BIGNUM* pub_key;
-                DH_get0_key(dh, &pub_key, nullptr);
-                publicKeyId = store.Serialize(pub_key, true /* public key shall not be sealed */);
-#else
-                publicKeyId = store.Serialize(dh->pub_key, true /* public key shall not be sealed */);
-#endif
+        if ((group->Take(pair) == true) || (group->Generate(pair) == true)) {
+            privateKeyId = store.Serialize(group->Prime(), group->Generator(), pair.privateKey, pair.publicKey);
+            publicKeyId = store.Serialize(pair.publicKey, true /* public key shall not be sealed */);
 
-                ASSERT(privateKeyId != 0);
-                ASSERT(publicKeyId != 0);
+            ASSERT(privateKeyId != 0);
+            ASSERT(publicKeyId != 0);
 
-                if ((privateKeyId != 0) && (publicKeyId != 0)) {
-                    result = 0;
-                }
+            if ((privateKeyId != 0) && (publicKeyId != 0)) {
+                result = 0;
             }
+
+            BN_clear_free(pair.privateKey);
+            BN_free(pair.publicKey);
         }
 
-        DH_free(dh);
+        // Top up the pool for the next caller
+        DiffieHellmanGroups::Instance().Replenish();
     }
 
     return (result);
@@ -358,6 +648,105 @@ uint32_t DiffieHellmanDeriveSecret(KeyStore& store, const uint32_t privateKeyId,
 
 namespace Netflix {
 
+// Remembers the keys derived from a (private key, peer public key, derivation key) triple, so presenting
+// the same keys again (e.g. a MSL handshake on resume) hands out the keys derived before instead of
+// repeating the derivation. An entry is only used while all six keys are still in the vault, handles
+// are not reused. Opt-in: CRYPTOGRAPHY_DERIVED_KEY_CACHE sets the number of entries (0, the default, disables it).
+class DerivedKeyCache {
+public:
+    struct Keys {
+        uint32_t encryption;
+        uint32_t hmac;
+        uint32_t wrapping;
+    };
+
+private:
+    using Source = std::tuple<uint32_t, uint32_t, uint32_t>;
+    using Entries = std::list<std::pair<Source, Keys>>;
+
+    DerivedKeyCache()
+        : _lock()
+        , _entries()
+        , _index()
+        , _size(0)
+    {
+        string value;
+
+        if (WPEFramework::Core::SystemInfo::GetEnvironment(_T("CRYPTOGRAPHY_DERIVED_KEY_CACHE"), value) == true) {
+            _size = static_cast<uint16_t>(std::min(::strtoul(value.c_str(), nullptr, 0), static_cast<unsigned long>(USHRT_MAX)));
+        }
+    }
+
+public:
+    DerivedKeyCache(const DerivedKeyCache&) = delete;
+    DerivedKeyCache& operator=(const DerivedKeyCache&) = delete;
+
+    static DerivedKeyCache& Instance()
+    {
+        static DerivedKeyCache cache;
+        return (cache);
+    }
+
+public:
+    bool Lookup(const Vault& vault, const uint32_t privateKeyId, const uint32_t peerPublicKeyId, const uint32_t derivationKeyId, Keys& keys)
+    {
+        bool result = false;
+
+        if (_size != 0) {
+            WPEFramework::Core::SafeSyncType<WPEFramework::Core::CriticalSection> lock(_lock);
+
+            std::map<Source, Entries::iterator>::iterator index = _index.find(Source(privateKeyId, peerPublicKeyId, derivationKeyId));
+
+            if (index != _index.end()) {
+                const Keys& entry = index->second->second;
+
+                if ((vault.Size(privateKeyId, true) != 0) && (vault.Size(peerPublicKeyId, true) != 0) && (vault.Size(derivationKeyId, true) != 0)
+                    && (vault.Size(entry.encryption, true) != 0) && (vault.Size(entry.hmac, true) != 0) && (vault.Size(entry.wrapping, true) != 0)) {
+
+                    keys = entry;
+                    _entries.splice(_entries.begin(), _entries, index->second);
+                    result = true;
+                } else {
+                    _entries.erase(index->second);
+                    _index.erase(index);
+                }
+            }
+        }
+
+        return (result);
+    }
+
+    void Add(const uint32_t privateKeyId, const uint32_t peerPublicKeyId, const uint32_t derivationKeyId, const Keys& keys)
+    {
+        if (_size != 0) {
+            WPEFramework::Core::SafeSyncType<WPEFramework::Core::CriticalSection> lock(_lock);
+
+            const Source source(privateKeyId, peerPublicKeyId, derivationKeyId);
+            std::map<Source, Entries::iterator>::iterator index = _index.find(source);
+
+            if (index != _index.end()) {
+                _entries.erase(index->second);
+                _index.erase(index);
+            }
+
+            _entries.emplace_front(source, keys);
+            _index.emplace(source, _entries.begin());
+
+            if (_entries.size() > _size) {
+                // Evict the least recently used, the keys themselves stay in the vault.
+                _index.erase(_entries.back().first);
+                _entries.pop_back();
+            }
+        }
+    }
+
+private:
+    WPEFramework::Core::CriticalSection _lock;
+    Entries _entries;
+    std::map<Source, Entries::iterator> _index;
+    uint16_t _size;
+};
+
 uint32_t DiffieHellmanAuthenticatedDeriveSecret(KeyStore& store,
                                                 const uint32_t privateKeyId, const uint32_t peerPublicKeyId, const uint32_t derivationKeyId,
                                                 uint32_t& encryptionKeyId, uint32_t& hmacKeyId, uint32_t& wrappingKeyId)
@@ -506,9 +895,29 @@ uint32_t netflix_security_derive_keys(const uint32_t private_dh_key_id, const ui
     ASSERT(hmac_key_id != nullptr);
     ASSERT(wrapping_key_id != nullptr);
 
-    Implementation::KeyStore store(&Implementation::Vault::NetflixInstance());
-    return (Implementation::Netflix::DiffieHellmanAuthenticatedDeriveSecret(store, private_dh_key_id, peer_public_dh_key_id, derivation_key_id,
-                                                                           (*encryption_key_id), (*hmac_key_id), (*wrapping_key_id)));
+    uint32_t result = 0;
+
+    Implementation::Vault& vault(Implementation::Vault::NetflixInstance());
+    Implementation::Netflix::DerivedKeyCache& cache(Implementation::Netflix::DerivedKeyCache::Instance());
+    Implementation::Netflix::DerivedKeyCache::Keys keys{ 0, 0, 0 };
+
+    if (cache.Lookup(vault, private_dh_key_id, peer_public_dh_key_id, derivation_key_id, keys) == true) {
+        TRACE_L2("Reusing derived keys (encryption: 0x%08x, hmac: 0x%08x, wrapping: 0x%08x)", keys.encryption, keys.hmac, keys.wrapping);
+    } else {
+        Implementation::KeyStore store(&vault);
+        result = Implementation::Netflix::DiffieHellmanAuthenticatedDeriveSecret(store, private_dh_key_id, peer_public_dh_key_id, derivation_key_id,
+                                                                                 keys.encryption, keys.hmac, keys.wrapping);
+
+        if (result == 0) {
+            cache.Add(private_dh_key_id, peer_public_dh_key_id, derivation_key_id, keys);
+        }
+    }
+
+    (*encryption_key_id) = keys.encryption;
+    (*hmac_key_id) = keys.hmac;
+    (*wrapping_key_id) = keys.wrapping;
+
+    return (result);
 }
 
 } // extern "C"
@@ -23,6 +23,10 @@
 
 #include <core/core.h>
 
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
 #include <openssl/sha.h>
 #include <openssl/md5.h>
 #include <openssl/hmac.h>
@@ -34,6 +38,8 @@
 struct HashImplementation {
     virtual uint32_t Ingest(const uint32_t length, const uint8_t data[]) = 0;
     virtual uint8_t Calculate(const uint8_t maxLength, uint8_t data[]) = 0;
+    virtual uint32_t Reset() = 0;
+    virtual HashImplementation* Copy() const = 0;
 
     virtual ~HashImplementation() { }
 };
@@ -73,23 +79,31 @@ namespace Operation {
     // Wrappers to get around different function names for digest and HMAC calculation.
 
     struct Digest {
-        static int Init(EVP_MD_CTX* ctx, EVP_PKEY_CTX **pctx, const EVP_MD *type, EVP_PKEY *pkey) {
-            return (1);
+        // A finished context can be set up for the same digest again and handed out ready to use.
+        static constexpr bool Reusable = true;
+
+        static int Init(EVP_MD_CTX* ctx, const EVP_MD *type, const Vault::PreparedKey* key) {
+            return (EVP_DigestInit_ex(ctx, type, nullptr));
         }
         static int Update(EVP_MD_CTX* ctx, const void* d, size_t cnt) {
             return (EVP_DigestUpdate(ctx, d, cnt));
         }
         static int Final(EVP_MD_CTX* ctx, unsigned char* sig, size_t* siglen) {
             uint32_t siglen32 = static_cast<uint32_t>(*siglen);
-            int rv = EVP_DigestFinal(ctx, sig, &siglen32);
+            // Not EVP_DigestFinal(), that cleans up the context and it could not be restarted.
+            int rv = EVP_DigestFinal_ex(ctx, sig, &siglen32);
             (*siglen) = siglen32;
             return (rv);
         }
     };
 
     struct HMAC {
-        static int Init(EVP_MD_CTX* ctx, EVP_PKEY_CTX **pctx, const EVP_MD *type, EVP_PKEY *pkey) {
-            return (EVP_DigestSignInit(ctx, pctx, type, nullptr, pkey));
+        // A keyed context is bound to its key, it only goes back to the pool empty.
+        static constexpr bool Reusable = false;
+
+        static int Init(EVP_MD_CTX* ctx, const EVP_MD *type, const Vault::PreparedKey* key) {
+            // Starts from the context the vault keyed once, the key schedule is not redone.
+            return (((key != nullptr) && (key->HMAC(type, ctx) == true)) ? 1 : 0);
         }
         static int Update(EVP_MD_CTX* ctx, const void* d, size_t cnt) {
             return (EVP_DigestSignUpdate(ctx, d, cnt));
@@ -101,66 +115,208 @@ namespace Operation {
 
 } // namespace Operation
 
+// Per thread free lists of the contexts and hash objects of finished calculations, so creating a hash
+// does not allocate in the steady state. Digest contexts are kept initialized for the digest they were
+// used with; a hash may be destroyed on another thread than the one it was created on.
+class Pool {
+private:
+    static constexpr uint8_t Capacity = 16;
+
+    explicit Pool(bool& disposed)
+        : _contexts()
+        , _blocks()
+        , _disposed(disposed)
+    {
+        _contexts.reserve(Capacity);
+        _blocks.reserve(Capacity);
+    }
+
+public:
+    Pool() = delete;
+    Pool(const Pool&) = delete;
+    Pool& operator=(const Pool&) = delete;
+
+    ~Pool()
+    {
+        _disposed = true;
+
+        for (auto& entry : _contexts) {
+            EVP_MD_CTX_destroy(entry.second);
+        }
+
+        for (auto& entry : _blocks) {
+            ::operator delete(entry.second);
+        }
+    }
+
+    // The pool of the calling thread, nullptr once that thread is on its way out.
+    static Pool* Instance()
+    {
+        // Trivially destructible, so it can still be read after the pool is gone.
+        static thread_local bool disposed = false;
+        static thread_local Pool pool(disposed);
+
+        return (disposed == true ? nullptr : &pool);
+    }
+
+public:
+    // A context initialized for digest if one is available (ready is set), else an empty or stale one.
+    EVP_MD_CTX* Context(const EVP_MD* digest, bool& ready)
+    {
+        EVP_MD_CTX* result = nullptr;
+
+        ready = false;
+
+        if (_contexts.empty() == true) {
+            result = EVP_MD_CTX_create();
+        } else {
+            auto it = std::find_if(_contexts.begin(), _contexts.end(),
+                [digest](const std::pair<const EVP_MD*, EVP_MD_CTX*>& entry) { return ((digest != nullptr) && (entry.first == digest)); });
+
+            if (it == _contexts.end()) {
+                it = (_contexts.end() - 1);
+            } else {
+                ready = true;
+            }
+
+            result = (*it).second;
+            (*it) = _contexts.back();
+            _contexts.pop_back();
+        }
+
+        return (result);
+    }
+
+    // With digest set (the one the context runs), the context is restarted, otherwise its state is dropped.
+    // Restarting with the digest it holds skips looking up the implementation, which takes longer than
+    // hashing a small message.
+    void Recycle(EVP_MD_CTX* context, const EVP_MD* digest)
+    {
+        ASSERT(context != nullptr);
+
+        if (_contexts.size() >= Capacity) {
+            EVP_MD_CTX_destroy(context);
+        } else if ((digest != nullptr) && (EVP_DigestInit_ex(context, nullptr, nullptr) != 0)) {
+            _contexts.emplace_back(digest, context);
+        } else {
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+            EVP_MD_CTX_reset(context);
+#else
+            EVP_MD_CTX_cleanup(context);
+#endif
+            _contexts.emplace_back(nullptr, context);
+        }
+    }
+
+    void* Allocate(const size_t size)
+    {
+        void* result = nullptr;
+
+        auto it = std::find_if(_blocks.begin(), _blocks.end(),
+            [size](const std::pair<size_t, void*>& entry) { return (entry.first == size); });
+
+        if (it == _blocks.end()) {
+            result = ::operator new(size);
+        } else {
+            result = (*it).second;
+            (*it) = _blocks.back();
+            _blocks.pop_back();
+        }
+
+        return (result);
+    }
+
+    void Free(void* block, const size_t size)
+    {
+        if (_blocks.size() >= Capacity) {
+            ::operator delete(block);
+        } else {
+            _blocks.emplace_back(size, block);
+        }
+    }
+
+private:
+    std::vector<std::pair<const EVP_MD*, EVP_MD_CTX*>> _contexts;
+    std::vector<std::pair<size_t, void*>> _blocks;
+    bool& _disposed;
+};
+
 template<typename OPERATION>
 class HashType : public HashImplementation {
 public:
-    HashType(const HashType<OPERATION>&) = delete;
     HashType<OPERATION>& operator=(const HashType) = delete;
 
-    HashType(const EVP_MD* digest)
+    HashType(const EVP_MD* digest, const std::shared_ptr<const Vault::PreparedKey>& key = nullptr)
         : _ctx(nullptr)
-        , _pkey(nullptr)
-        , _vault(nullptr)
+        , _key(key)
+        , _digest(digest)
         , _size(0)
         , _failure(false)
     {
         ASSERT(digest != nullptr);
 
-        _ctx = EVP_MD_CTX_create();
+        bool ready = false;
+
+        _ctx = Acquire((OPERATION::Reusable == true ? digest : nullptr), ready);
         ASSERT(_ctx != nullptr);
 
-        if (EVP_DigestInit_ex(_ctx, digest, NULL) == 0) {
-            TRACE_L1("EVP_DigestInit_ex() failed");
+        _size = EVP_MD_size(digest);
+        ASSERT(_size != 0);
+
+        if ((ready == false) && (OPERATION::Init(_ctx, _digest, _key.get()) == 0)) {
+            TRACE_L1("Init() failed");
             _failure = true;
-        } else {
-            _size = EVP_MD_size(digest);
-            ASSERT(_size != 0);
         }
     }
 
-    HashType(const Implementation::Vault* vault, const EVP_MD* digest, const uint32_t secretId, const uint16_t secretLength)
-        : HashType(digest)
+    ~HashType() override
     {
-        ASSERT(vault != nullptr);
-        ASSERT(secretId != 0);
-        ASSERT(secretLength != 0);
-        _vault = vault;
-
-        if (_failure == false) {
-            uint8_t* secret = reinterpret_cast<uint8_t*>(ALLOCA(secretLength));
-            ASSERT(secret != nullptr);
+        if (_ctx != nullptr) {
+            Pool* pool = Pool::Instance();
 
-            uint16_t secretLen = _vault->Export(secretId, secretLength, secret, true);
-            ASSERT(secretLen != 0);
+            if (pool != nullptr) {
+                pool->Recycle(_ctx, ((OPERATION::Reusable == true) && (_failure == false) ? _digest : nullptr));
+            } else {
+                EVP_MD_CTX_destroy(_ctx);
+            }
+        }
+    }
 
-            if (secretLen != 0) {
-                _pkey = EVP_PKEY_new_mac_key(EVP_PKEY_HMAC, nullptr, secret, secretLen);
-                ASSERT(_pkey != nullptr);
+    static void* operator new(const size_t size)
+    {
+        Pool* pool = Pool::Instance();
+        return (pool != nullptr ? pool->Allocate(size) : ::operator new(size));
+    }
 
-                ::memset(secret, 0xFF, secretLen);
+    static void operator delete(void* block, const size_t size)
+    {
+        Pool* pool = Pool::Instance();
 
-                if (OPERATION::Init(_ctx, nullptr, digest, _pkey) == 0) {
-                    TRACE_L1("Init() failed");
-                    _failure = true;
-                }
-            }
+        if (pool != nullptr) {
+            pool->Free(block, size);
+        } else {
+            ::operator delete(block);
         }
     }
 
-    ~HashType() override
+private:
+    // Used by Copy() only, duplicates the running calculation, the prepared key is shared.
+    HashType(const HashType<OPERATION>& other)
+        : _ctx(nullptr)
+        , _key(other._key)
+        , _digest(other._digest)
+        , _size(other._size)
+        , _failure(false)
     {
-        if (_ctx != nullptr) {
-            EVP_MD_CTX_destroy(_ctx);
+        bool ready = false;
+
+        // Whatever state the context is in, copying into it resets it first.
+        _ctx = Acquire(nullptr, ready);
+        ASSERT(_ctx != nullptr);
+
+        if (EVP_MD_CTX_copy_ex(_ctx, other._ctx) == 0) {
+            TRACE_L1("EVP_MD_CTX_copy_ex() failed");
+            _failure = true;
         }
     }
 
@@ -185,6 +341,9 @@ public:
 
         if (_failure == true) {
             TRACE_L1("Hash calculation failure");
+        } else if ((_key != nullptr) && (_key->IsRevoked() == true)) {
+            TRACE_L1("Key was deleted from the vault");
+            _failure = true;
         } else {
             if (maxLength < _size) {
                 TRACE_L1("Output buffer to small, need %i bytes, got %i bytes", _size, maxLength);
@@ -204,10 +363,63 @@ public:
         return (result);
     }
 
+    uint32_t Reset() override
+    {
+        uint32_t result = WPEFramework::Core::ERROR_NONE;
+
+        if ((std::is_same<OPERATION, Operation::HMAC>::value == true) && (_key == nullptr)) {
+            // The key never got prepared, nothing to restart from.
+            result = WPEFramework::Core::ERROR_UNAVAILABLE;
+        } else {
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+            EVP_MD_CTX_reset(_ctx);
+#else
+            EVP_MD_CTX_cleanup(_ctx);
+#endif
+            if (OPERATION::Init(_ctx, _digest, _key.get()) == 0) {
+                TRACE_L1("Init() failed");
+                _failure = true;
+                result = WPEFramework::Core::ERROR_GENERAL;
+            } else {
+                _failure = false;
+            }
+        }
+
+        return (result);
+    }
+
+    HashImplementation* Copy() const override
+    {
+        HashType<OPERATION>* copy = nullptr;
+
+        if (_failure == true) {
+            TRACE_L1("Can not copy a failed hash calculation");
+        } else {
+            copy = new HashType<OPERATION>(*this);
+
+            if (copy->_failure == true) {
+                delete copy;
+                copy = nullptr;
+            }
+        }
+
+        return (copy);
+    }
+
+private:
+    static EVP_MD_CTX* Acquire(const EVP_MD* digest, bool& ready)
+    {
+        Pool* pool = Pool::Instance();
+
+        ready = false;
+
+        return (pool != nullptr ? pool->Context(digest, ready) : EVP_MD_CTX_create());
+    }
+
 private:
     EVP_MD_CTX* _ctx;
-    EVP_PKEY* _pkey;
-    const Implementation::Vault* _vault;
+    std::shared_ptr<const Vault::PreparedKey> _key;
+    const EVP_MD* _digest;
     uint16_t _size;
     bool _failure;
 };
@@ -234,13 +446,13 @@ HashImplementation* hash_create_hmac(const VaultImplementation* vault, const has
     const Implementation::Vault *vaultImpl = reinterpret_cast<const Implementation::Vault*>(vault);
     HashImplementation* implementation = nullptr;
 
-    uint16_t secretLength = vaultImpl->Size(secret_id, true);
-    if (secretLength == 0) {
+    std::shared_ptr<const Implementation::Vault::PreparedKey> secret = vaultImpl->Prepare(secret_id);
+    if (secret == nullptr) {
         TRACE_L1("Failed to retrieve secret id 0x%08x", secret_id);
     } else {
         const EVP_MD* md = Implementation::Algorithm(type);
         if (md != nullptr) {
-            implementation = new Implementation::HashType<Implementation::Operation::HMAC>(vaultImpl, md, secret_id, secretLength);
+            implementation = new Implementation::HashType<Implementation::Operation::HMAC>(md, secret);
         }
     }
 
@@ -265,4 +477,147 @@ uint8_t hash_calculate(HashImplementation* hash, const uint8_t max_length, uint8
     return (hash->Calculate(max_length, data));
 }
 
+uint32_t hash_reset(HashImplementation* hash)
+{
+    ASSERT(hash != nullptr);
+    return (hash->Reset());
+}
+
+HashImplementation* hash_copy(const HashImplementation* hash)
+{
+    ASSERT(hash != nullptr);
+    return (hash->Copy());
+}
+
+uint8_t hash_digest(const hash_type type, const uint32_t length, const uint8_t data[], const uint8_t max_length, uint8_t output[])
+{
+    ASSERT((data != nullptr) || (length == 0));
+    ASSERT(output != nullptr);
+
+    uint8_t result = 0;
+
+    const EVP_MD* md = Implementation::Algorithm(type);
+    if (md != nullptr) {
+        if (max_length < EVP_MD_size(md)) {
+            TRACE_L1("Output buffer to small, need %i bytes, got %i bytes", EVP_MD_size(md), max_length);
+        } else {
+            // Not EVP_Digest(), that looks up the implementation on every call, a pooled context has it already.
+            Implementation::HashType<Implementation::Operation::Digest> digest(md);
+
+            if ((length == 0) || (digest.Ingest(length, data) == length)) {
+                result = digest.Calculate(max_length, output);
+            }
+
+            if (result == 0) {
+                TRACE_L1("Digest calculation failed");
+            }
+        }
+    }
+
+    return (result);
+}
+
+uint8_t hash_hmac(const VaultImplementation* vault, const hash_type type, const uint32_t secret_id,
+    const uint32_t length, const uint8_t data[], const uint8_t max_length, uint8_t output[])
+{
+    ASSERT(vault != nullptr);
+    ASSERT((data != nullptr) || (length == 0));
+    ASSERT(output != nullptr);
+
+    const Implementation::Vault *vaultImpl = reinterpret_cast<const Implementation::Vault*>(vault);
+    uint8_t result = 0;
+
+    const EVP_MD* md = Implementation::Algorithm(type);
+    if (md != nullptr) {
+        std::shared_ptr<const Implementation::Vault::PreparedKey> secret = vaultImpl->Prepare(secret_id);
+        if (secret == nullptr) {
+            TRACE_L1("Failed to retrieve secret id 0x%08x", secret_id);
+        } else if (max_length < EVP_MD_size(md)) {
+            TRACE_L1("Output buffer to small, need %i bytes, got %i bytes", EVP_MD_size(md), max_length);
+        } else {
+            Implementation::HashType<Implementation::Operation::HMAC> hmac(md, secret);
+
+            if ((length == 0) || (hmac.Ingest(length, data) == length)) {
+                result = hmac.Calculate(max_length, output);
+            }
+
+            if (result == 0) {
+                TRACE_L1("HMAC calculation failed");
+            }
+        }
+    }
+
+    return (result);
+}
+
+uint16_t hash_hmac_batch(const VaultImplementation* vault, const hash_type type, const uint32_t secret_id,
+    const uint16_t count, const uint32_t lengths[], const uint8_t data[], const uint32_t max_length, uint8_t output[])
+{
+    ASSERT(vault != nullptr);
+    ASSERT((lengths != nullptr) || (count == 0));
+    ASSERT(output != nullptr);
+
+    const Implementation::Vault *vaultImpl = reinterpret_cast<const Implementation::Vault*>(vault);
+    uint16_t result = 0;
+
+    const EVP_MD* md = Implementation::Algorithm(type);
+    if (md != nullptr) {
+        std::shared_ptr<const Implementation::Vault::PreparedKey> secret = vaultImpl->Prepare(secret_id);
+        if (secret == nullptr) {
+            TRACE_L1("Failed to retrieve secret id 0x%08x", secret_id);
+        } else {
+            const uint8_t size = static_cast<uint8_t>(EVP_MD_size(md));
+            Implementation::SHA256MultiBuffer::Key key;
+
+            if ((type == hash_type::HASH_TYPE_SHA256) && (Implementation::SHA256MultiBuffer::Lanes() > 1) && (secret->MultiBuffer(key) == true)) {
+                // Messages handed to the kernel per call, keeps the scratch on the stack bounded whatever the count
+                static constexpr uint16_t Chunk = 64;
+
+                const uint16_t fit = static_cast<uint16_t>(std::min(static_cast<uint32_t>(count), (max_length / size)));
+                const uint8_t* messages[Chunk];
+                uint32_t sizes[Chunk];
+                uint32_t offset = 0;
+
+                while (result < fit) {
+                    const uint16_t chunk = std::min(static_cast<uint16_t>(fit - result), Chunk);
+
+                    for (uint16_t index = 0; index < chunk; index++) {
+                        messages[index] = (data + offset);
+                        sizes[index] = lengths[result + index];
+                        offset += lengths[result + index];
+                    }
+
+                    Implementation::SHA256MultiBuffer::HMAC(key, chunk, messages, sizes, (output + (result * size)));
+
+                    result += chunk;
+                }
+
+                OPENSSL_cleanse(&key, sizeof(key));
+            } else {
+                // One context for the whole batch, restarted from the prepared key per message.
+                Implementation::HashType<Implementation::Operation::HMAC> hmac(md, secret);
+
+                uint32_t offset = 0;
+
+                while ((result < count) && ((max_length - (result * size)) >= size)) {
+                    if ((hmac.Ingest(lengths[result], (data + offset)) != lengths[result])
+                        || (hmac.Calculate(size, (output + (result * size))) != size)
+                        || (hmac.Reset() != WPEFramework::Core::ERROR_NONE)) {
+                        break;
+                    }
+
+                    offset += lengths[result];
+                    result++;
+                }
+            }
+
+            if (result != count) {
+                TRACE_L1("Calculated %i out of %i HMACs", result, count);
+            }
+        }
+    }
+
+    return (result);
+}
+
 } // extern "C"
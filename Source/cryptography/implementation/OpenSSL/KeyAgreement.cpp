@@ -0,0 +1,302 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../../Module.h"
+
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/ecdh.h>
+#include <openssl/evp.h>
+#include <openssl/obj_mac.h>
+
+#include <keyagreement_implementation.h>
+#include "Vault.h"
+
+namespace Implementation {
+
+namespace KeyAgreement {
+
+    static constexpr uint8_t KEY_SIZE = 32;
+    static constexpr uint8_t POINT_SIZE = (1 + (2 * KEY_SIZE));
+    static constexpr uint32_t PRIVATE_KEY_MAGIC = 0x3150414B; // "KAP1"
+
+    // Private keys are kept sealed in the vault, prefixed with a magic and the curve they belong to,
+    // so that no other sealed blob of the same size passes for one.
+#pragma pack(push, 1)
+    struct PrivateKey {
+        uint32_t magic;
+        uint8_t curve;
+        uint8_t key[KEY_SIZE];
+    };
+#pragma pack(pop)
+
+    bool Store(Vault& vault, const key_agreement_curve curve, const uint8_t privateKey[], const uint8_t publicKey[], const uint16_t publicKeySize,
+        uint32_t& privateKeyId, uint32_t& publicKeyId)
+    {
+        PrivateKey blob;
+        blob.magic = PRIVATE_KEY_MAGIC;
+        blob.curve = static_cast<uint8_t>(curve);
+        ::memcpy(blob.key, privateKey, sizeof(blob.key));
+
+        privateKeyId = vault.Import(sizeof(blob), reinterpret_cast<const uint8_t*>(&blob), false /* private key always sealed */);
+        publicKeyId = (privateKeyId != 0 ? vault.Import(publicKeySize, publicKey, true /* public key shall not be sealed */) : 0);
+
+        ::memset(&blob, 0xFF, sizeof(blob));
+
+        if ((privateKeyId != 0) && (publicKeyId == 0)) {
+            // Do not leave a private key behind that nobody has an id of
+            vault.Delete(privateKeyId);
+            privateKeyId = 0;
+        }
+
+        return ((privateKeyId != 0) && (publicKeyId != 0));
+    }
+
+    namespace X25519 {
+
+        bool Generate(uint8_t privateKey[], uint8_t publicKey[])
+        {
+            bool result = false;
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+            EVP_PKEY* pkey = nullptr;
+            EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_X25519, nullptr);
+
+            if ((ctx != nullptr) && (EVP_PKEY_keygen_init(ctx) == 1) && (EVP_PKEY_keygen(ctx, &pkey) == 1)) {
+                size_t privateSize = KEY_SIZE;
+                size_t publicSize = KEY_SIZE;
+
+                result = (EVP_PKEY_get_raw_private_key(pkey, privateKey, &privateSize) == 1)
+                    && (EVP_PKEY_get_raw_public_key(pkey, publicKey, &publicSize) == 1);
+            }
+
+            EVP_PKEY_free(pkey);
+            EVP_PKEY_CTX_free(ctx);
+#else
+            TRACE_L1("X25519 requires OpenSSL 1.1.1 or later");
+#endif
+
+            return (result);
+        }
+
+        bool Derive(const uint8_t privateKey[], const uint16_t peerSize, const uint8_t peer[], uint8_t secret[])
+        {
+            bool result = false;
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+            if (peerSize != KEY_SIZE) {
+                TRACE_L1("Invalid X25519 public key size %i", peerSize);
+            } else {
+                EVP_PKEY* own = EVP_PKEY_new_raw_private_key(EVP_PKEY_X25519, nullptr, privateKey, KEY_SIZE);
+                EVP_PKEY* other = EVP_PKEY_new_raw_public_key(EVP_PKEY_X25519, nullptr, peer, KEY_SIZE);
+                EVP_PKEY_CTX* ctx = (own != nullptr ? EVP_PKEY_CTX_new(own, nullptr) : nullptr);
+                size_t secretSize = KEY_SIZE;
+
+                // Derivation fails on an all-zero result, i.e. a low order peer point
+                result = (ctx != nullptr) && (other != nullptr)
+                    && (EVP_PKEY_derive_init(ctx) == 1)
+                    && (EVP_PKEY_derive_set_peer(ctx, other) == 1)
+                    && (EVP_PKEY_derive(ctx, secret, &secretSize) == 1)
+                    && (secretSize == KEY_SIZE);
+
+                EVP_PKEY_CTX_free(ctx);
+                EVP_PKEY_free(other);
+                EVP_PKEY_free(own);
+            }
+#else
+            TRACE_L1("X25519 requires OpenSSL 1.1.1 or later");
+#endif
+
+            return (result);
+        }
+
+    } // namespace X25519
+
+    namespace P256 {
+
+        bool Generate(uint8_t privateKey[], uint8_t publicKey[])
+        {
+            bool result = false;
+
+            EC_KEY* key = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+
+            if ((key != nullptr) && (EC_KEY_generate_key(key) == 1)) {
+                const BIGNUM* scalar = EC_KEY_get0_private_key(key);
+                const int size = BN_num_bytes(scalar);
+
+                // Left pad the scalar to the full key size
+                ::memset(privateKey, 0, KEY_SIZE - size);
+                BN_bn2bin(scalar, (privateKey + (KEY_SIZE - size)));
+
+                result = (EC_POINT_point2oct(EC_KEY_get0_group(key), EC_KEY_get0_public_key(key),
+                              POINT_CONVERSION_UNCOMPRESSED, publicKey, POINT_SIZE, nullptr)
+                    == POINT_SIZE);
+            }
+
+            EC_KEY_free(key);
+
+            return (result);
+        }
+
+        bool Derive(const uint8_t privateKey[], const uint16_t peerSize, const uint8_t peer[], uint8_t secret[])
+        {
+            bool result = false;
+
+            EC_KEY* key = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+            BIGNUM* scalar = BN_bin2bn(privateKey, KEY_SIZE, nullptr);
+            EC_POINT* point = (key != nullptr ? EC_POINT_new(EC_KEY_get0_group(key)) : nullptr);
+
+            if ((key == nullptr) || (scalar == nullptr) || (point == nullptr)) {
+                TRACE_L1("Failed to set up a P-256 key");
+            } else if ((EC_POINT_oct2point(EC_KEY_get0_group(key), point, peer, peerSize, nullptr) != 1)
+                || (EC_POINT_is_on_curve(EC_KEY_get0_group(key), point, nullptr) != 1)) {
+                TRACE_L1("Peer public key is invalid");
+            } else if (EC_KEY_set_private_key(key, scalar) == 1) {
+                result = (ECDH_compute_key(secret, KEY_SIZE, point, key, nullptr) == KEY_SIZE);
+            }
+
+            EC_POINT_free(point);
+            BN_clear_free(scalar);
+            EC_KEY_free(key);
+
+            return (result);
+        }
+
+    } // namespace P256
+
+    uint32_t Generate(Vault& vault, const key_agreement_curve curve, uint32_t& privateKeyId, uint32_t& publicKeyId)
+    {
+        uint32_t result = -1;
+
+        uint8_t privateKey[KEY_SIZE];
+        uint8_t publicKey[POINT_SIZE];
+        uint16_t publicKeySize = 0;
+        bool generated = false;
+
+        privateKeyId = 0;
+        publicKeyId = 0;
+
+        switch (curve) {
+        case KEY_AGREEMENT_CURVE_X25519:
+            generated = X25519::Generate(privateKey, publicKey);
+            publicKeySize = KEY_SIZE;
+            break;
+        case KEY_AGREEMENT_CURVE_P256:
+            generated = P256::Generate(privateKey, publicKey);
+            publicKeySize = POINT_SIZE;
+            break;
+        default:
+            TRACE_L1("Curve %i not supported", curve);
+            break;
+        }
+
+        if (generated == false) {
+            TRACE_L1("Failed to generate a key pair");
+        } else if (Store(vault, curve, privateKey, publicKey, publicKeySize, privateKeyId, publicKeyId) == false) {
+            TRACE_L1("Failed to store the key pair into the vault");
+        } else {
+            TRACE_L2("Generated key agreement key pair (private: 0x%08x, public: 0x%08x)", privateKeyId, publicKeyId);
+            result = 0;
+        }
+
+        ::memset(privateKey, 0xFF, sizeof(privateKey));
+
+        return (result);
+    }
+
+    uint32_t Derive(Vault& vault, const uint32_t privateKeyId, const uint32_t peerPublicKeyId, uint32_t& secretId)
+    {
+        uint32_t result = -1;
+
+        PrivateKey blob;
+        uint8_t peer[POINT_SIZE];
+        uint8_t secret[KEY_SIZE];
+
+        secretId = 0;
+
+        const uint16_t peerSize = vault.Export(peerPublicKeyId, sizeof(peer), peer);
+
+        if ((vault.Export(privateKeyId, sizeof(blob), reinterpret_cast<uint8_t*>(&blob), true) != sizeof(blob))
+            || (blob.magic != PRIVATE_KEY_MAGIC)) {
+            TRACE_L1("Key 0x%08x is not a key agreement private key", privateKeyId);
+        } else if (peerSize == 0) {
+            TRACE_L1("Failed to retrieve peer public key 0x%08x", peerPublicKeyId);
+        } else {
+            bool derived = false;
+
+            switch (blob.curve) {
+            case KEY_AGREEMENT_CURVE_X25519:
+                derived = X25519::Derive(blob.key, peerSize, peer, secret);
+                break;
+            case KEY_AGREEMENT_CURVE_P256:
+                derived = P256::Derive(blob.key, peerSize, peer, secret);
+                break;
+            default:
+                TRACE_L1("Key 0x%08x is not a key agreement private key", privateKeyId);
+                break;
+            }
+
+            if (derived == false) {
+                TRACE_L1("Failed to compute a shared secret");
+            } else {
+                secretId = vault.Import(sizeof(secret), secret, false);
+
+                if (secretId == 0) {
+                    TRACE_L1("Failed to store the shared secret");
+                } else {
+                    TRACE_L2("Computed shared secret as 0x%08x", secretId);
+                    result = 0;
+                }
+            }
+
+            ::memset(secret, 0xFF, sizeof(secret));
+        }
+
+        ::memset(&blob, 0xFF, sizeof(blob));
+
+        return (result);
+    }
+
+} // namespace KeyAgreement
+
+} // namespace Implementation
+
+
+extern "C" {
+
+uint32_t keyagreement_generate(struct VaultImplementation* vault, const key_agreement_curve curve,
+                               uint32_t* private_key_id, uint32_t* public_key_id)
+{
+    ASSERT(vault != nullptr);
+    ASSERT(private_key_id != nullptr);
+    ASSERT(public_key_id != nullptr);
+
+    return (Implementation::KeyAgreement::Generate(*reinterpret_cast<Implementation::Vault*>(vault), curve, (*private_key_id), (*public_key_id)));
+}
+
+uint32_t keyagreement_derive(struct VaultImplementation* vault,
+                             const uint32_t private_key_id, const uint32_t peer_public_key_id, uint32_t* secret_id)
+{
+    ASSERT(vault != nullptr);
+    ASSERT(secret_id != nullptr);
+
+    return (Implementation::KeyAgreement::Derive(*reinterpret_cast<Implementation::Vault*>(vault), private_key_id, peer_public_key_id, (*secret_id)));
+}
+
+} // extern "C"
@@ -0,0 +1,363 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../../Module.h"
+
+#include <openssl/rand.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "PersistentStore.h"
+#include "Vault.h"
+
+namespace Implementation {
+
+namespace {
+
+    static constexpr uint32_t RECORD_MAGIC = 0x3153594B; // "KYS1"
+    static constexpr uint32_t MAX_STORE_SIZE = (1024 * 1024);
+
+#pragma pack(push, 1)
+    struct Record {
+        uint32_t magic;
+        uint8_t locatorLength;
+        uint16_t sealedLength;
+        uint32_t check;
+    };
+#pragma pack(pop)
+
+    // Only meant to detect a torn write at the end of the file, the sealed key carries no integrity itself.
+    uint32_t Check(const string& locator, const uint16_t length, const uint8_t sealed[])
+    {
+        uint32_t hash = 2166136261u;
+
+        for (const char c : locator) {
+            hash = ((hash ^ static_cast<uint8_t>(c)) * 16777619u);
+        }
+        for (uint16_t index = 0; index < length; index++) {
+            hash = ((hash ^ sealed[index]) * 16777619u);
+        }
+
+        return (hash);
+    }
+
+    // Core::File can not flush to storage, so sync through a descriptor of its own (works on directories too)
+    bool Sync(const string& path)
+    {
+        bool result = false;
+        const int descriptor = ::open(path.c_str(), (O_RDONLY | O_CLOEXEC));
+
+        if (descriptor != -1) {
+            result = (::fsync(descriptor) == 0);
+            ::close(descriptor);
+        }
+
+        if (result == false) {
+            TRACE_L1("Failed to sync %s to storage", path.c_str());
+        }
+
+        return (result);
+    }
+
+    string Directory(const string& path)
+    {
+        const size_t slash = path.find_last_of('/');
+
+        return (slash == string::npos ? string(".") : (slash == 0 ? string("/") : path.substr(0, slash)));
+    }
+
+    uint16_t KeyLength(const key_type type)
+    {
+        uint16_t length = 0;
+
+        switch (type) {
+        case key_type::AES128:
+        case key_type::HMAC128:
+            length = 16;
+            break;
+        case key_type::HMAC160:
+            length = 20;
+            break;
+        case key_type::AES256:
+        case key_type::HMAC256:
+            length = 32;
+            break;
+        default:
+            TRACE_L1("Key type %i not supported", type);
+            break;
+        }
+
+        return (length);
+    }
+
+} // namespace
+
+PersistentStore::PersistentStore(Vault& vault, const string& path)
+    : _lock()
+    , _vault(vault)
+    , _path(path)
+    , _index()
+    , _dirty(false)
+    , _pending(false)
+{
+    Open();
+}
+
+void PersistentStore::Open()
+{
+    WPEFramework::Core::File file(_path);
+    bool torn = false;
+
+    if ((file.Exists() == true) && (file.Open(true) == true)) {
+        uint64_t fileSize = file.Size();
+
+        if (fileSize > MAX_STORE_SIZE) {
+            TRACE_L1("Key store %s is too large, ignoring it", _path.c_str());
+        } else {
+            std::vector<uint8_t> content(static_cast<size_t>(fileSize));
+            uint32_t size = file.Read(content.data(), static_cast<uint32_t>(fileSize));
+            uint32_t offset = 0;
+
+            while ((offset + sizeof(Record)) <= size) {
+                Record record;
+                ::memcpy(&record, &content[offset], sizeof(record));
+
+                const uint32_t end = (offset + sizeof(Record) + record.locatorLength + record.sealedLength);
+
+                if ((record.magic != RECORD_MAGIC) || (end > size)) {
+                    break;
+                }
+
+                string locator(reinterpret_cast<const char*>(&content[offset + sizeof(Record)]), record.locatorLength);
+                const uint8_t* sealed = &content[offset + sizeof(Record) + record.locatorLength];
+
+                if (Check(locator, record.sealedLength, sealed) != record.check) {
+                    break;
+                }
+
+                Entry& entry = _index[locator];
+
+                if (entry.sealed.empty() == false) {
+                    // Superseded by this record, compact it away on the next flush
+                    _dirty = true;
+                }
+
+                entry.sealed.assign(sealed, (sealed + record.sealedLength));
+                entry.id = 0;
+
+                offset = end;
+            }
+
+            TRACE_L2("Indexed %i persistent keys from %s", static_cast<uint32_t>(_index.size()), _path.c_str());
+
+            if (offset != size) {
+                TRACE_L1("Dropped %i bytes of a torn record at the end of key store %s", (size - offset), _path.c_str());
+                torn = true;
+            }
+        }
+
+        file.Close();
+
+        // New records can not be appended behind a torn one, rewrite the file right away
+        if (torn == true) {
+            Compact();
+        }
+    }
+}
+
+bool PersistentStore::Append(WPEFramework::Core::File& file, const string& locator, const std::vector<uint8_t>& sealed) const
+{
+    ASSERT(locator.length() <= UCHAR_MAX);
+    ASSERT(sealed.size() <= USHRT_MAX);
+
+    Record record;
+    record.magic = RECORD_MAGIC;
+    record.locatorLength = static_cast<uint8_t>(locator.length());
+    record.sealedLength = static_cast<uint16_t>(sealed.size());
+    record.check = Check(locator, record.sealedLength, sealed.data());
+
+    // One write per record, so a crash can only tear the last record
+    std::vector<uint8_t> buffer(sizeof(record) + record.locatorLength + record.sealedLength);
+    ::memcpy(buffer.data(), &record, sizeof(record));
+    ::memcpy(&buffer[sizeof(record)], locator.data(), record.locatorLength);
+    ::memcpy(&buffer[sizeof(record) + record.locatorLength], sealed.data(), record.sealedLength);
+
+    return (file.Write(buffer.data(), static_cast<uint32_t>(buffer.size())) == buffer.size());
+}
+
+bool PersistentStore::Exists(const string& locator) const
+{
+    _lock.Lock();
+    bool result = (_index.find(locator) != _index.end());
+    _lock.Unlock();
+
+    return (result);
+}
+
+uint32_t PersistentStore::Load(const string& locator)
+{
+    uint32_t id = 0;
+
+    _lock.Lock();
+
+    auto it = _index.find(locator);
+
+    if (it == _index.end()) {
+        TRACE_L1("No persistent key stored for %s", locator.c_str());
+    } else {
+        Entry& entry = (*it).second;
+
+        // Hand out the same vault item as long as nobody deleted it
+        if ((entry.id != 0) && (_vault.Size(entry.id, true) != 0)) {
+            id = entry.id;
+        } else {
+            id = _vault.Insert(false, static_cast<uint16_t>(entry.sealed.size()), entry.sealed.data());
+            entry.id = id;
+
+            TRACE_L2("Loaded persistent key %s as id 0x%08x", locator.c_str(), id);
+        }
+    }
+
+    _lock.Unlock();
+
+    return (id);
+}
+
+uint32_t PersistentStore::Create(const string& locator, const key_type type)
+{
+    uint32_t id = 0;
+    const uint16_t length = KeyLength(type);
+
+    if ((locator.empty() == true) || (locator.length() > UCHAR_MAX)) {
+        TRACE_L1("Invalid persistent key locator '%s'", locator.c_str());
+    } else if (length != 0) {
+        _lock.Lock();
+
+        if (_index.find(locator) != _index.end()) {
+            TRACE_L1("Persistent key %s already exists", locator.c_str());
+        } else {
+            uint8_t* key = reinterpret_cast<uint8_t*>(ALLOCA(length));
+            std::vector<uint8_t> sealed(length + 16 /* IV */);
+
+            if (RAND_bytes(key, length) != 1) {
+                TRACE_L1("Failed to generate a random key");
+            } else {
+                sealed.resize(_vault.Cipher(true, length, key, static_cast<uint16_t>(sealed.size()), sealed.data()));
+
+                WPEFramework::Core::File file(_path);
+
+                if ((sealed.empty() == false)
+                    && (((file.Exists() == true) ? file.Append() : file.Create()) == true)) {
+
+                    bool written = Append(file, locator, sealed);
+                    file.Close();
+
+                    if (written == false) {
+                        TRACE_L1("Failed to write persistent key %s to %s", locator.c_str(), _path.c_str());
+                    } else {
+                        id = _vault.Insert(false, static_cast<uint16_t>(sealed.size()), sealed.data());
+
+                        Entry& entry = _index[locator];
+                        entry.sealed = std::move(sealed);
+                        entry.id = id;
+
+                        // On storage with the next flush
+                        _pending = true;
+
+                        TRACE_L2("Created persistent key %s as id 0x%08x", locator.c_str(), id);
+                    }
+                } else {
+                    TRACE_L1("Failed to open key store %s", _path.c_str());
+                }
+            }
+
+            ::memset(key, 0xFF, length);
+        }
+
+        _lock.Unlock();
+    }
+
+    return (id);
+}
+
+uint32_t PersistentStore::Flush()
+{
+    uint32_t result = WPEFramework::Core::ERROR_NONE;
+
+    _lock.Lock();
+
+    if (_dirty == true) {
+        result = Compact();
+    } else if (_pending == true) {
+        // The directory as well, the file may have been created by the append
+        if ((Sync(_path) == true) && (Sync(Directory(_path)) == true)) {
+            _pending = false;
+        } else {
+            result = WPEFramework::Core::ERROR_GENERAL;
+        }
+    }
+
+    _lock.Unlock();
+
+    return (result);
+}
+
+uint32_t PersistentStore::Compact()
+{
+    uint32_t result = WPEFramework::Core::ERROR_NONE;
+
+    // Rewrite into a copy first and swap it in, so a crash leaves either the old or the new file. The copy
+    // is synced before the rename and the directory after it, else the rename may land on storage before
+    // the content does.
+    const string temporary(_path + ".tmp");
+    WPEFramework::Core::File file(temporary);
+
+    if (file.Create() == false) {
+        TRACE_L1("Failed to create %s", temporary.c_str());
+        result = WPEFramework::Core::ERROR_GENERAL;
+    } else {
+        bool written = true;
+
+        for (auto it = _index.cbegin(); (written == true) && (it != _index.cend()); ++it) {
+            written = Append(file, (*it).first, (*it).second.sealed);
+        }
+
+        file.Close();
+
+        if ((written == true) && (Sync(temporary) == true) && (file.Move(_path) == true)) {
+            if (Sync(Directory(_path)) == true) {
+                TRACE_L2("Compacted key store %s", _path.c_str());
+                _dirty = false;
+                _pending = false;
+            } else {
+                // The new file is in place, compact again on the next flush to retry the sync
+                result = WPEFramework::Core::ERROR_GENERAL;
+            }
+        } else {
+            TRACE_L1("Failed to compact key store %s", _path.c_str());
+            file.Destroy();
+            result = WPEFramework::Core::ERROR_GENERAL;
+        }
+    }
+
+    return (result);
+}
+
+} // namespace Implementation
@@ -0,0 +1,72 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "../../Module.h"
+
+#include <persistent_implementation.h>
+
+#include <map>
+#include <vector>
+
+namespace Implementation {
+
+class Vault;
+
+// Persistent keys of a vault, kept in an append-only file. Every record holds a locator and the key
+// sealed with the vault key, exactly as the vault keeps it in memory, so keys are never in the clear
+// on disk and loading one does not unseal it. The file is indexed in memory when the store opens;
+// creating a key appends a record and Flush() puts it on storage, compacting the file through a temporary
+// copy if records were superseded.
+class PersistentStore {
+public:
+    PersistentStore() = delete;
+    PersistentStore(const PersistentStore&) = delete;
+    PersistentStore& operator=(const PersistentStore&) = delete;
+
+    PersistentStore(Vault& vault, const string& path);
+    ~PersistentStore() = default;
+
+public:
+    bool Exists(const string& locator) const;
+    uint32_t Load(const string& locator);
+    uint32_t Create(const string& locator, const key_type type);
+    uint32_t Flush();
+
+private:
+    struct Entry {
+        std::vector<uint8_t> sealed;
+        uint32_t id;
+    };
+
+    void Open();
+    uint32_t Compact();
+    bool Append(WPEFramework::Core::File& file, const string& locator, const std::vector<uint8_t>& sealed) const;
+
+private:
+    mutable WPEFramework::Core::CriticalSection _lock;
+    Vault& _vault;
+    string _path;
+    std::map<string, Entry> _index;
+    bool _dirty;
+    bool _pending;
+};
+
+} // namespace Implementation
@@ -24,10 +24,12 @@
 
 #include <cryptalgo/cryptalgo.h>
 
+#include <openssl/crypto.h>
 #include <openssl/evp.h>
 #include <openssl/rand.h>
 
 #include "Derive.h"
+#include "PersistentStore.h"
 #include "Vault.h"
 
 namespace Implementation {
@@ -115,7 +117,7 @@ namespace Netflix {
         vault.Delete(Netflix::KPE_ID);
     };
 
-    static Vault instance(string(reinterpret_cast<const char*>(key), sizeof(key)), ctor, dtor);
+    static Vault instance(string(reinterpret_cast<const char*>(key), sizeof(key)), string(), ctor, dtor);
     return (instance);
 }
 
@@ -123,29 +125,401 @@ namespace Netflix {
 {
     static const uint8_t key[] = { 0x42, 0x71, 0x7b, 0x85, 0x98, 0x61, 0xe3, 0x19, 0x16, 0xd1, 0xc7, 0x28, 0x02, 0x9a, 0xc4, 0x07 };
 
-    static Vault instance(string(reinterpret_cast<const char*>(key), sizeof(key)));
+    auto store = []() {
+        string path;
+        WPEFramework::Core::SystemInfo::GetEnvironment(_T("CRYPTOGRAPHY_KEYSTORE"), path);
+        return (path);
+    };
+
+    static Vault instance(string(reinterpret_cast<const char*>(key), sizeof(key)), store());
     return (instance);
 }
 
-Vault::Vault(const string key, const Callback& ctor, const Callback& dtor)
-    : _lock()
-    , _items()
+Vault::Vault(const string key, const string store, const Callback& ctor, const Callback& dtor)
+    : _shards()
     , _lastHandle(0)
+    , _items(0)
+    , _bytes(0)
+    , _peak(0)
+    , _rejected(0)
+    , _quota(0)
     , _vaultKey(key)
     , _dtor(dtor)
+    , _keyed(EVP_CIPHER_CTX_new())
+    , _contextLock()
+    , _contexts()
+    , _store()
 {
+    ASSERT(_keyed != nullptr);
+
+    string quota;
+    if (WPEFramework::Core::SystemInfo::GetEnvironment(_T("CRYPTOGRAPHY_VAULT_QUOTA"), quota) == true) {
+        _quota = ::strtoull(quota.c_str(), nullptr, 0);
+    }
+
+    // AES-CTR ensures same buffer size after encryption
+    EVP_CipherInit_ex(_keyed, EVP_aes_128_ctr(), nullptr, reinterpret_cast<const unsigned char*>(_vaultKey.data()), nullptr, 1);
+
     if (ctor != nullptr) {
         ctor(*this);
     }
 
     _lastHandle = 0x80000000;
+
+    if (store.empty() == false) {
+        _store.reset(new PersistentStore(*this, store));
+    }
 }
 
 Vault::~Vault()
 {
+    _store.reset();
+
     if (_dtor != nullptr) {
         _dtor(*this);
     }
+
+    for (EVP_CIPHER_CTX* context : _contexts) {
+        EVP_CIPHER_CTX_free(context);
+    }
+
+    EVP_CIPHER_CTX_free(_keyed);
+}
+
+Vault::Slab::~Slab()
+{
+    for (auto& page : _pages) {
+        delete[] page.first;
+    }
+}
+
+/* static */ uint16_t Vault::Slab::Capacity(const uint16_t size)
+{
+    uint16_t capacity = SMALLEST;
+
+    while ((capacity < size) && (capacity < (SMALLEST << (CLASSES - 1)))) {
+        capacity <<= 1;
+    }
+
+    return (capacity < size ? size : capacity);
+}
+
+/* static */ uint8_t Vault::Slab::Class(const uint16_t capacity)
+{
+    uint8_t index = 0;
+
+    while ((SMALLEST << index) < capacity) {
+        index++;
+    }
+
+    ASSERT((SMALLEST << index) == capacity);
+
+    return (index);
+}
+
+std::map<uint8_t*, Vault::Slab::Page>::iterator Vault::Slab::Owner(uint8_t* slot)
+{
+    auto it = _pages.upper_bound(slot);
+
+    ASSERT(it != _pages.begin());
+    --it;
+    ASSERT((slot >= (*it).first) && (slot < ((*it).first + PAGE)));
+
+    return (it);
+}
+
+uint8_t* Vault::Slab::Allocate(const uint16_t capacity)
+{
+    uint8_t* slot = nullptr;
+
+    if (capacity > (SMALLEST << (CLASSES - 1))) {
+        slot = new uint8_t[capacity];
+    } else {
+        const uint8_t index = Class(capacity);
+
+        if (_free[index] == nullptr) {
+            uint8_t* page = new uint8_t[PAGE];
+            _pages.emplace(page, Page{ index, 0 });
+            _count[index]++;
+
+            // Link the new slots back to front, so they are handed out in address order
+            for (uint16_t count = (PAGE / capacity); count > 0; count--) {
+                uint8_t* entry = (page + ((count - 1) * capacity));
+                ::memcpy(entry, &_free[index], sizeof(uint8_t*));
+                _free[index] = entry;
+            }
+        }
+
+        slot = _free[index];
+        ::memcpy(&_free[index], slot, sizeof(uint8_t*));
+
+        (*Owner(slot)).second.used++;
+    }
+
+    return (slot);
+}
+
+void Vault::Slab::Free(uint8_t* slot, const uint16_t capacity)
+{
+    ASSERT(slot != nullptr);
+
+    OPENSSL_cleanse(slot, capacity);
+
+    if (capacity > (SMALLEST << (CLASSES - 1))) {
+        delete[] slot;
+    } else {
+        const uint8_t index = Class(capacity);
+        auto owner = Owner(slot);
+
+        ASSERT((*owner).second.used > 0);
+
+        ::memcpy(slot, &_free[index], sizeof(uint8_t*));
+        _free[index] = slot;
+
+        if ((--(*owner).second.used == 0) && (_count[index] > 1)) {
+            uint8_t* page = (*owner).first;
+            uint8_t* previous = nullptr;
+            uint8_t* entry = _free[index];
+
+            // Unlink all slots of the page from the free list before giving it back
+            while (entry != nullptr) {
+                uint8_t* next;
+                ::memcpy(&next, entry, sizeof(uint8_t*));
+
+                if ((entry < page) || (entry >= (page + PAGE))) {
+                    previous = entry;
+                } else if (previous == nullptr) {
+                    _free[index] = next;
+                } else {
+                    ::memcpy(previous, &next, sizeof(uint8_t*));
+                }
+
+                entry = next;
+            }
+
+            _pages.erase(owner);
+            _count[index]--;
+            delete[] page;
+        }
+    }
+}
+
+bool Vault::Reserve(const uint32_t bytes)
+{
+    bool result = true;
+
+    uint64_t total = (_bytes.fetch_add(bytes) + bytes);
+
+    if ((_quota != 0) && (total > _quota)) {
+        _bytes.fetch_sub(bytes);
+        _rejected++;
+        result = false;
+    } else {
+        _items++;
+
+        uint64_t peak = _peak.load();
+        while ((total > peak) && (_peak.compare_exchange_weak(peak, total) == false)) {
+        }
+    }
+
+    return (result);
+}
+
+void Vault::Unreserve(const uint32_t bytes)
+{
+    _bytes.fetch_sub(bytes);
+    _items--;
+}
+
+void Vault::Usage(Statistics& statistics) const
+{
+    statistics.items = _items.load();
+    statistics.bytes = _bytes.load();
+    statistics.peak = _peak.load();
+    statistics.quota = _quota;
+    statistics.rejected = _rejected.load();
+}
+
+EVP_CIPHER_CTX* Vault::AcquireContext() const
+{
+    EVP_CIPHER_CTX* context = nullptr;
+
+    _contextLock.Lock();
+    if (_contexts.empty() == false) {
+        context = _contexts.back();
+        _contexts.pop_back();
+    }
+    _contextLock.Unlock();
+
+    if (context == nullptr) {
+        context = EVP_CIPHER_CTX_new();
+        ASSERT(context != nullptr);
+
+        if ((context != nullptr) && (EVP_CIPHER_CTX_copy(context, _keyed) == 0)) {
+            TRACE_L1("Failed to create a vault sealing context");
+            EVP_CIPHER_CTX_free(context);
+            context = nullptr;
+        }
+    }
+
+    return (context);
+}
+
+void Vault::ReleaseContext(EVP_CIPHER_CTX* context) const
+{
+    ASSERT(context != nullptr);
+
+    _contextLock.Lock();
+    _contexts.push_back(context);
+    _contextLock.Unlock();
+}
+
+Vault::PreparedKey::PreparedKey(const uint16_t length, const uint8_t key[])
+    : _length(length)
+    , _key(new uint8_t[length])
+    , _revoked(false)
+    , _lock()
+    , _ciphers()
+    , _hmacs()
+    , _multiBuffer()
+{
+    ASSERT(length != 0);
+    ASSERT(key != nullptr);
+
+    ::memcpy(_key, key, length);
+}
+
+Vault::PreparedKey::~PreparedKey()
+{
+    for (auto& entry : _ciphers) {
+        EVP_CIPHER_CTX_free(entry.second);
+    }
+
+    for (auto& entry : _hmacs) {
+        EVP_MD_CTX_destroy(entry.second);
+    }
+
+    if (_multiBuffer != nullptr) {
+        OPENSSL_cleanse(_multiBuffer.get(), sizeof(SHA256MultiBuffer::Key));
+    }
+
+    OPENSSL_cleanse(_key, _length);
+    delete[] _key;
+}
+
+bool Vault::PreparedKey::Cipher(const EVP_CIPHER* cipher, const bool encrypt, EVP_CIPHER_CTX* context) const
+{
+    ASSERT(cipher != nullptr);
+    ASSERT(context != nullptr);
+
+    const EVP_CIPHER_CTX* keyed = nullptr;
+
+    _lock.Lock();
+
+    auto it = _ciphers.find(std::make_pair(cipher, encrypt));
+
+    if (_revoked.load() == true) {
+        TRACE_L1("Key was deleted from the vault");
+    } else if (it != _ciphers.end()) {
+        keyed = (*it).second;
+    } else if (EVP_CIPHER_key_length(cipher) != _length) {
+        TRACE_L1("Key size %i does not fit the cipher", _length);
+    } else {
+        EVP_CIPHER_CTX* created = EVP_CIPHER_CTX_new();
+        ASSERT(created != nullptr);
+
+        if ((created != nullptr) && (EVP_CipherInit_ex(created, cipher, nullptr, _key, nullptr, encrypt) != 0)) {
+            _ciphers.emplace(std::make_pair(cipher, encrypt), created);
+            keyed = created;
+        } else {
+            TRACE_L1("Failed to prepare a keyed cipher context");
+            EVP_CIPHER_CTX_free(created);
+        }
+    }
+
+    _lock.Unlock();
+
+    // Keyed contexts live as long as the prepared key, so copying them needs no lock.
+    return ((keyed != nullptr) && (EVP_CIPHER_CTX_copy(context, keyed) != 0));
+}
+
+bool Vault::PreparedKey::HMAC(const EVP_MD* digest, EVP_MD_CTX* context) const
+{
+    ASSERT(digest != nullptr);
+    ASSERT(context != nullptr);
+
+    const EVP_MD_CTX* keyed = nullptr;
+
+    _lock.Lock();
+
+    auto it = _hmacs.find(digest);
+
+    if (_revoked.load() == true) {
+        TRACE_L1("Key was deleted from the vault");
+    } else if (it != _hmacs.end()) {
+        keyed = (*it).second;
+    } else {
+        EVP_PKEY* pkey = EVP_PKEY_new_mac_key(EVP_PKEY_HMAC, nullptr, _key, _length);
+        EVP_MD_CTX* created = EVP_MD_CTX_create();
+        ASSERT(created != nullptr);
+
+        // The signing context takes its own reference on the key
+        if ((pkey != nullptr) && (created != nullptr) && (EVP_DigestSignInit(created, nullptr, digest, nullptr, pkey) != 0)) {
+            _hmacs.emplace(digest, created);
+            keyed = created;
+        } else {
+            TRACE_L1("Failed to prepare a keyed HMAC context");
+            if (created != nullptr) {
+                EVP_MD_CTX_destroy(created);
+            }
+        }
+
+        if (pkey != nullptr) {
+            EVP_PKEY_free(pkey);
+        }
+    }
+
+    _lock.Unlock();
+
+    return ((keyed != nullptr) && (EVP_MD_CTX_copy_ex(context, keyed) != 0));
+}
+
+bool Vault::PreparedKey::MultiBuffer(SHA256MultiBuffer::Key& key) const
+{
+    bool result = false;
+
+    _lock.Lock();
+
+    if (_revoked.load() == true) {
+        TRACE_L1("Key was deleted from the vault");
+    } else {
+        if (_multiBuffer == nullptr) {
+            _multiBuffer.reset(new SHA256MultiBuffer::Key);
+            SHA256MultiBuffer::Prepare(_length, _key, *_multiBuffer);
+        }
+
+        key = *_multiBuffer;
+        result = true;
+    }
+
+    _lock.Unlock();
+
+    return (result);
+}
+
+void Vault::PreparedKey::Revoke() const
+{
+    _lock.Lock();
+
+    // The keyed contexts may still be copied by a running operation, they go with the prepared key.
+    _revoked.store(true);
+    OPENSSL_cleanse(_key, _length);
+
+    if (_multiBuffer != nullptr) {
+        OPENSSL_cleanse(_multiBuffer.get(), sizeof(SHA256MultiBuffer::Key));
+    }
+
+    _lock.Unlock();
 }
 
 uint16_t Vault::Cipher(bool encrypt, const uint16_t inSize, const uint8_t input[], const uint16_t maxOutSize, uint8_t output[]) const
@@ -176,36 +550,80 @@ uint16_t Vault::Cipher(bool encrypt, const uint16_t inSize, const uint8_t input[
             outputBuffer = output;
         }
 
-        int outLen = 0;
+        EVP_CIPHER_CTX* ctx = AcquireContext();
 
-        EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-        ASSERT(ctx != nullptr);
+        if (ctx != nullptr) {
+            int outLen = 0;
+            int finalLen = 0;
 
-        // AES-CTR ensures same buffer size after encryption
-        EVP_CipherInit_ex(ctx, EVP_aes_128_ctr(), nullptr, reinterpret_cast<const unsigned char*>(_vaultKey.data()), iv, encrypt);
-        EVP_CipherUpdate(ctx, outputBuffer, &outLen, inputBuffer, inputSize);
-        totalLen += outLen;
-        outLen = 0;
-        EVP_EncryptFinal_ex(ctx, (outputBuffer + totalLen), &outLen);
-        totalLen += outLen;
+            // The context is already keyed, only the IV changes per operation
+            EVP_CipherInit_ex(ctx, nullptr, nullptr, nullptr, iv, encrypt);
+            EVP_CipherUpdate(ctx, outputBuffer, &outLen, inputBuffer, inputSize);
+            EVP_CipherFinal_ex(ctx, (outputBuffer + outLen), &finalLen);
+            totalLen += (outLen + finalLen);
 
-#if OPENSSL_VERSION_NUMBER >= 0x10100000L
-        EVP_CIPHER_CTX_reset(ctx);
-#else
-        EVP_CIPHER_CTX_cleanup(ctx);
-#endif
+            ReleaseContext(ctx);
+        } else {
+            totalLen = 0;
+        }
     }
 
     return (totalLen);
 }
 
+uint32_t Vault::Insert(bool exportable, const uint16_t size, const uint8_t blob[])
+{
+    uint32_t id = 0;
+    const uint16_t capacity = Slab::Capacity(size);
+
+    if (Reserve(capacity + ITEM_OVERHEAD) == false) {
+        TRACE_L1("Vault quota of %llu bytes exceeded, blob of size %i refused", static_cast<unsigned long long>(_quota), size);
+    } else {
+        uint32_t last = _lastHandle.load();
+
+        // Never wrap, the low handles belong to the pre-shared keys; once exhausted no more ids are handed out
+        do {
+            id = (last + 1);
+        } while ((id != 0) && (_lastHandle.compare_exchange_weak(last, id) == false));
+
+        if (id == 0) {
+            TRACE_L1("Vault handles exhausted, blob of size %i refused", size);
+            Unreserve(capacity + ITEM_OVERHEAD);
+        } else {
+            Shard& shard = Lookup(id);
+
+            shard.lock.Lock();
+
+            uint8_t* buffer = shard.slab.Allocate(capacity);
+            ::memcpy(buffer, blob, size);
+
+            bool inserted = shard.items.emplace(std::piecewise_construct,
+                std::forward_as_tuple(id),
+                std::forward_as_tuple(exportable, buffer, size, capacity)).second;
+
+            if (inserted == false) {
+                // The element does not own its slot, so hand it and the quota back here
+                TRACE_L1("Blob id 0x%08x is already taken", id);
+                shard.slab.Free(buffer, capacity);
+                Unreserve(capacity + ITEM_OVERHEAD);
+                id = 0;
+            }
+
+            shard.lock.Unlock();
+        }
+    }
+
+    return (id);
+}
+
 uint16_t Vault::Size(const uint32_t id, bool allowSealed) const
 {
     uint16_t size = 0;
+    const Shard& shard = Lookup(id);
 
-    _lock.Lock();
-    auto it = _items.find(id);
-    if (it != _items.end()) {
+    shard.lock.LockShared();
+    auto it = shard.items.find(id);
+    if (it != shard.items.end()) {
         if ((allowSealed == true) || (*it).second.IsExportable() == true) {
             size = ((*it).second.Size() - IV_SIZE);
             TRACE_L2("%sBlob id 0x%08x size: %i",
@@ -217,7 +635,7 @@ uint16_t Vault::Size(const uint32_t id, bool allowSealed) const
     } else {
         TRACE_L1("Failed to look up blob id 0x%08x", id);
     }
-    _lock.Unlock();
+    shard.lock.UnlockShared();
 
     return (size);
 }
@@ -227,22 +645,15 @@ uint32_t Vault::Import(const uint16_t size, const uint8_t blob[], bool exportabl
     uint32_t id = 0;
 
     if (size > 0) {
-        _lock.Lock();
-        id = (_lastHandle + 1);
+        // Seal the blob before taking any lock, the shard is only held for the insertion itself
+        uint8_t* buf = reinterpret_cast<uint8_t*>(ALLOCA(USHRT_MAX));
+        uint16_t len = Cipher(true, size, blob, USHRT_MAX, buf);
 
-        if (id != 0) {
-            uint8_t* buf = reinterpret_cast<uint8_t*>(ALLOCA(USHRT_MAX));
-            uint16_t len = Cipher(true, size, blob, USHRT_MAX, buf);
-
-            _items.emplace(std::piecewise_construct,
-                std::forward_as_tuple(id),
-                std::forward_as_tuple(exportable, len, buf));
-
-            _lastHandle = id;
+        id = Insert(exportable, len, buf);
 
+        if (id != 0) {
             TRACE_L2("Added a %s data blob of size %i as id 0x%08x", (exportable ? "clear" : "sealed"), (len - IV_SIZE), id);
         }
-        _lock.Unlock();
     }
 
     return (id);
@@ -253,9 +664,11 @@ uint16_t Vault::Export(const uint32_t id, const uint16_t size, uint8_t blob[], b
     uint16_t outSize = 0;
 
     if (size > 0) {
-        _lock.Lock();
-        auto it = _items.find(id);
-        if (it != _items.end()) {
+        const Shard& shard = Lookup(id);
+
+        shard.lock.LockShared();
+        auto it = shard.items.find(id);
+        if (it != shard.items.end()) {
             if ((allowSealed == true) || ((*it).second.IsExportable() == true)) {
                 outSize = Cipher(false, (*it).second.Size(), (*it).second.Buffer(), size, blob);
 
@@ -267,7 +680,7 @@ uint16_t Vault::Export(const uint32_t id, const uint16_t size, uint8_t blob[], b
         } else {
             TRACE_L1("Failed to look up blob id 0x%08x", id);
         }
-        _lock.Unlock();
+        shard.lock.UnlockShared();
     }
 
     return (outSize);
@@ -278,18 +691,11 @@ uint32_t Vault::Put(const uint16_t size, const uint8_t blob[])
     uint32_t id = 0;
 
     if (size > 0) {
-        _lock.Lock();
-        id = (_lastHandle + 1);
-        if (id != 0) {
-            _items.emplace(std::piecewise_construct,
-                std::forward_as_tuple(id),
-                std::forward_as_tuple(false, size, blob));
-
-            _lastHandle = id;
+        id = Insert(false, size, blob);
 
+        if (id != 0) {
             TRACE_L2("Inserted a sealed data blob of size %i as id 0x%08x", size, id);
         }
-        _lock.Unlock();
     }
 
     return (id);
@@ -300,14 +706,16 @@ uint16_t Vault::Get(const uint32_t id, const uint16_t size, uint8_t blob[]) cons
     uint16_t result = 0;
 
     if (size > 0) {
-        _lock.Lock();
-        auto it = _items.find(id);
-        if (it != _items.end()) {
+        const Shard& shard = Lookup(id);
+
+        shard.lock.LockShared();
+        auto it = shard.items.find(id);
+        if (it != shard.items.end()) {
             result = std::min(size, static_cast<uint16_t>((*it).second.Size()));
             ::memcpy(blob, (*it).second.Buffer(), result);
             TRACE_L2("Retrieved a sealed data blob id 0x%08x of size %i bytes", id, result);
         }
-        _lock.Unlock();
+        shard.lock.UnlockShared();
     }
 
     return (result);
@@ -316,18 +724,69 @@ uint16_t Vault::Get(const uint32_t id, const uint16_t size, uint8_t blob[]) cons
 bool Vault::Delete(const uint32_t id)
 {
     bool result = false;
+    Shard& shard = Lookup(id);
 
-    _lock.Lock();
-    auto it = _items.find(id);
-    if (it != _items.end()) {
-        _items.erase(it);
+    shard.lock.Lock();
+    auto it = shard.items.find(id);
+    if (it != shard.items.end()) {
+        const uint16_t capacity = (*it).second.Capacity();
+
+        if ((*it).second.Prepared() != nullptr) {
+            (*it).second.Prepared()->Revoke();
+        }
+
+        shard.slab.Free((*it).second.Buffer(), capacity);
+        shard.items.erase(it);
+
+        Unreserve(capacity + ITEM_OVERHEAD);
         result = true;
     }
-    _lock.Unlock();
+    shard.lock.Unlock();
 
     return (result);
 }
 
+std::shared_ptr<const Vault::PreparedKey> Vault::Prepare(const uint32_t id) const
+{
+    std::shared_ptr<const PreparedKey> key;
+    const Shard& shard = Lookup(id);
+
+    shard.lock.LockShared();
+    auto it = shard.items.find(id);
+    if (it != shard.items.end()) {
+        std::shared_ptr<const PreparedKey>& slot = (*it).second.Prepared();
+
+        key = std::atomic_load(&slot);
+
+        if ((key == nullptr) && ((*it).second.Size() <= IV_SIZE)) {
+            TRACE_L1("Blob id 0x%08x holds no key", id);
+        } else if (key == nullptr) {
+            const uint16_t size = ((*it).second.Size() - IV_SIZE);
+            uint8_t* clear = reinterpret_cast<uint8_t*>(ALLOCA(size));
+            ASSERT(clear != nullptr);
+
+            if (Cipher(false, (*it).second.Size(), (*it).second.Buffer(), size, clear) == size) {
+                std::shared_ptr<const PreparedKey> created = std::make_shared<const PreparedKey>(size, clear);
+
+                // Another reader may have prepared the key in the meantime, if so that one is used
+                if (std::atomic_compare_exchange_strong(&slot, &key, created) == true) {
+                    key = created;
+                }
+
+                TRACE_L2("Prepared blob id 0x%08x for internal use", id);
+            } else {
+                TRACE_L1("Failed to unseal blob id 0x%08x", id);
+            }
+
+            ::memset(clear, 0xFF, size);
+        }
+    } else {
+        TRACE_L1("Failed to look up blob id 0x%08x", id);
+    }
+    shard.lock.UnlockShared();
+
+    return (key);
+}
 
 } // namespace Implementation
 
@@ -396,6 +855,23 @@ bool vault_delete(VaultImplementation* vault, const uint32_t id)
     return (vaultImpl->Delete(id));
 }
 
+bool vault_statistics(const VaultImplementation* vault, vault_stats* stats)
+{
+    ASSERT(vault != nullptr);
+    ASSERT(stats != nullptr);
+
+    Implementation::Vault::Statistics statistics;
+    reinterpret_cast<const Implementation::Vault*>(vault)->Usage(statistics);
+
+    stats->items = statistics.items;
+    stats->bytes = statistics.bytes;
+    stats->peak_bytes = statistics.peak;
+    stats->quota = statistics.quota;
+    stats->rejected = statistics.rejected;
+
+    return (true);
+}
+
 
 // Netflix Security
 
@@ -423,24 +899,71 @@ uint32_t netflix_security_wrapping_key(void)
     return (Implementation::Vault::NetflixInstance().Size(Implementation::Netflix::KPW_ID) != 0 ? Implementation::Netflix::KPW_ID : 0);
 }
 
-uint32_t persistent_key_exists( struct VaultImplementation* vault ,const char locator[],bool* result)
+// Persistent
+
+uint32_t persistent_key_exists(struct VaultImplementation* vault, const char locator[], bool* result)
 {
-    return(WPEFramework::Core::ERROR_UNAVAILABLE);
+    ASSERT(vault != nullptr);
+    ASSERT(locator != nullptr);
+    ASSERT(result != nullptr);
+
+    uint32_t error = WPEFramework::Core::ERROR_UNAVAILABLE;
+    Implementation::PersistentStore* store = reinterpret_cast<Implementation::Vault*>(vault)->Store();
+
+    if (store != nullptr) {
+        (*result) = store->Exists(locator);
+        error = WPEFramework::Core::ERROR_NONE;
+    }
+
+    return (error);
 }
 
-uint32_t persistent_key_load(struct VaultImplementation* vault,const char locator[],uint32_t*  id)
+uint32_t persistent_key_load(struct VaultImplementation* vault, const char locator[], uint32_t* id)
 {
-    return(WPEFramework::Core::ERROR_UNAVAILABLE);
+    ASSERT(vault != nullptr);
+    ASSERT(locator != nullptr);
+    ASSERT(id != nullptr);
+
+    uint32_t error = WPEFramework::Core::ERROR_UNAVAILABLE;
+    Implementation::PersistentStore* store = reinterpret_cast<Implementation::Vault*>(vault)->Store();
+
+    if (store != nullptr) {
+        (*id) = store->Load(locator);
+        error = ((*id) != 0 ? WPEFramework::Core::ERROR_NONE : WPEFramework::Core::ERROR_GENERAL);
+    }
+
+    return (error);
 }
 
-uint32_t persistent_key_create( struct VaultImplementation* vault,const char locator[],const key_type keyType,uint32_t* id)
+uint32_t persistent_key_create(struct VaultImplementation* vault, const char locator[], const key_type keyType, uint32_t* id)
 {
-    return(WPEFramework::Core::ERROR_UNAVAILABLE);
+    ASSERT(vault != nullptr);
+    ASSERT(locator != nullptr);
+    ASSERT(id != nullptr);
+
+    uint32_t error = WPEFramework::Core::ERROR_UNAVAILABLE;
+    Implementation::PersistentStore* store = reinterpret_cast<Implementation::Vault*>(vault)->Store();
+
+    if (store != nullptr) {
+        (*id) = store->Create(locator, keyType);
+        error = ((*id) != 0 ? WPEFramework::Core::ERROR_NONE : WPEFramework::Core::ERROR_GENERAL);
+    }
+
+    return (error);
 }
 
 uint32_t persistent_flush(struct VaultImplementation* vault)
 {
-    return(WPEFramework::Core::ERROR_UNAVAILABLE);
+    ASSERT(vault != nullptr);
+
+    uint32_t error = WPEFramework::Core::ERROR_UNAVAILABLE;
+    Implementation::PersistentStore* store = reinterpret_cast<Implementation::Vault*>(vault)->Store();
+
+    if (store != nullptr) {
+        error = store->Flush();
+    }
+
+    return (error);
 }
 
 } // extern "C"
@@ -17,14 +17,29 @@
  * limitations under the License.
  */
 
+#pragma once
+
 #include "../../Module.h"
+#include <array>
+#include <atomic>
 #include <map>
+#include <memory>
+#include <vector>
 #include <climits>
+#include <pthread.h>
+
+#include <openssl/evp.h>
+
+#include "../SHA256MultiBuffer.h"
 
 
 namespace Implementation {
 
+class PersistentStore;
+
 class Vault {
+    friend class PersistentStore;
+
 public:
     static Vault& NetflixInstance();
     static Vault& PlatformInstance();
@@ -32,7 +47,7 @@ public:
 private:
     using Callback = std::function<void(Vault&)>;
 
-    Vault(const string key, const Callback& ctor = nullptr, const Callback& dtor = nullptr);
+    Vault(const string key, const string store, const Callback& ctor = nullptr, const Callback& dtor = nullptr);
     ~Vault();
 
 public:
@@ -40,19 +55,61 @@ public:
     void operator=(Vault const&) = delete;
 
 public:
-    class Element : public WPEFramework::Core::DataStore {
+    // Key material prepared for use by the cipher and HMAC operations. It is bound to a single vault
+    // item and hands out contexts that are already keyed, so the operations never see the clear key.
+    class PreparedKey {
     public:
-        Element(bool exportable, const uint16_t size)
-            : WPEFramework::Core::DataStore(size)
-            , _exportable(exportable)
+        PreparedKey() = delete;
+        PreparedKey(const PreparedKey&) = delete;
+        PreparedKey& operator=(const PreparedKey&) = delete;
+
+        PreparedKey(const uint16_t length, const uint8_t key[]);
+        ~PreparedKey();
+
+    public:
+        uint16_t Length() const
+        {
+            return (_length);
+        }
+
+        // Copy a context keyed for the given cipher and direction into context, the IV is still to be set.
+        bool Cipher(const EVP_CIPHER* cipher, const bool encrypt, EVP_CIPHER_CTX* context) const;
+
+        // Copy a context with the HMAC key schedule for the given digest already set into context.
+        bool HMAC(const EVP_MD* digest, EVP_MD_CTX* context) const;
+
+        // Copy the HMAC-SHA256 key with its pad blocks compressed, as the multi-buffer kernel takes it, into key.
+        bool MultiBuffer(SHA256MultiBuffer::Key& key) const;
+
+        // Called when the vault item is deleted, the key is wiped and the contexts are no longer handed out,
+        // so ciphers and HMACs still holding the prepared key fail from then on.
+        void Revoke() const;
+        bool IsRevoked() const
         {
+            return (_revoked.load());
         }
 
-        Element(bool exportable, const uint16_t size, const uint8_t* buffer)
-            : WPEFramework::Core::DataStore(size)
+    private:
+        uint16_t _length;
+        uint8_t* _key;
+        mutable std::atomic<bool> _revoked;
+        mutable WPEFramework::Core::CriticalSection _lock;
+        mutable std::map<std::pair<const EVP_CIPHER*, bool>, EVP_CIPHER_CTX*> _ciphers;
+        mutable std::map<const EVP_MD*, EVP_MD_CTX*> _hmacs;
+        mutable std::unique_ptr<SHA256MultiBuffer::Key> _multiBuffer;
+    };
+
+    // A sealed blob (IV included) in a slot of the shard it lives in; the slot is owned by the shard.
+    class Element {
+    public:
+        Element(bool exportable, uint8_t* buffer, const uint16_t size, const uint16_t capacity)
+            : _buffer(buffer)
+            , _size(size)
+            , _capacity(capacity)
             , _exportable(exportable)
+            , _prepared()
         {
-            Copy(buffer, size);
+            ASSERT(buffer != nullptr);
         }
 
         bool IsExportable() const
@@ -60,8 +117,44 @@ public:
             return _exportable;
         }
 
+        const uint8_t* Buffer() const
+        {
+            return (_buffer);
+        }
+        uint8_t* Buffer()
+        {
+            return (_buffer);
+        }
+
+        uint16_t Size() const
+        {
+            return (_size);
+        }
+
+        uint16_t Capacity() const
+        {
+            return (_capacity);
+        }
+
+        std::shared_ptr<const PreparedKey>& Prepared() const
+        {
+            return _prepared;
+        }
+
     private:
+        uint8_t* _buffer;
+        uint16_t _size;
+        uint16_t _capacity;
         bool _exportable;
+        mutable std::shared_ptr<const PreparedKey> _prepared;
+    };
+
+    struct Statistics {
+        uint32_t items;     // blobs held
+        uint64_t bytes;     // memory taken by the blobs, bookkeeping included (slots, not the pages they are carved from)
+        uint64_t peak;      // highest bytes so far
+        uint64_t quota;     // bytes allowed, 0 if unlimited
+        uint32_t rejected;  // blobs refused because of the quota
     };
 
 public:
@@ -70,17 +163,168 @@ public:
     uint16_t Export(const uint32_t id, const uint16_t size, uint8_t blob[], bool allowSealed = false) const;
     uint32_t Put(const uint16_t size, const uint8_t blob[]);
     uint16_t Get(const uint32_t id, const uint16_t size, uint8_t blob[]) const;
+    // Revokes the prepared key of the item as well, so operations created on it stop working.
     bool Delete(const uint32_t id);
 
+    // The prepared key is created on first use and kept with the item until it is deleted.
+    std::shared_ptr<const PreparedKey> Prepare(const uint32_t id) const;
+
+    // Memory accounting of this vault, the quota is set with CRYPTOGRAPHY_VAULT_QUOTA (bytes, per vault).
+    void Usage(Statistics& statistics) const;
+
+    // Persistent key storage of this vault, nullptr if none is configured.
+    PersistentStore* Store()
+    {
+        return (_store.get());
+    }
+
+private:
+    // Readers (Size/Export/Get/Prepare) share the lock, so they never wait on each other; a writer
+    // (Import/Put/Delete) has it exclusively. Both sides block rather than spin.
+    class SharedLock {
+    public:
+        SharedLock()
+            : _lock()
+        {
+            VARIABLE_IS_NOT_USED int result = pthread_rwlock_init(&_lock, nullptr);
+            ASSERT(result == 0);
+        }
+        SharedLock(const SharedLock&) = delete;
+        SharedLock& operator=(const SharedLock&) = delete;
+        ~SharedLock()
+        {
+            pthread_rwlock_destroy(&_lock);
+        }
+
+    public:
+        void LockShared() const
+        {
+            VARIABLE_IS_NOT_USED int result = pthread_rwlock_rdlock(&_lock);
+            ASSERT(result == 0);
+        }
+        void UnlockShared() const
+        {
+            pthread_rwlock_unlock(&_lock);
+        }
+        void Lock()
+        {
+            VARIABLE_IS_NOT_USED int result = pthread_rwlock_wrlock(&_lock);
+            ASSERT(result == 0);
+        }
+        void Unlock()
+        {
+            pthread_rwlock_unlock(&_lock);
+        }
+
+    private:
+        mutable pthread_rwlock_t _lock;
+    };
+
+    // Fixed size slots for the sealed blobs, carved from pages, so the small keys most of a vault is made
+    // of do not cost a heap allocation (and its header) each. Free slots are linked through their first
+    // bytes. Blobs too large for the largest slot go to the heap. A page is given back once none of its
+    // slots is in use, except for the last page of a size class, so the memory held stays close to what
+    // the statistics report.
+    class Slab {
+    private:
+        static constexpr uint8_t CLASSES = 4;
+        static constexpr uint16_t SMALLEST = 32;
+        static constexpr uint16_t PAGE = 4096;
+
+        struct Page {
+            uint8_t index;
+            uint16_t used;
+        };
+
+    public:
+        Slab()
+            : _free()
+            , _count()
+            , _pages()
+        {
+            _free.fill(nullptr);
+            _count.fill(0);
+        }
+        Slab(const Slab&) = delete;
+        Slab& operator=(const Slab&) = delete;
+        ~Slab();
+
+    public:
+        // The capacity actually taken by a blob of the given size.
+        static uint16_t Capacity(const uint16_t size);
+
+        uint8_t* Allocate(const uint16_t capacity);
+        void Free(uint8_t* slot, const uint16_t capacity);
+
+    private:
+        static uint8_t Class(const uint16_t capacity);
+
+        // The page a slot was carved from.
+        std::map<uint8_t*, Page>::iterator Owner(uint8_t* slot);
+
+    private:
+        std::array<uint8_t*, CLASSES> _free;
+        std::array<uint16_t, CLASSES> _count;
+        std::map<uint8_t*, Page> _pages;
+    };
+
+    // Handles are handed out sequentially, so the low bits spread the items evenly over the shards.
+    static constexpr uint8_t SHARDS = 16;
+
+    // Estimate of what a map node costs next to the element itself.
+    static constexpr uint16_t ITEM_OVERHEAD = (sizeof(Element) + (4 * sizeof(void*)));
+
+    // The slab is guarded by the writer side of the shard lock, as it only changes on insertion and deletion.
+    struct alignas(64) Shard {
+        SharedLock lock;
+        std::map<uint32_t, Element> items;
+        Slab slab;
+
+        ~Shard()
+        {
+            for (auto& item : items) {
+                slab.Free(item.second.Buffer(), item.second.Capacity());
+            }
+        }
+    };
+
+    Shard& Lookup(const uint32_t id)
+    {
+        return (_shards[id & (SHARDS - 1)]);
+    }
+    const Shard& Lookup(const uint32_t id) const
+    {
+        return (_shards[id & (SHARDS - 1)]);
+    }
+
+    uint32_t Insert(bool exportable, const uint16_t size, const uint8_t blob[]);
+
+    // Account for the memory of a new blob, false if it does not fit in the quota.
+    bool Reserve(const uint32_t bytes);
+    void Unreserve(const uint32_t bytes);
+
 private:
     uint16_t Cipher(bool encrypt, const uint16_t inSize, const uint8_t input[], const uint16_t maxOutSize, uint8_t output[]) const;
 
+    // Sealing contexts are copies of _keyed, so the key schedule is expanded only once per vault;
+    // an operation only sets the IV on a context taken from the free list.
+    EVP_CIPHER_CTX* AcquireContext() const;
+    void ReleaseContext(EVP_CIPHER_CTX* context) const;
+
 private:
-    mutable WPEFramework::Core::CriticalSection _lock;
-    std::map<uint32_t, Element> _items;
-    uint32_t _lastHandle;
+    std::array<Shard, SHARDS> _shards;
+    std::atomic<uint32_t> _lastHandle;
+    std::atomic<uint32_t> _items;
+    std::atomic<uint64_t> _bytes;
+    std::atomic<uint64_t> _peak;
+    std::atomic<uint32_t> _rejected;
+    uint64_t _quota;
     string _vaultKey;
     Callback _dtor;
+    EVP_CIPHER_CTX* _keyed;
+    mutable WPEFramework::Core::CriticalSection _contextLock;
+    mutable std::vector<EVP_CIPHER_CTX*> _contexts;
+    std::unique_ptr<PersistentStore> _store;
 };
 
 } // namespace Implementation
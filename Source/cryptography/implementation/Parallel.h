@@ -0,0 +1,208 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "../Module.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Implementation {
+
+// Splits block cipher modes without chaining (ECB, CTR) over a pool of worker threads, shared
+// by all ciphers of the process. Configured with the environment:
+//   CRYPTOGRAPHY_CIPHER_WORKERS             threads next to the calling thread (default: cores - 1, 0 disables)
+//   CRYPTOGRAPHY_CIPHER_PARALLEL_THRESHOLD  smallest input split up in bytes (default: 256 KiB)
+class Parallel {
+public:
+    static constexpr uint32_t BlockSize = 16;
+
+private:
+    static constexpr uint32_t DefaultThreshold = (256 * 1024);
+    static constexpr uint32_t MinimumChunk = (64 * 1024);
+
+    struct Batch {
+        const std::function<void(const uint16_t)>& job;
+        uint16_t count;
+        uint16_t next;
+        uint16_t done;
+    };
+
+    friend class WPEFramework::Core::SingletonType<Parallel>;
+
+    Parallel()
+        : _lock()
+        , _signal()
+        , _finished()
+        , _batches()
+        , _workers()
+        , _threshold(DefaultThreshold)
+        , _stopping(false)
+    {
+        string value;
+
+        uint32_t workers = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+
+        if (WPEFramework::Core::SystemInfo::GetEnvironment(_T("CRYPTOGRAPHY_CIPHER_WORKERS"), value) == true) {
+            workers = static_cast<uint32_t>(::strtoul(value.c_str(), nullptr, 0));
+        }
+        if (WPEFramework::Core::SystemInfo::GetEnvironment(_T("CRYPTOGRAPHY_CIPHER_PARALLEL_THRESHOLD"), value) == true) {
+            _threshold = std::max(static_cast<uint32_t>(::strtoul(value.c_str(), nullptr, 0)), (4 * BlockSize));
+        }
+
+        for (uint32_t index = 0; index < std::min(workers, 64u); index++) {
+            _workers.emplace_back(&Parallel::Worker, this);
+        }
+    }
+
+public:
+    Parallel(const Parallel&) = delete;
+    Parallel& operator=(const Parallel&) = delete;
+
+    // Torn down with Core::Singleton::Dispose(), not in static destruction, as the workers have to be
+    // joined while the rest of the process is still there.
+    ~Parallel()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _stopping = true;
+        }
+
+        _signal.notify_all();
+
+        for (std::thread& worker : _workers) {
+            worker.join();
+        }
+    }
+
+    static Parallel& Instance()
+    {
+        return (WPEFramework::Core::SingletonType<Parallel>::Instance());
+    }
+
+public:
+    // Number of block aligned chunks to split an input of the given length in, 1 to do it in one go.
+    uint16_t Chunks(const uint32_t length) const
+    {
+        uint32_t result = 1;
+
+        if ((_workers.empty() == false) && (length >= _threshold)) {
+            result = std::min(static_cast<uint32_t>(_workers.size() + 1), std::max((length / MinimumChunk), 1u));
+        }
+
+        return (static_cast<uint16_t>(result));
+    }
+
+    // Offset of a chunk, block aligned and the end of the last chunk is length.
+    static uint32_t Offset(const uint32_t length, const uint16_t chunks, const uint16_t chunk)
+    {
+        const uint32_t blocks = (length / BlockSize);
+
+        return (chunk == chunks ? length : static_cast<uint32_t>((static_cast<uint64_t>(blocks) * chunk) / chunks) * BlockSize);
+    }
+
+    // Big endian addition of blocks to a CTR counter, as the counter is incremented over the whole block.
+    static void Advance(uint8_t counter[BlockSize], uint32_t blocks)
+    {
+        uint8_t position = BlockSize;
+        uint32_t carry = blocks;
+
+        while ((position > 0) && (carry != 0)) {
+            position--;
+            carry += counter[position];
+            counter[position] = static_cast<uint8_t>(carry & 0xFF);
+            carry >>= 8;
+        }
+    }
+
+    // Run job(0) up to job(count - 1), the calling thread takes part and returns once all are done.
+    void Run(const uint16_t count, const std::function<void(const uint16_t)>& job)
+    {
+        Batch batch{ job, count, 0, 0 };
+
+        std::unique_lock<std::mutex> lock(_lock);
+
+        _batches.push_back(&batch);
+        _signal.notify_all();
+
+        while (batch.next < batch.count) {
+            const uint16_t index = Take(batch);
+
+            lock.unlock();
+            job(index);
+            lock.lock();
+
+            batch.done++;
+        }
+
+        _finished.wait(lock, [&batch]() { return (batch.done == batch.count); });
+    }
+
+private:
+    // Called with the lock held, an index taken keeps the batch alive until it is done.
+    uint16_t Take(Batch& batch)
+    {
+        const uint16_t index = batch.next++;
+
+        if (batch.next == batch.count) {
+            _batches.remove(&batch);
+        }
+
+        return (index);
+    }
+
+    void Worker()
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+
+        while (_stopping == false) {
+            if (_batches.empty() == true) {
+                _signal.wait(lock);
+            } else {
+                Batch& batch(*_batches.front());
+                const uint16_t index = Take(batch);
+
+                lock.unlock();
+                batch.job(index);
+                lock.lock();
+
+                if (++batch.done == batch.count) {
+                    _finished.notify_all();
+                }
+            }
+        }
+    }
+
+private:
+    std::mutex _lock;
+    std::condition_variable _signal;
+    std::condition_variable _finished;
+    std::list<Batch*> _batches;
+    std::vector<std::thread> _workers;
+    uint32_t _threshold;
+    bool _stopping;
+};
+
+} // namespace Implementation
@@ -0,0 +1,341 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SHA256MultiBuffer.h"
+
+#include <string.h>
+
+// The lanes are plain compiler vector types, so the same code turns into SSE/AVX2 on x86 and NEON on ARM.
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__AVX2__)
+#define SHA256_LANES 8
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__SSE2__) || defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__ALTIVEC__))
+#define SHA256_LANES 4
+#else
+#define SHA256_LANES 1
+#endif
+
+namespace Implementation {
+
+namespace SHA256MultiBuffer {
+
+namespace {
+
+#if SHA256_LANES > 1
+    typedef uint32_t Word __attribute__((vector_size(SHA256_LANES * sizeof(uint32_t))));
+
+    inline uint32_t Get(const Word& word, const uint8_t lane)
+    {
+        return (word[lane]);
+    }
+    inline void Set(Word& word, const uint8_t lane, const uint32_t value)
+    {
+        word[lane] = value;
+    }
+    inline Word Splat(const uint32_t value)
+    {
+        Word word;
+        for (uint8_t lane = 0; lane < SHA256_LANES; lane++) {
+            word[lane] = value;
+        }
+        return (word);
+    }
+#else
+    typedef uint32_t Word;
+
+    inline uint32_t Get(const Word& word, const uint8_t)
+    {
+        return (word);
+    }
+    inline void Set(Word& word, const uint8_t, const uint32_t value)
+    {
+        word = value;
+    }
+    inline Word Splat(const uint32_t value)
+    {
+        return (value);
+    }
+#endif
+
+    static const uint32_t K[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+
+    static const uint32_t IV[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+
+    inline Word Rotate(const Word value, const uint8_t bits)
+    {
+        return ((value >> bits) | (value << (32 - bits)));
+    }
+
+    inline uint32_t Load(const uint8_t data[])
+    {
+        return ((static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) | (static_cast<uint32_t>(data[2]) << 8) | data[3]);
+    }
+
+    inline void Store(uint8_t data[], const uint32_t value)
+    {
+        data[0] = static_cast<uint8_t>(value >> 24);
+        data[1] = static_cast<uint8_t>(value >> 16);
+        data[2] = static_cast<uint8_t>(value >> 8);
+        data[3] = static_cast<uint8_t>(value);
+    }
+
+    void Compress(Word state[8], const Word block[16])
+    {
+        Word w[64];
+
+        for (uint8_t t = 0; t < 16; t++) {
+            w[t] = block[t];
+        }
+        for (uint8_t t = 16; t < 64; t++) {
+            const Word s0 = Rotate(w[t - 15], 7) ^ Rotate(w[t - 15], 18) ^ (w[t - 15] >> 3);
+            const Word s1 = Rotate(w[t - 2], 17) ^ Rotate(w[t - 2], 19) ^ (w[t - 2] >> 10);
+            w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+        }
+
+        Word a = state[0];
+        Word b = state[1];
+        Word c = state[2];
+        Word d = state[3];
+        Word e = state[4];
+        Word f = state[5];
+        Word g = state[6];
+        Word h = state[7];
+
+        for (uint8_t t = 0; t < 64; t++) {
+            const Word t1 = h + (Rotate(e, 6) ^ Rotate(e, 11) ^ Rotate(e, 25)) + ((e & f) ^ (~e & g)) + Splat(K[t]) + w[t];
+            const Word t2 = (Rotate(a, 2) ^ Rotate(a, 13) ^ Rotate(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+
+    inline uint32_t Blocks(const uint32_t length)
+    {
+        // Message, the 0x80 terminator and the 64 bits length, rounded up to whole blocks
+        return (static_cast<uint32_t>((static_cast<uint64_t>(length) + 9 + 63) / 64));
+    }
+
+    // Block 'index' of the padded message, 'prefix' bytes were compressed before the message itself.
+    void Block(const uint8_t message[], const uint32_t length, const uint32_t prefix, const uint32_t index, uint8_t block[64])
+    {
+        const uint64_t offset = static_cast<uint64_t>(index) * 64;
+
+        ::memset(block, 0, 64);
+
+        if (offset < length) {
+            const uint64_t left = (length - offset);
+            ::memcpy(block, (message + offset), (left < 64 ? static_cast<size_t>(left) : 64));
+        }
+        if ((length >= offset) && (length < (offset + 64))) {
+            block[length - offset] = 0x80;
+        }
+        if (index == (Blocks(length) - 1)) {
+            const uint64_t bits = ((static_cast<uint64_t>(prefix) + length) * 8);
+            Store(&block[56], static_cast<uint32_t>(bits >> 32));
+            Store(&block[60], static_cast<uint32_t>(bits));
+        }
+    }
+
+    void Single(const uint32_t length, const uint8_t data[], uint32_t digest[8])
+    {
+        Word state[8];
+        Word words[16];
+        uint8_t block[64];
+
+        for (uint8_t s = 0; s < 8; s++) {
+            state[s] = Splat(IV[s]);
+        }
+
+        const uint32_t blocks = Blocks(length);
+
+        for (uint32_t index = 0; index < blocks; index++) {
+            Block(data, length, 0, index, block);
+            for (uint8_t t = 0; t < 16; t++) {
+                words[t] = Splat(Load(&block[t * 4]));
+            }
+            Compress(state, words);
+        }
+
+        for (uint8_t s = 0; s < 8; s++) {
+            digest[s] = Get(state[s], 0);
+        }
+
+        ::memset(block, 0, sizeof(block));
+    }
+
+    void Pad(const uint8_t key[64], const uint8_t pad, uint32_t result[8])
+    {
+        Word state[8];
+        Word words[16];
+
+        for (uint8_t s = 0; s < 8; s++) {
+            state[s] = Splat(IV[s]);
+        }
+        for (uint8_t t = 0; t < 16; t++) {
+            const uint8_t padded[4] = {
+                static_cast<uint8_t>(key[(t * 4) + 0] ^ pad), static_cast<uint8_t>(key[(t * 4) + 1] ^ pad),
+                static_cast<uint8_t>(key[(t * 4) + 2] ^ pad), static_cast<uint8_t>(key[(t * 4) + 3] ^ pad)
+            };
+            words[t] = Splat(Load(padded));
+        }
+
+        Compress(state, words);
+
+        for (uint8_t s = 0; s < 8; s++) {
+            result[s] = Get(state[s], 0);
+        }
+    }
+
+} // namespace
+
+uint8_t Lanes()
+{
+    return (SHA256_LANES);
+}
+
+void Prepare(const uint32_t length, const uint8_t key[], Key& prepared)
+{
+    uint8_t block[64];
+
+    ::memset(block, 0, sizeof(block));
+
+    if (length > sizeof(block)) {
+        // Keys longer than a block are hashed first
+        uint32_t digest[8];
+        Single(length, key, digest);
+        for (uint8_t s = 0; s < 8; s++) {
+            Store(&block[s * 4], digest[s]);
+        }
+        ::memset(digest, 0, sizeof(digest));
+    } else {
+        ::memcpy(block, key, length);
+    }
+
+    Pad(block, 0x36, prepared.inner);
+    Pad(block, 0x5C, prepared.outer);
+
+    ::memset(block, 0, sizeof(block));
+}
+
+void HMAC(const Key& key, const uint16_t count, const uint8_t* const messages[], const uint32_t lengths[], uint8_t output[])
+{
+    uint8_t block[64];
+
+    for (uint16_t first = 0; first < count; first += SHA256_LANES) {
+        const uint8_t lanes = static_cast<uint8_t>((count - first) < SHA256_LANES ? (count - first) : SHA256_LANES);
+
+        Word state[8];
+        Word words[16];
+        uint32_t inner[SHA256_LANES][8];
+        uint32_t blocks[SHA256_LANES];
+        uint32_t maximum = 0;
+
+        for (uint8_t lane = 0; lane < lanes; lane++) {
+            blocks[lane] = Blocks(lengths[first + lane]);
+            if (blocks[lane] > maximum) {
+                maximum = blocks[lane];
+            }
+        }
+
+        // Inner hash, continuing from the compressed ipad block. Lanes that ran out of
+        // blocks are fed zeros, their result was already taken after their last block.
+        for (uint8_t s = 0; s < 8; s++) {
+            state[s] = Splat(key.inner[s]);
+        }
+
+        for (uint32_t index = 0; index < maximum; index++) {
+            for (uint8_t t = 0; t < 16; t++) {
+                words[t] = Splat(0);
+            }
+
+            for (uint8_t lane = 0; lane < lanes; lane++) {
+                if (index < blocks[lane]) {
+                    Block(messages[first + lane], lengths[first + lane], 64, index, block);
+                    for (uint8_t t = 0; t < 16; t++) {
+                        Set(words[t], lane, Load(&block[t * 4]));
+                    }
+                }
+            }
+
+            Compress(state, words);
+
+            for (uint8_t lane = 0; lane < lanes; lane++) {
+                if (index == (blocks[lane] - 1)) {
+                    for (uint8_t s = 0; s < 8; s++) {
+                        inner[lane][s] = Get(state[s], lane);
+                    }
+                }
+            }
+        }
+
+        // Outer hash, a single block: the inner digest, the terminator and the length of opad + digest (96 bytes).
+        for (uint8_t s = 0; s < 8; s++) {
+            state[s] = Splat(key.outer[s]);
+        }
+        for (uint8_t t = 0; t < 16; t++) {
+            words[t] = Splat(0);
+        }
+        for (uint8_t lane = 0; lane < lanes; lane++) {
+            for (uint8_t t = 0; t < 8; t++) {
+                Set(words[t], lane, inner[lane][t]);
+            }
+        }
+        words[8] = Splat(0x80000000);
+        words[15] = Splat((64 + 32) * 8);
+
+        Compress(state, words);
+
+        for (uint8_t lane = 0; lane < lanes; lane++) {
+            for (uint8_t s = 0; s < 8; s++) {
+                Store(&output[((first + lane) * 32) + (s * 4)], Get(state[s], lane));
+            }
+        }
+    }
+
+    ::memset(block, 0, sizeof(block));
+}
+
+} // namespace SHA256MultiBuffer
+
+} // namespace Implementation
@@ -0,0 +1,46 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace Implementation {
+
+namespace SHA256MultiBuffer {
+
+    // Number of messages hashed side by side, depends on the vector unit the code is built for
+    // (8 with AVX2, 4 with SSE2/NEON/AltiVec, 1 otherwise).
+    uint8_t Lanes();
+
+    // HMAC key with the inner and outer pad blocks already compressed, so the
+    // key blocks are not recalculated for every message.
+    struct Key {
+        uint32_t inner[8];
+        uint32_t outer[8];
+    };
+
+    void Prepare(const uint32_t length, const uint8_t key[], Key& prepared);
+
+    // HMAC-SHA256 of count independent messages, output receives count * 32 bytes back to back.
+    void HMAC(const Key& key, const uint16_t count, const uint8_t* const messages[], const uint32_t lengths[], uint8_t output[]);
+
+} // namespace SHA256MultiBuffer
+
+} // namespace Implementation
@@ -36,6 +36,9 @@ namespace Implementation {
         , _keyLength(keyLength)
         , _ivLength(ivLength)
         , _algorithm(algorithm)
+        , _key(nullptr)
+        , _lock()
+        , _handles{ nullptr, nullptr }
     {
 
         ASSERT(vault != nullptr);
@@ -43,12 +46,44 @@ namespace Implementation {
         ASSERT(keyLength != 0);
         ASSERT(ivLength != 0)
 
+        // The key instance is kept for the lifetime of the cipher, creating it per operation costs
+        // more than the AES itself for small payloads.
+        IdStore* ids;
+        uint8_t* keyBuf = reinterpret_cast<uint8_t*>(ALLOCA(sizeof(ids)));
+        ASSERT(keyBuf != nullptr);
+
+        uint16_t length = _vault->Export(_keyId, _keyLength, keyBuf, true);
+        if (length != _keyLength) {
+            TRACE_L1(_T("SEC: Failed to retrieve a valid encryption key from id 0x%08x"), _keyId);
+        }
+        else if (_vault->getSecProcHandle() == nullptr) {
+            TRACE_L1(_T("SEC: Unable to have a valid secproc handle from vault \n"));
+        }
+        else {
+            std::memcpy(&ids, keyBuf, sizeof(ids));
+            ASSERT(ids->idAes != 0);
+
+            TRACE_L2(_T("SEC : the object id sec from export is %llu \n"), ids->idAes);
+            Sec_Result sec_result = SecKey_GetInstance(_vault->getSecProcHandle(), ids->idAes, &_key);
+            if ((sec_result != SEC_RESULT_SUCCESS) || (_key == nullptr)) {
+                TRACE_L1(_T("SEC: Key instance failed ,retVal = %d \n"), sec_result);
+                _key = nullptr;
+            }
+        }
     }
 
     /* DOTR */
     Cipher::~Cipher()
     {
+        for (Sec_CipherHandle* handle : _handles) {
+            if (handle != nullptr) {
+                SecCipher_Release(handle);
+            }
+        }
 
+        if (_key != nullptr) {
+            SecKey_Release(_key);
+        }
     }
 
     /*********************************************************************
@@ -126,62 +161,48 @@ namespace Implementation {
             TRACE_L1(_T("Too small output buffer, expected: %i bytes"), inputLength);
             OutputLength = (-inputLength) + (16 - (inputLength % 16));
         }
+        else if (_key == nullptr) {
+            TRACE_L1(_T("SEC: No key instance available for id 0x%08x"), _keyId);
+        }
+        else if (_algorithm == SEC_CIPHERALGORITHM_AES_CTR) {
+            // CTR handles are kept per direction and only get a new IV, the stream is never
+            // finalized so the handle stays usable. The handle is not reentrant, hence the lock.
+            _lock.Lock();
+            Sec_CipherHandle* cipher_handle = Handle(encrypt, iv);
+            if (cipher_handle != nullptr) {
+                SEC_BYTE* input_data = const_cast<SEC_BYTE*>(input);
+                Sec_Result sec_res = SecCipher_Process(cipher_handle, input_data, inputLength, SEC_FALSE, output, maxOutputLength, &OutputLength);
+                if (sec_res != SEC_RESULT_SUCCESS) {
+                    TRACE_L1(_T("SEC SecCipher_Process failed retVal = %d \n"),sec_res);
+                    OutputLength = 0;
+                }
+                else {
+                    TRACE_L2(_T("SEC: Completed %scryption, input size: %i, output size: %i"), (encrypt ? "en" : "de"), inputLength, OutputLength);
+                }
+            }
+            _lock.Unlock();
+        }
         else {
+            // Padded modes finalize the handle, so only the key instance is reused
             Sec_CipherHandle* cipher_handle = NULL;
-            Sec_Result sec_res = SEC_RESULT_FAILURE;
-            Sec_KeyHandle* sec_key;
-            SEC_OBJECTID id_sec;
-            Sec_CipherMode mode_val = SEC_CIPHERMODE_DECRYPT;
-            IdStore* ids;
-
-            uint8_t* keyBuf = reinterpret_cast<uint8_t*>(ALLOCA(sizeof(ids)));
-            ASSERT(keyBuf != nullptr);
-
-            uint16_t length = _vault->Export(_keyId, _keyLength, keyBuf, true);
-            ASSERT(length != 0);
-            if (length != _keyLength) {
-                TRACE_L1(_T("SEC: Failed to retrieve a valid encryption key from id 0x%08x"), _keyId);
+            Sec_CipherMode mode_val = (encrypt ? SEC_CIPHERMODE_ENCRYPT : SEC_CIPHERMODE_DECRYPT);
+            SEC_BYTE* iv_data = const_cast<SEC_BYTE*>(iv);
+            Sec_Result sec_res = SecCipher_GetInstance(_vault->getSecProcHandle(), _algorithm, mode_val, _key, iv_data, &cipher_handle);
+            if (sec_res != SEC_RESULT_SUCCESS || cipher_handle == NULL) {
+                TRACE_L1(_T("SEC:cipher handle not created retVal = %d and cipher handle =%p \n"),sec_res,cipher_handle);
             }
             else {
-                // Perform cipher operation 
-                if (_vault->getSecProcHandle() != nullptr) {
-                    std::memcpy(&ids, keyBuf, sizeof(ids));
-                    ASSERT(ids->idAes != 0);
-                    id_sec = ids->idAes;
-
-                    TRACE_L2(_T("SEC : the object id sec from export is %llu \n"), id_sec);
-                    Sec_Result sec_result = SecKey_GetInstance(_vault->getSecProcHandle(), id_sec, &sec_key);
-                    if (sec_key != nullptr && sec_result == SEC_RESULT_SUCCESS) {
-                        if (encrypt) {
-                            mode_val = SEC_CIPHERMODE_ENCRYPT;
-                        }
-                        SEC_BYTE* iv_data = const_cast<SEC_BYTE*>(iv);
-                        sec_res = SecCipher_GetInstance(_vault->getSecProcHandle(), _algorithm, mode_val, sec_key, iv_data, &cipher_handle);
-                        if (sec_res != SEC_RESULT_SUCCESS || cipher_handle == NULL) {
-                            TRACE_L1(_T("SEC:cipher handle not created retVal = %d and cipher handle =%p \n"),sec_res,cipher_handle);
-                            SecKey_Release(sec_key);
-                            return 0;
-                        }
-                        //Processes data with the speciﬁed cipher and mode
-                        SEC_BYTE* input_data = const_cast<SEC_BYTE*>(input);
-                        sec_res = SecCipher_Process(cipher_handle, input_data, inputLength, SEC_TRUE, output, maxOutputLength, &OutputLength);
-                        if (sec_res != SEC_RESULT_SUCCESS) {
-                            TRACE_L1(_T("SEC SecCipher_Process failed retVal = %d \n"),sec_res);
-                        }
-                        else {
-                            TRACE_L2(_T("SEC: Completed %scryption, input size: %i, output size: %i"), (encrypt ? "en" : "de"), inputLength, OutputLength);
-                        }
-                        //release cipher handle
-                        SecCipher_Release(cipher_handle);
-                        SecKey_Release(sec_key);
-                    }
-                    else {
-                        TRACE_L1(_T("SEC: Key instance failed ,retVal = %d \n"),sec_result);
-                    }
+                //Processes data with the speciﬁed cipher and mode
+                SEC_BYTE* input_data = const_cast<SEC_BYTE*>(input);
+                sec_res = SecCipher_Process(cipher_handle, input_data, inputLength, SEC_TRUE, output, maxOutputLength, &OutputLength);
+                if (sec_res != SEC_RESULT_SUCCESS) {
+                    TRACE_L1(_T("SEC SecCipher_Process failed retVal = %d \n"),sec_res);
                 }
-                else { 
-                    TRACE_L1(_T("SEC: Unable to have a valid secproc handle from vault \n"));
+                else {
+                    TRACE_L2(_T("SEC: Completed %scryption, input size: %i, output size: %i"), (encrypt ? "en" : "de"), inputLength, OutputLength);
                 }
+                //release cipher handle
+                SecCipher_Release(cipher_handle);
             }
         }
 
@@ -189,6 +210,42 @@ namespace Implementation {
 
     }
 
+    /*********************************************************************
+     * @function Handle
+     *
+     * @brief    Get the cached CTR cipher handle for a direction, set to a new IV
+     *
+     * @param[in] encrypt - mode :true for enc and false for decrypt
+     * @param[in] iv - intitialization vector
+     *
+     * @return cipher handle, nullptr on failure (must be called with _lock taken)
+     *
+     *********************************************************************/
+    Sec_CipherHandle* Cipher::Handle(bool encrypt, const uint8_t iv[]) const
+    {
+        Sec_CipherHandle*& handle = _handles[encrypt ? 1 : 0];
+        SEC_BYTE* iv_data = const_cast<SEC_BYTE*>(iv);
+
+        if (handle == nullptr) {
+            Sec_CipherMode mode_val = (encrypt ? SEC_CIPHERMODE_ENCRYPT : SEC_CIPHERMODE_DECRYPT);
+            Sec_Result sec_res = SecCipher_GetInstance(_vault->getSecProcHandle(), _algorithm, mode_val, _key, iv_data, &handle);
+            if (sec_res != SEC_RESULT_SUCCESS || handle == NULL) {
+                TRACE_L1(_T("SEC:cipher handle not created retVal = %d and cipher handle =%p \n"),sec_res,handle);
+                handle = nullptr;
+            }
+        }
+        else {
+            Sec_Result sec_res = SecCipher_UpdateIV(handle, iv_data);
+            if (sec_res != SEC_RESULT_SUCCESS) {
+                TRACE_L1(_T("SEC: SecCipher_UpdateIV() failed retVal = %d \n"),sec_res);
+                SecCipher_Release(handle);
+                handle = nullptr;
+            }
+        }
+
+        return (handle);
+    }
+
     /*********************************************************************
      * @function AESCipher
      *
@@ -288,6 +345,33 @@ extern "C" {
         return (cipher->Decrypt(iv_length, iv, input_length, input, max_output_length, output));
     }
 
+    // Authenticated encryption is not exposed by SecApi, cipher_create_aead() never returns a cipher
+
+    struct CipherImplementation* cipher_create_aead(const struct VaultImplementation* vault, const aead_mode mode, const uint32_t key_id)
+    {
+        ASSERT(vault != nullptr);
+        TRACE_L1(_T("SEC: AEAD mode %d not supported\n"), mode);
+        return (nullptr);
+    }
+
+    int32_t cipher_aead_encrypt(const struct CipherImplementation* cipher, const uint8_t iv_length, const uint8_t iv[],
+        const uint16_t aad_length, const uint8_t aad[],
+        const uint32_t input_length, const uint8_t input[], const uint32_t max_output_length, uint8_t output[],
+        const uint8_t tag_length, uint8_t tag[])
+    {
+        ASSERT(cipher != nullptr);
+        return (0);
+    }
+
+    int32_t cipher_aead_decrypt(const struct CipherImplementation* cipher, const uint8_t iv_length, const uint8_t iv[],
+        const uint16_t aad_length, const uint8_t aad[],
+        const uint32_t input_length, const uint8_t input[], const uint32_t max_output_length, uint8_t output[],
+        const uint8_t tag_length, const uint8_t tag[])
+    {
+        ASSERT(cipher != nullptr);
+        return (0);
+    }
+
 
 } // extern "C"
 
@@ -64,6 +64,10 @@ namespace Implementation {
         int32_t Decrypt(const uint8_t ivLength, const uint8_t iv[], const uint32_t inputLength,
             const uint8_t input[], const uint32_t maxOutputLength, uint8_t output[]) const override;
 
+    private:
+
+        Sec_CipherHandle* Handle(bool encrypt, const uint8_t iv[]) const;
+
     private:
 
         const Implementation::Vault* _vault;
@@ -71,6 +75,9 @@ namespace Implementation {
         uint8_t _keyLength;
         uint8_t _ivLength;
         const Sec_CipherAlgorithm _algorithm;
+        Sec_KeyHandle* _key;
+        mutable WPEFramework::Core::CriticalSection _lock;
+        mutable Sec_CipherHandle* _handles[2];
 
     };
 
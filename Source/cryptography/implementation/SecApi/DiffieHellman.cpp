@@ -20,6 +20,7 @@
 #include "../../Module.h"
 
 #include <diffiehellman_implementation.h>
+#include <keyagreement_implementation.h>
 
 #include "Vault.h"
 
@@ -164,6 +165,32 @@ extern "C" {
         return 0;
     }
 
+    // Elliptic curve key agreement
+
+    uint32_t keyagreement_generate(struct VaultImplementation* vault, const key_agreement_curve curve,
+        uint32_t* private_key_id, uint32_t* public_key_id)
+    {
+        ASSERT(vault != nullptr);
+        ASSERT(private_key_id != nullptr);
+        ASSERT(public_key_id != nullptr);
+
+        //Not supported by SecApi
+        TRACE_L1(_T("SEC: key agreement on curve %d not supported\n"), curve);
+        (*private_key_id) = 0;
+        (*public_key_id) = 0;
+        return (-1);
+    }
+
+    uint32_t keyagreement_derive(struct VaultImplementation* vault, const uint32_t private_key_id, const uint32_t peer_public_key_id, uint32_t* secret_id)
+    {
+        ASSERT(vault != nullptr);
+        ASSERT(secret_id != nullptr);
+
+        //Not supported by SecApi
+        (*secret_id) = 0;
+        return (-1);
+    }
+
     // Netflix Security
 
     uint32_t netflix_security_derive_keys(const uint32_t private_dh_key_id, const uint32_t peer_public_dh_key_id, const uint32_t derivation_key_id,
@@ -63,6 +63,23 @@ namespace Implementation {
 
         // Wrappers to get around different function names for digest and HMAC calculation.
         struct Digest {
+            /*********************************************************************
+             * @function  Init (Digest)
+             *
+             * @brief    Wrapper for starting a new digest calculation
+             *
+             * @param[in] hndle - digest/mac handle
+             * @param[in] processor - sec processor handle
+             * @param[in] algorithm - digest/mac algorithm
+             * @param[in] key - key handle (unused)
+             *
+             * @return Sec_Result indicating success or otherwise
+             *
+             *********************************************************************/
+            static Sec_Result Init(Handle* hndle, Sec_ProcessorHandle* processor, const HashAlg& algorithm, Sec_KeyHandle* key) {
+                return SecDigest_GetInstance(processor, algorithm.digest_alg, &(hndle->digest_handle));
+            }
+
             /*********************************************************************
              * @function  Update (Digest)
              *
@@ -98,6 +115,23 @@ namespace Implementation {
         };
 
         struct HMAC {
+            /*********************************************************************
+             * @function Init (HMAC)
+             *
+             * @brief Wrapper for starting a new HMAC calculation
+             *
+             * @param[in] hndle - digest/mac handle
+             * @param[in] processor - sec processor handle
+             * @param[in] algorithm - digest/mac algorithm
+             * @param[in] key - key handle
+             *
+             * @return Sec_Result indicating success or otherwise
+             *
+             *******************************************************************/
+            static Sec_Result Init(Handle* hndle, Sec_ProcessorHandle* processor, const HashAlg& algorithm, Sec_KeyHandle* key) {
+                return SecMac_GetInstance(processor, algorithm.mac_alg, key, &(hndle->mac_handle));
+            }
+
             /*********************************************************************
              * @function Update (HMAC)
              *
@@ -146,20 +180,23 @@ namespace Implementation {
         , _size(0)
         , _failure(false)
     {
-        // get Digest Instance
-        _vault_digest = new Implementation::Vault;
+        // Digests share the processor of the default vault, opening one per hash is far too costly
+        _vault_digest = &Implementation::Vault::DefaultInstance();
         if (_vault_digest == nullptr) {
             TRACE_L1(_T("Vault not initialized \n"));
             _failure = true;
         }
         else {
             if (_vault_digest->getSecProcHandle() != nullptr) {
+                _algorithm.digest_alg = digestAlg;
+                _algorithm.size = digestSize;
                 Sec_Result res = SecDigest_GetInstance(_vault_digest->getSecProcHandle(), digestAlg, &(handle->digest_handle));
                 if (res != SEC_RESULT_SUCCESS) {
                     TRACE_L1(_T("SEC :SecDigest_GetInstance() failed retVal: %d\n"),res);
                     _failure = true;
                 }
                 else {
+                    _running = true;
                     _size = digestSize;
                     ASSERT(_size != 0);
                 }
@@ -192,6 +229,8 @@ namespace Implementation {
                 TRACE_L2(_T("SEC : the object id sec from export is %llu \n"), _id_sec);
                 Sec_Result sec_res = SecKey_GetInstance(_vault->getSecProcHandle(), _id_sec, &sec_key);
                 if (sec_key != nullptr && sec_res == SEC_RESULT_SUCCESS) {
+                    _algorithm.mac_alg = macAlg;
+                    _algorithm.size = macSize;
                     Sec_Result res = SecMac_GetInstance(_vault->getSecProcHandle(), macAlg, sec_key, &(handle->mac_handle));
                     if (res != SEC_RESULT_SUCCESS) {
                         TRACE_L1(_T("SEC : SecMac_GetInstance() failed reval :%d \n"),res);
@@ -200,6 +239,7 @@ namespace Implementation {
                         _failure = true;
                     }
                     else {
+                        _running = true;
                         _size = macSize;
                         ASSERT(_size != 0);
                     }
@@ -220,10 +260,12 @@ namespace Implementation {
     template<typename OPERATION>
     Implementation::HashType<OPERATION>::~HashType()
     {
-        delete handle;
-        if (_vault_digest != nullptr) {
-            delete _vault_digest;
+        if (_running == true) {
+            uint8_t scratch[hash_type::HASH_TYPE_SHA512];
+            size_t len = sizeof(scratch);
+            OPERATION::Final(handle, scratch, &len);
         }
+        delete handle;
         if (sec_key != nullptr) {
             SecKey_Release(sec_key);
         }
@@ -283,6 +325,7 @@ namespace Implementation {
             else {
                 size_t len = maxLength;
                 Sec_Result res = OPERATION::Final(handle, data, &len);
+                _running = false;
                 if (res != SEC_RESULT_SUCCESS) {
                     TRACE_L1(_T("Final() failed retVal = %d"),res);
                     _failure = true;
@@ -298,7 +341,61 @@ namespace Implementation {
 
     }
 
+    template<typename OPERATION>
+    /*********************************************************************
+     * @function Reset
+     *
+     * @brief    Restart the digest/hmac calculation with the same algorithm and key
+     *
+     * @return Core::ERROR_NONE on success
+     *
+     *********************************************************************/
+    uint32_t Implementation::HashType<OPERATION>::Reset()
+    {
+        uint32_t result = WPEFramework::Core::ERROR_NONE;
+        const Implementation::Vault* vault = (_vault_digest != nullptr ? _vault_digest : _vault);
+
+        if ((vault == nullptr) || (vault->getSecProcHandle() == nullptr) || (_algorithm.size == 0)) {
+            TRACE_L1(_T("SEC : Hash can not be reset, it was never initialized"));
+            result = WPEFramework::Core::ERROR_UNAVAILABLE;
+        }
+        else {
+            if (_running == true) {
+                // Sec API has no reinitialization, drop the running calculation
+                uint8_t scratch[hash_type::HASH_TYPE_SHA512];
+                size_t len = sizeof(scratch);
+                OPERATION::Final(handle, scratch, &len);
+                _running = false;
+            }
+
+            Sec_Result res = OPERATION::Init(handle, vault->getSecProcHandle(), _algorithm, sec_key);
+            if (res != SEC_RESULT_SUCCESS) {
+                TRACE_L1(_T("SEC : Init() failed retVal = %d"), res);
+                _failure = true;
+                result = WPEFramework::Core::ERROR_GENERAL;
+            }
+            else {
+                _running = true;
+                _failure = false;
+            }
+        }
+        return (result);
+    }
 
+    template<typename OPERATION>
+    /*********************************************************************
+     * @function Copy
+     *
+     * @brief    Fork the digest/hmac calculation
+     *
+     * @return nullptr, Sec API handles can not be duplicated
+     *
+     *********************************************************************/
+    HashImplementation* Implementation::HashType<OPERATION>::Copy() const
+    {
+        TRACE_L1(_T("SEC : Copying a running digest/hmac calculation is not supported"));
+        return (nullptr);
+    }
 
 } // namespace Implementation
 
@@ -372,5 +469,194 @@ extern "C" {
         return (hash->Calculate(max_length, data));
     }
 
+    uint32_t hash_reset(HashImplementation* hash)
+    {
+        ASSERT(hash != nullptr);
+        return (hash->Reset());
+    }
+
+    HashImplementation* hash_copy(const HashImplementation* hash)
+    {
+        ASSERT(hash != nullptr);
+        return (hash->Copy());
+    }
+
+    uint8_t hash_digest(const hash_type type, const uint32_t length, const uint8_t data[], const uint8_t max_length, uint8_t output[])
+    {
+        ASSERT(output != nullptr);
+        uint8_t result = 0;
+        const HashAlg* secalg = Implementation::Algorithm(type);
+
+        if (secalg->size == 0) {
+            TRACE_L1(_T("SEC: Digest type %i not supported"), type);
+        }
+        else if (max_length < secalg->size) {
+            TRACE_L1(_T("Output buffer to small, need %i bytes, got %i bytes"), secalg->size, max_length);
+        }
+        else {
+            const Implementation::Vault& processor = Implementation::Vault::DefaultInstance();
+            if (processor.getSecProcHandle() != nullptr) {
+                SEC_SIZE len = 0;
+                Sec_Result res = SecDigest_SingleInput(processor.getSecProcHandle(), secalg->digest_alg,
+                    const_cast<SEC_BYTE*>(data), length, output, &len);
+                if (res != SEC_RESULT_SUCCESS) {
+                    TRACE_L1(_T("SEC: SecDigest_SingleInput() failed retVal = %d"), res);
+                }
+                else {
+                    result = static_cast<uint8_t>(len);
+                }
+            }
+            else {
+                TRACE_L1(_T("SEC: Unable to get a valid proc handle"));
+            }
+        }
+        delete secalg;
+        return (result);
+    }
+
+    uint8_t hash_hmac(const VaultImplementation* vault, const hash_type type, const uint32_t secret_id,
+        const uint32_t length, const uint8_t data[], const uint8_t max_length, uint8_t output[])
+    {
+        ASSERT(vault != nullptr);
+        ASSERT(output != nullptr);
+        uint8_t result = 0;
+
+        if (Implementation::vaultId == CRYPTOGRAPHY_VAULT_DEFAULT) {
+            const Implementation::Vault* vaultImpl = reinterpret_cast<const Implementation::Vault*>(vault);
+            const HashAlg* secalg = Implementation::Algorithm(type);
+            uint16_t secretLength = vaultImpl->Size(secret_id, true);
+
+            if (secretLength == 0) {
+                TRACE_L1(_T("SEC: Failed to retrieve secret id 0x%08x"), secret_id);
+            }
+            else if ((secalg->size == 0) || (max_length < secalg->size)) {
+                TRACE_L1(_T("SEC: Unsupported HMAC type %i or output buffer to small (%i bytes)"), type, max_length);
+            }
+            else if (vaultImpl->getSecProcHandle() == nullptr) {
+                TRACE_L1(_T("SEC: Unable to get a valid proc handle from vault"));
+            }
+            else {
+                IdStore* ids;
+                uint8_t* secret = reinterpret_cast<uint8_t*>(ALLOCA(sizeof(ids)));
+                if (vaultImpl->Export(secret_id, secretLength, secret, true) != 0) {
+                    Sec_KeyHandle* key = nullptr;
+                    std::memcpy(&ids, secret, sizeof(ids));
+                    ASSERT(ids->idHmac != 0);
+                    Sec_Result res = SecKey_GetInstance(vaultImpl->getSecProcHandle(), ids->idHmac, &key);
+                    if ((res == SEC_RESULT_SUCCESS) && (key != nullptr)) {
+                        SEC_SIZE len = 0;
+                        res = SecMac_SingleInput(vaultImpl->getSecProcHandle(), secalg->mac_alg, key,
+                            const_cast<SEC_BYTE*>(data), length, output, &len);
+                        if (res != SEC_RESULT_SUCCESS) {
+                            TRACE_L1(_T("SEC: SecMac_SingleInput() failed retVal = %d"), res);
+                        }
+                        else {
+                            result = static_cast<uint8_t>(len);
+                        }
+                        SecKey_Release(key);
+                    }
+                    else {
+                        TRACE_L1(_T("SEC :Key instance failed retVal = %d \n"), res);
+                    }
+                }
+            }
+            delete secalg;
+        }
+        else if (Implementation::vaultId == CRYPTOGRAPHY_VAULT_NETFLIX) {
+            const Implementation::VaultNetflix* vaultImplNetflix = reinterpret_cast<const Implementation::VaultNetflix*>(vault);
+            Sec_SocKeyHandle* key = NULL;
+
+            if ((vaultImplNetflix->FindKey(secret_id, &key) != 0) || (vaultImplNetflix->getNetflixHandle() == nullptr)) {
+                TRACE_L1(_T("SEC: hmac for netflix can not be calculated\n"));
+            }
+            else {
+                uint32_t bytesWritten = 0;
+                Sec_Result res = SecNetflix_Hmac(vaultImplNetflix->getNetflixHandle(), key,
+                    const_cast<uint8_t*>(data), length, output, max_length, &bytesWritten);
+                if (res != SEC_RESULT_SUCCESS) {
+                    TRACE_L1(_T("SEC :Hmac calculation by Secnetflix_Hmac failed ,retVal =%d \n"), res);
+                }
+                else {
+                    result = static_cast<uint8_t>(bytesWritten);
+                }
+            }
+        }
+
+        return (result);
+    }
+
+    uint16_t hash_hmac_batch(const VaultImplementation* vault, const hash_type type, const uint32_t secret_id,
+        const uint16_t count, const uint32_t lengths[], const uint8_t data[], const uint32_t max_length, uint8_t output[])
+    {
+        ASSERT(vault != nullptr);
+        ASSERT(output != nullptr);
+        uint16_t result = 0;
+        uint32_t offset = 0;
+
+        if (Implementation::vaultId == CRYPTOGRAPHY_VAULT_DEFAULT) {
+            const Implementation::Vault* vaultImpl = reinterpret_cast<const Implementation::Vault*>(vault);
+            const HashAlg* secalg = Implementation::Algorithm(type);
+            uint16_t secretLength = vaultImpl->Size(secret_id, true);
+
+            if ((secretLength == 0) || (secalg->size == 0) || (vaultImpl->getSecProcHandle() == nullptr)) {
+                TRACE_L1(_T("SEC: Can not calculate HMACs with secret id 0x%08x and type %i"), secret_id, type);
+            }
+            else {
+                IdStore* ids;
+                uint8_t* secret = reinterpret_cast<uint8_t*>(ALLOCA(sizeof(ids)));
+                if (vaultImpl->Export(secret_id, secretLength, secret, true) != 0) {
+                    Sec_KeyHandle* key = nullptr;
+                    std::memcpy(&ids, secret, sizeof(ids));
+                    ASSERT(ids->idHmac != 0);
+                    // One key instance for the whole batch
+                    Sec_Result res = SecKey_GetInstance(vaultImpl->getSecProcHandle(), ids->idHmac, &key);
+                    if ((res == SEC_RESULT_SUCCESS) && (key != nullptr)) {
+                        while ((result < count) && ((max_length - (result * secalg->size)) >= secalg->size)) {
+                            SEC_SIZE len = 0;
+                            res = SecMac_SingleInput(vaultImpl->getSecProcHandle(), secalg->mac_alg, key,
+                                const_cast<SEC_BYTE*>(data + offset), lengths[result], (output + (result * secalg->size)), &len);
+                            if ((res != SEC_RESULT_SUCCESS) || (len != secalg->size)) {
+                                TRACE_L1(_T("SEC: SecMac_SingleInput() failed retVal = %d"), res);
+                                break;
+                            }
+                            offset += lengths[result];
+                            result++;
+                        }
+                        SecKey_Release(key);
+                    }
+                    else {
+                        TRACE_L1(_T("SEC :Key instance failed retVal = %d \n"), res);
+                    }
+                }
+            }
+            delete secalg;
+        }
+        else if (Implementation::vaultId == CRYPTOGRAPHY_VAULT_NETFLIX) {
+            const Implementation::VaultNetflix* vaultImplNetflix = reinterpret_cast<const Implementation::VaultNetflix*>(vault);
+            Sec_SocKeyHandle* key = NULL;
+
+            if ((vaultImplNetflix->FindKey(secret_id, &key) != 0) || (vaultImplNetflix->getNetflixHandle() == nullptr)) {
+                TRACE_L1(_T("SEC: hmac for netflix can not be calculated\n"));
+            }
+            else {
+                uint32_t written = 0;
+                while ((result < count) && (written < max_length)) {
+                    uint32_t bytesWritten = 0;
+                    Sec_Result res = SecNetflix_Hmac(vaultImplNetflix->getNetflixHandle(), key,
+                        const_cast<uint8_t*>(data + offset), lengths[result], (output + written), (max_length - written), &bytesWritten);
+                    if (res != SEC_RESULT_SUCCESS) {
+                        TRACE_L1(_T("SEC :Hmac calculation by Secnetflix_Hmac failed ,retVal =%d \n"), res);
+                        break;
+                    }
+                    offset += lengths[result];
+                    written += bytesWritten;
+                    result++;
+                }
+            }
+        }
+
+        return (result);
+    }
+
 } // extern "C"
 
@@ -30,6 +30,8 @@
 struct HashImplementation {
     virtual uint32_t Ingest(const uint32_t length, const uint8_t data[]) = 0;
     virtual uint8_t Calculate(const uint8_t maxLength, uint8_t data[]) = 0;
+    virtual uint32_t Reset() = 0;
+    virtual HashImplementation* Copy() const = 0;
 
     virtual ~HashImplementation() { }
 };
@@ -62,6 +64,8 @@ namespace Implementation {
         const Implementation::Vault* _vault_digest = nullptr;
         uint16_t _size;
         bool _failure;
+        bool _running = false;
+        HashAlg _algorithm = { SEC_DIGESTALGORITHM_NUM, SEC_MACALGORITHM_NUM, 0 };
         Handle* handle = new Handle;
         Sec_KeyHandle* sec_key = nullptr;
         SEC_OBJECTID _id_sec;
@@ -69,6 +73,8 @@ namespace Implementation {
     public:
         uint32_t Ingest(const uint32_t length, const uint8_t* data) override;
         uint8_t Calculate(const uint8_t maxLength, uint8_t* data) override;
+        uint32_t Reset() override;
+        HashImplementation* Copy() const override;
 
     };
 
@@ -84,6 +90,8 @@ namespace Implementation {
         HashTypeNetflix(const Implementation::VaultNetflix* vault, const uint32_t secretId);
         uint32_t Ingest(const uint32_t length, const uint8_t* data) override;
         uint8_t Calculate(const uint8_t maxLength, uint8_t* data) override;
+        uint32_t Reset() override;
+        HashImplementation* Copy() const override;
     };
 
 } // namespace Implementation
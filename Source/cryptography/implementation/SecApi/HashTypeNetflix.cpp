@@ -99,3 +99,36 @@ uint8_t Implementation::HashTypeNetflix::Calculate(const uint8_t maxLength, uint
     return (result);
 }
 
+/*********************************************************************
+ * @function Reset
+ *
+ * @brief    Drop the ingested data so a new hmac can be calculated with the same key
+ *
+ * @return Core::ERROR_NONE on success
+ *
+ *********************************************************************/
+uint32_t Implementation::HashTypeNetflix::Reset()
+{
+    _buffer.clear();
+    return (_failure ? WPEFramework::Core::ERROR_UNAVAILABLE : WPEFramework::Core::ERROR_NONE);
+}
+
+/*********************************************************************
+ * @function Copy
+ *
+ * @brief    Fork the hmac calculation including the data ingested so far
+ *
+ * @return new hash implementation, nullptr on failure
+ *
+ *********************************************************************/
+HashImplementation* Implementation::HashTypeNetflix::Copy() const
+{
+    HashImplementation* copy = nullptr;
+    if (true == _failure) {
+        TRACE_L1(_T("SEC : Can not copy a failed hmac calculation"));
+    }
+    else {
+        copy = new Implementation::HashTypeNetflix(*this);
+    }
+    return (copy);
+}
@@ -40,6 +40,13 @@ namespace Implementation {
         _lastHandle = 0x80000000;
     }
 
+    /* Shared default vault, also lends its processor to the digest calculations */
+    Vault& Vault::DefaultInstance()
+    {
+        static Vault instance;
+        return (instance);
+    }
+
     /* Destructor */
     Vault::~Vault()
     {
@@ -568,8 +575,7 @@ extern "C" {
             break;
         case CRYPTOGRAPHY_VAULT_DEFAULT:
            {
-                static Implementation::Vault instance;
-                vault = &(instance);
+                vault = &Implementation::Vault::DefaultInstance();
 
             if (vault != nullptr)
                 TRACE_L2(_T("SEC :VAULT DEFAULT CASE \n"));
@@ -682,6 +688,15 @@ extern "C" {
         }
     }
 
+    bool vault_statistics(const VaultImplementation* vault, vault_stats* stats)
+    {
+        ASSERT(vault != nullptr);
+        ASSERT(stats != nullptr);
+        //NOT IMPLEMENTED, the keys live in the SEC API
+        TRACE_L1(_T("SEC:vault_statistics not supported\n"));
+        return (false);
+    }
+
     uint32_t persistent_key_create( struct VaultImplementation* vault,const char locator[],const key_type keyType,uint32_t* id)
     {
         ASSERT(vault != nullptr);
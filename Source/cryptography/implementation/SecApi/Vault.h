@@ -60,6 +60,7 @@ namespace Implementation {
     class Vault {
     public:
         static Vault& NetflixInstance();
+        static Vault& DefaultInstance();
         Vault();
         ~Vault();
 
@@ -19,23 +19,27 @@
 
 #include "../../Module.h"
 
-#include <ICryptographic.h>
 #include <cipher_implementation.h>
 
 #include <core/core.h>
 #include <cryptalgo/cryptalgo.h>
 
+#include "../AESAccelerated.h"
+#include "../Parallel.h"
 #include "Vault.h"
 
 
-struct CryptImplementation {
+struct CipherImplementation {
 
-    virtual ~CryptImplementation() = default;
+    virtual ~CipherImplementation() = default;
 
-    virtual int32_t Operation(const uint8_t ivLength, const uint8_t iv[],
-                               const uint32_t inputLength, const uint8_t input[],
-                               const uint32_t maxOutputLength, uint8_t output[]) = 0;
+    virtual int32_t Encrypt(const uint8_t ivLength, const uint8_t iv[],
+                            const uint32_t inputLength, const uint8_t input[],
+                            const uint32_t maxOutputLength, uint8_t output[]) const = 0;
 
+    virtual int32_t Decrypt(const uint8_t ivLength, const uint8_t iv[],
+                            const uint32_t inputLength, const uint8_t input[],
+                            const uint32_t maxOutputLength, uint8_t output[]) const = 0;
 };
 
 
@@ -46,6 +50,7 @@ namespace Operation {
     // Wrappers to get around different method names for encryption/decryption.
 
     struct Encrypt {
+        static constexpr bool encrypt = true;
         typedef WPEFramework::Crypto::AESEncryption Implementation;
         static int32_t Operation(Implementation& impl, const uint32_t length, const uint8_t input[], uint8_t output[]) {
             return (impl.Encrypt(length, input, output));
@@ -53,6 +58,7 @@ namespace Operation {
     };
 
     struct Decrypt {
+        static constexpr bool encrypt = false;
         typedef WPEFramework::Crypto::AESDecryption Implementation;
         static int32_t Operation(Implementation& impl, const uint32_t length, const uint8_t input[], uint8_t output[]) {
             return (impl.Decrypt(length, input, output));
@@ -62,29 +68,45 @@ namespace Operation {
 } // namespace Operation
 
 
-template<typename OPERATION>
-class AESCryptor : public CryptImplementation {
-    const uint8_t IV_LENGTH = 16;
+class AESCipher : public CipherImplementation {
+    static constexpr uint8_t IV_LENGTH = 16;
 
 public:
-    AESCryptor(const AESCryptor<OPERATION>&) = delete;
-    AESCryptor& operator=(const AESCryptor<OPERATION>) = delete;
-    AESCryptor() = delete;
+    AESCipher(const AESCipher&) = delete;
+    AESCipher& operator=(const AESCipher&) = delete;
+    AESCipher() = delete;
 
-    AESCryptor(WPEFramework::Crypto::aesType blockMode, const uint32_t keyId)
-        : _cryptor(blockMode)
+    AESCipher(const aes_mode mode, WPEFramework::Crypto::aesType blockMode, const uint32_t keyId)
+        : _mode(mode)
+        , _blockMode(blockMode)
         , _keyId(keyId)
     {
     }
 
-    ~AESCryptor() override = default;
+    ~AESCipher() override = default;
 
 public:
-    uint32_t Operation(const uint8_t ivLength, const uint8_t iv[],
-                       const uint32_t inputLength, const uint8_t input[],
-                       const uint32_t maxOutputLength, uint8_t output[]) override
+    int32_t Encrypt(const uint8_t ivLength, const uint8_t iv[],
+                    const uint32_t inputLength, const uint8_t input[],
+                    const uint32_t maxOutputLength, uint8_t output[]) const override
     {
-        uint32_t result = 0;
+        return (Process<Operation::Encrypt>(ivLength, iv, inputLength, input, maxOutputLength, output));
+    }
+
+    int32_t Decrypt(const uint8_t ivLength, const uint8_t iv[],
+                    const uint32_t inputLength, const uint8_t input[],
+                    const uint32_t maxOutputLength, uint8_t output[]) const override
+    {
+        return (Process<Operation::Decrypt>(ivLength, iv, inputLength, input, maxOutputLength, output));
+    }
+
+private:
+    template<typename OPERATION>
+    int32_t Process(const uint8_t ivLength, const uint8_t iv[],
+                    const uint32_t inputLength, const uint8_t input[],
+                    const uint32_t maxOutputLength, uint8_t output[]) const
+    {
+        int32_t result = 0;
 
         ASSERT(iv != nullptr);
         ASSERT(input != nullptr);
@@ -99,8 +121,6 @@ public:
             TRACE_L1(_T("Output buffer too small, need  %i bytes"), inputLength);
             result = (-inputLength) + (16 - (inputLength % 16));
         } else {
-            _cryptor.InitialVector(iv);
-
             uint8_t* key = reinterpret_cast<uint8_t*>(ALLOCA(keySize));
             ASSERT(key != nullptr);
 
@@ -108,15 +128,29 @@ public:
             ASSERT(keySize != 0);
 
             if (keySize != 0) {
-                _cryptor.Key(keySize, key);
-                ::memset(key, 0xFF, keySize); // shred :)
+                if (Accelerated<OPERATION>(keySize, key, iv, inputLength, input, output) == true) {
+                    ::memset(key, 0xFF, keySize); // shred :)
 
-                result = OPERATION::Operation(_cryptor, inputLength, input, output);
-                if (result != 0) {
-                    TRACE_L1(_T("Operation() failed: %i"), result);
-                } else {
-                    TRACE_L2(_T("Succesfuly AES en/de-crypted %i bytes to %i bytes"), inputLength, inputLength);
+                    TRACE_L2(_T("Succesfuly AES en/de-crypted %i bytes to %i bytes (accelerated)"), inputLength, inputLength);
                     result = inputLength;
+                } else if (_mode == AES_MODE_CTR) {
+                    result = Counter(keySize, key, iv, inputLength, input, output);
+                    ::memset(key, 0xFF, keySize); // shred :)
+                } else {
+                    typename OPERATION::Implementation cryptor(_blockMode);
+
+                    cryptor.InitialVector(iv);
+                    cryptor.Key(keySize, key);
+                    ::memset(key, 0xFF, keySize); // shred :)
+
+                    result = OPERATION::Operation(cryptor, inputLength, input, output);
+                    if (result != 0) {
+                        TRACE_L1(_T("Operation() failed: %i"), result);
+                        result = 0;
+                    } else {
+                        TRACE_L2(_T("Succesfuly AES en/de-crypted %i bytes to %i bytes"), inputLength, inputLength);
+                        result = inputLength;
+                    }
                 }
             }
         }
@@ -124,112 +158,199 @@ public:
         return (result);
     }
 
-private:
-    typename OPERATION::Implementation _cryptor;
-    uint32_t _keyId;
-};
+    // ECB, CBC and CTR go to the AES instructions if the CPU has them, anything else (or ECB/CBC
+    // on partial blocks) is left to the Thunder implementation. Large ECB and CTR inputs are split
+    // over the worker pool.
+    template<typename OPERATION>
+    bool Accelerated(const uint16_t keySize, const uint8_t key[], const uint8_t iv[],
+                     const uint32_t inputLength, const uint8_t input[], uint8_t output[]) const
+    {
+        bool result = false;
+
+        if ((AESAccelerated::Available() == true)
+            && ((_mode == AES_MODE_CTR) || (((_mode == AES_MODE_ECB) || (_mode == AES_MODE_CBC)) && ((inputLength % 16) == 0)))) {
+
+            AESAccelerated::Key prepared;
+
+            if (AESAccelerated::Prepare(keySize, key, prepared) == true) {
+                uint8_t chain[16];
+                ::memcpy(chain, iv, sizeof(chain));
+
+                const uint16_t chunks = (_mode == AES_MODE_CBC ? 1 : Parallel::Instance().Chunks(inputLength));
+
+                if (chunks > 1) {
+                    // No chaining between the blocks in ECB and CTR, so the chunks are done on the worker pool.
+                    Parallel::Instance().Run(chunks, [&](const uint16_t chunk) {
+                        const uint32_t begin = Parallel::Offset(inputLength, chunks, chunk);
+                        const uint32_t length = (Parallel::Offset(inputLength, chunks, chunk + 1) - begin);
+
+                        if (_mode == AES_MODE_ECB) {
+                            AESAccelerated::ECB(prepared, OPERATION::encrypt, length, (input + begin), (output + begin));
+                        } else {
+                            uint8_t counter[16];
+                            ::memcpy(counter, iv, sizeof(counter));
+                            Parallel::Advance(counter, (begin / Parallel::BlockSize));
+
+                            AESAccelerated::CTR(prepared, counter, length, (input + begin), (output + begin));
+                        }
+                    });
+                } else if (_mode == AES_MODE_ECB) {
+                    AESAccelerated::ECB(prepared, OPERATION::encrypt, inputLength, input, output);
+                } else if (_mode == AES_MODE_CBC) {
+                    AESAccelerated::CBC(prepared, OPERATION::encrypt, chain, inputLength, input, output);
+                } else {
+                    AESAccelerated::CTR(prepared, chain, inputLength, input, output);
+                }
 
-template<typename OPERATION>
-CryptImplementation* CreateCryptor(const cipher_algorithm algorithm, const cipher_mode mode, const uint32_t keyId)
-{
-    CryptImplementation* crypt = nullptr;
-
-    auto AESBlockMode = [](const cipher_mode mode, WPEFramework::Crypto::aesType aesType) -> bool {
-        bool converted = false;
-        switch (mode) {
-        case cipher_mode::CIPHER_MODE_ECB:
-            aesType = WPEFramework::Crypto::aesType::AES_ECB;
-            converted = true;
-            break;
-        case cipher_mode::CIPHER_MODE_CBC:
-            aesType = WPEFramework::Crypto::aesType::AES_CBC;
-            converted = true;
-            break;
-        case cipher_mode::CIPHER_MODE_OFB:
-            aesType = WPEFramework::Crypto::aesType::AES_CBC;
-            converted = true;
-            break;
-        case cipher_mode::CIPHER_MODE_CFB8:
-            aesType = WPEFramework::Crypto::aesType::AES_CFB8;
-            converted = true;
-            break;
-        case cipher_mode::CIPHER_MODE_CFB128:
-            aesType = WPEFramework::Crypto::aesType::AES_CFB128;
-            converted = true;
-            break;
-        default:
-            TRACE_L1(_T("Cipher block mode %i not supported"), mode);
-            break;
+                ::memset(&prepared, 0xFF, sizeof(prepared)); // shred :)
+                result = true;
+            }
         }
-        return (converted);
-    };
 
-    switch (algorithm) {
-    case cipher_algorithm::CIPHER_ALGORITHM_AES: {
-        WPEFramework::Crypto::aesType aesType = WPEFramework::Crypto::aesType::AES_ECB;
-        if (AESBlockMode(mode, aesType) == true) {
-            crypt = new AESCryptor<OPERATION>(aesType, keyId);
-        }
-        break;
+        return (result);
     }
-    default:
-        TRACE_L1(_T("Cipher algorithm %i not supported"), algorithm);
-        break;
+
+    // CTR without the AES instructions, the key stream is the ECB encryption of the counter blocks.
+    int32_t Counter(const uint16_t keySize, const uint8_t key[], const uint8_t iv[],
+                    const uint32_t inputLength, const uint8_t input[], uint8_t output[]) const
+    {
+        int32_t result = 0;
+
+        WPEFramework::Crypto::AESEncryption ecb(WPEFramework::Crypto::aesType::AES_ECB);
+        uint8_t counter[16];
+        uint8_t stream[16];
+
+        ecb.Key(keySize, key);
+        ::memcpy(counter, iv, sizeof(counter));
+
+        uint32_t offset = 0;
+        while ((offset < inputLength) && (ecb.Encrypt(sizeof(counter), counter, stream) == 0)) {
+            const uint32_t chunk = std::min(static_cast<uint32_t>(sizeof(stream)), (inputLength - offset));
+
+            for (uint32_t index = 0; index < chunk; index++) {
+                output[offset + index] = (input[offset + index] ^ stream[index]);
+            }
+
+            // Big endian increment of the whole counter block
+            uint8_t position = sizeof(counter);
+            while ((position > 0) && (++counter[--position] == 0)) {
+            }
+
+            offset += chunk;
+        }
+
+        ::memset(stream, 0xFF, sizeof(stream)); // shred :)
+
+        if (offset != inputLength) {
+            TRACE_L1(_T("CTR key stream generation failed"));
+        } else {
+            result = inputLength;
+        }
+
+        return (result);
     }
 
-    return (crypt);
-}
+private:
+    aes_mode _mode;
+    WPEFramework::Crypto::aesType _blockMode;
+    uint32_t _keyId;
+};
 
 } // namespace Implementation
 
 
 extern "C" {
 
-uint32_t cipher_generate(const cipher_algorithm algorithm, const uint16_t length_bits, uint32_t* private_key_id, uint32_t* public_key_id)
+struct CipherImplementation* cipher_create_aes(const struct VaultImplementation* vault, const aes_mode mode, const uint32_t key_id)
 {
-    TRACE_L1(_T("cipher_generate() not implemented"));
+    // The Thunder backend keeps all keys in its one vault
+    ASSERT(vault != nullptr);
 
-    return (-1);
+    CipherImplementation* cipher = nullptr;
+    WPEFramework::Crypto::aesType aesType = WPEFramework::Crypto::aesType::AES_ECB;
+    bool converted = true;
+
+    switch (mode) {
+    case AES_MODE_ECB:
+        aesType = WPEFramework::Crypto::aesType::AES_ECB;
+        break;
+    case AES_MODE_CBC:
+        aesType = WPEFramework::Crypto::aesType::AES_CBC;
+        break;
+    case AES_MODE_OFB:
+        aesType = WPEFramework::Crypto::aesType::AES_CBC;
+        break;
+    case AES_MODE_CFB8:
+        aesType = WPEFramework::Crypto::aesType::AES_CFB8;
+        break;
+    case AES_MODE_CFB128:
+        aesType = WPEFramework::Crypto::aesType::AES_CFB128;
+        break;
+    case AES_MODE_CTR:
+        // Built on ECB, see AESCipher::Counter()
+        aesType = WPEFramework::Crypto::aesType::AES_ECB;
+        break;
+    default:
+        TRACE_L1(_T("AES block mode %i not supported"), mode);
+        converted = false;
+        break;
+    }
+
+    if (converted == true) {
+        cipher = new Implementation::AESCipher(mode, aesType, key_id);
+    }
+
+    return (cipher);
 }
 
-uint32_t cipher_dh_derive(const uint32_t private_key_id, const uint32_t peer_public_key_id, uint32_t* secret_id)
+struct CipherImplementation* cipher_create_aead(const struct VaultImplementation* vault, const aead_mode mode, const uint32_t key_id)
 {
-    TRACE_L1(_T("cipher_dh_derive() not implemented"));
+    TRACE_L1(_T("Authenticated encryption not supported"));
 
-    return (-1);
+    return (nullptr);
 }
 
-uint32_t cipher_dh_authenticated_derive(const uint32_t private_key_id, const uint32_t peer_public_key_id, const uint32_t derivation_key_id,
-                                        uint32_t* encryption_key_id, uint32_t* hmac_key_id, uint32_t* wrapping_key_id)
+void cipher_destroy(struct CipherImplementation* cipher)
 {
-    TRACE_L1(_T("cipher_dh_authenticated_derive() not implemented"));
+    ASSERT(cipher != nullptr);
 
-    return (-1);
+    delete cipher;
 }
 
-struct CryptImplementation* cipher_create_encryptor(const cipher_algorithm algorithm, const cipher_mode mode, const uint32_t key_id)
+int32_t cipher_encrypt(const struct CipherImplementation* cipher, const uint8_t iv_length, const uint8_t iv[],
+                       const uint32_t input_length, const uint8_t input[], const uint32_t max_output_length, uint8_t output[])
 {
-    return (Implementation::CreateCryptor<Implementation::Operation::Encrypt>(algorithm, mode, key_id));
+    ASSERT(cipher != nullptr);
+
+    return (cipher->Encrypt(iv_length, iv, input_length, input, max_output_length, output));
 }
 
-struct CryptImplementation* cipher_create_decryptor(const cipher_algorithm algorithm, const cipher_mode mode, const uint32_t key_id)
+int32_t cipher_decrypt(const struct CipherImplementation* cipher, const uint8_t iv_length, const uint8_t iv[],
+                       const uint32_t input_length, const uint8_t input[], const uint32_t max_output_length, uint8_t output[])
 {
-    return (Implementation::CreateCryptor<Implementation::Operation::Decrypt>(algorithm, mode, key_id));
+    ASSERT(cipher != nullptr);
+
+    return (cipher->Decrypt(iv_length, iv, input_length, input, max_output_length, output));
 }
 
-void cipher_destroy(struct CryptImplementation* crypt)
+int32_t cipher_aead_encrypt(const struct CipherImplementation* cipher, const uint8_t iv_length, const uint8_t iv[],
+                            const uint16_t aad_length, const uint8_t aad[],
+                            const uint32_t input_length, const uint8_t input[], const uint32_t max_output_length, uint8_t output[],
+                            const uint8_t tag_length, uint8_t tag[])
 {
-    ASSERT(crypt != nullptr);
+    TRACE_L1(_T("Authenticated encryption not supported"));
 
-    delete crypt;
+    return (0);
 }
 
-uint32_t cipher_operation(struct CryptImplementation* crypt, const uint8_t iv_length, const uint8_t iv[],
-                          const uint32_t input_length, const uint8_t input[], const uint32_t max_output_length, uint8_t output[])
+int32_t cipher_aead_decrypt(const struct CipherImplementation* cipher, const uint8_t iv_length, const uint8_t iv[],
+                            const uint16_t aad_length, const uint8_t aad[],
+                            const uint32_t input_length, const uint8_t input[], const uint32_t max_output_length, uint8_t output[],
+                            const uint8_t tag_length, const uint8_t tag[])
 {
-    ASSERT(crypt != nullptr);
+    TRACE_L1(_T("Authenticated encryption not supported"));
 
-    return (crypt->Operation(iv_length, iv, input_length, input, max_output_length, output));
+    return (0);
 }
 
 } // extern "C"
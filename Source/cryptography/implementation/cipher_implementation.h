@@ -36,6 +36,11 @@ typedef enum {
     AES_MODE_CTR,
 } aes_mode;
 
+typedef enum {
+    AEAD_MODE_AES_GCM,
+    AEAD_MODE_CHACHA20_POLY1305
+} aead_mode;
+
 struct CipherImplementation;
 
 
@@ -50,6 +55,23 @@ int32_t cipher_encrypt(const struct CipherImplementation* cipher, const uint8_t
 int32_t cipher_decrypt(const struct CipherImplementation* cipher, const uint8_t iv_length, const uint8_t iv[],
                         const uint32_t input_length, const uint8_t input[], const uint32_t max_output_length, uint8_t output[]);
 
+
+/* Authenticated encryption, a single pass producing both the ciphertext and the tag (destroyed with cipher_destroy).
+   The IV is 12 bytes, the tag 12 to 16 bytes; the additional data is authenticated but not encrypted.
+   The input can not be empty: 0 is returned for it, as for any failure, so an AAD-only tag is not supported. */
+struct CipherImplementation* cipher_create_aead(const struct VaultImplementation* vault, const aead_mode mode, const uint32_t key_id);
+
+int32_t cipher_aead_encrypt(const struct CipherImplementation* cipher, const uint8_t iv_length, const uint8_t iv[],
+                            const uint16_t aad_length, const uint8_t aad[],
+                            const uint32_t input_length, const uint8_t input[], const uint32_t max_output_length, uint8_t output[],
+                            const uint8_t tag_length, uint8_t tag[]);
+
+/* Returns 0 and wipes the output if the tag does not match */
+int32_t cipher_aead_decrypt(const struct CipherImplementation* cipher, const uint8_t iv_length, const uint8_t iv[],
+                            const uint16_t aad_length, const uint8_t aad[],
+                            const uint32_t input_length, const uint8_t input[], const uint32_t max_output_length, uint8_t output[],
+                            const uint8_t tag_length, const uint8_t tag[]);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
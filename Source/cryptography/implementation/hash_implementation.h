@@ -48,6 +48,25 @@ uint32_t hash_ingest(struct HashImplementation* signing, const uint32_t length,
 
 uint8_t hash_calculate(struct HashImplementation* signing, const uint8_t max_length, uint8_t data[]);
 
+/* Restart the calculation, keeping the algorithm and key (if any) */
+uint32_t hash_reset(struct HashImplementation* signing);
+
+/* Fork the running calculation, e.g. to finish several messages sharing a common prefix */
+struct HashImplementation* hash_copy(const struct HashImplementation* signing);
+
+
+/* Single buffer digest, no calculator object involved (returns size of the digest) */
+uint8_t hash_digest(const hash_type type, const uint32_t length, const uint8_t data[], const uint8_t max_length, uint8_t output[]);
+
+/* Single buffer HMAC with a key from the vault, no calculator object involved (returns size of the HMAC) */
+uint8_t hash_hmac(const struct VaultImplementation* vault, const hash_type type, const uint32_t secret_id,
+    const uint32_t length, const uint8_t data[], const uint8_t max_length, uint8_t output[]);
+
+/* HMACs of a series of messages with the same key, data holds the messages back to back and lengths their sizes,
+   the HMACs are stored back to back in output (returns the number of HMACs calculated) */
+uint16_t hash_hmac_batch(const struct VaultImplementation* vault, const hash_type type, const uint32_t secret_id,
+    const uint16_t count, const uint32_t lengths[], const uint8_t data[], const uint32_t max_length, uint8_t output[]);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
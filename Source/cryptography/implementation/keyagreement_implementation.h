@@ -0,0 +1,44 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "vault_implementation.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    KEY_AGREEMENT_CURVE_X25519,
+    KEY_AGREEMENT_CURVE_P256
+} key_agreement_curve;
+
+// Public keys are exportable: 32 raw bytes for X25519, an uncompressed point (65 bytes) for P-256.
+uint32_t keyagreement_generate(struct VaultImplementation* vault, const key_agreement_curve curve,
+                               uint32_t* private_key_id, uint32_t* public_key_id);
+
+// The curve follows from the private key, the peer public key is a blob imported in the same format.
+uint32_t keyagreement_derive(struct VaultImplementation* vault,
+                             const uint32_t private_key_id, const uint32_t peer_public_key_id, uint32_t* secret_id);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
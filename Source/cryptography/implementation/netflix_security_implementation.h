@@ -41,7 +41,10 @@ uint32_t netflix_security_wrapping_key(void);
         3) encryptionKey = vector[0..15]                                 ; AES-128
         4) hmacKey = vector[16..47]                                      ; HMAC-256
         5) wrappingKey = HMAC-256(809f82a7addf548d3ea9dd067ff9bb91,
-                                  HMAC-256(vector, 027617984f6227539a630b897c017d69))[0..15]  ; AES-128 */
+                                  HMAC-256(vector, 027617984f6227539a630b897c017d69))[0..15]  ; AES-128
+   With the derived key cache enabled (CRYPTOGRAPHY_DERIVED_KEY_CACHE), a call with the same three source keys
+   returns the very same key ids as the call before, so the derived keys are shared between the callers. Deleting
+   any of them (or of the source keys) ends the sharing, the next call derives new keys. */
 uint32_t netflix_security_derive_keys(const uint32_t private_dh_key_id, const uint32_t peer_public_dh_key_id, const uint32_t derivation_key_id,
                                       uint32_t* encryption_key_id, uint32_t* hmac_key_id, uint32_t* wrapping_key_id);
 
@@ -30,6 +30,14 @@ extern "C" {
 
 struct VaultImplementation;
 
+typedef struct {
+    uint32_t items;      /* blobs held */
+    uint64_t bytes;      /* memory taken by the blobs, bookkeeping included; unused slab pages are given back */
+    uint64_t peak_bytes; /* highest bytes so far */
+    uint64_t quota;      /* bytes allowed, 0 if unlimited */
+    uint32_t rejected;   /* blobs refused because of the quota */
+} vault_stats;
+
 struct VaultImplementation* vault_instance(const enum cryptographyvault id);
 
 uint16_t vault_size(const struct VaultImplementation* vault, const uint32_t id);
@@ -44,6 +52,8 @@ uint16_t vault_get(const struct VaultImplementation* vault, const uint32_t id, c
 
 bool vault_delete(struct VaultImplementation* vault, const uint32_t id);
 
+bool vault_statistics(const struct VaultImplementation* vault, vault_stats* stats);
+
 
 #ifdef __cplusplus
 } // extern "C"
@@ -0,0 +1,488 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Module.h"
+
+#include <cryptography.h>
+#include <core/core.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Throughput of the cryptography interfaces, in-process and (if a connector is given) through COM-RPC.
+// Every operation runs for a fixed time per message size and thread count, the results go out as JSON.
+
+using namespace WPEFramework;
+
+namespace {
+
+    static const uint8_t dhGenerator = 5;
+
+    static const uint8_t dhModulus[] = {
+        0x96, 0x94, 0xe9, 0xd8, 0xd9, 0x3a, 0x5a, 0xc7, 0x4c, 0x50, 0x9b, 0x4b, 0xbc, 0xe8, 0x5e, 0x92,
+        0x13, 0x2c, 0xd1, 0x9c, 0xce, 0x47, 0x7d, 0x1a, 0x7e, 0x47, 0xd5, 0x27, 0xd9, 0xec, 0x29, 0x15,
+        0x15, 0xf0, 0xb8, 0xb3, 0xe1, 0xea, 0xed, 0x50, 0x06, 0xe1, 0xb1, 0xb9, 0x1e, 0xa2, 0x5b, 0x91,
+        0xa0, 0x1b, 0x10, 0xe2, 0xe8, 0x34, 0xb8, 0xd6, 0x60, 0xb2, 0xe3, 0x21, 0xad, 0x64, 0x4c, 0xe1,
+        0xa8, 0x3b, 0x32, 0x8d, 0x90, 0x14, 0xee, 0x7e, 0x16, 0xf1, 0xe4, 0x4f, 0xfe, 0x89, 0x57, 0x9a,
+        0xc3, 0xee, 0x47, 0xd6, 0x68, 0xb6, 0xb7, 0x66, 0x87, 0xc2, 0xfe, 0x90, 0xa3, 0x5b, 0x5e, 0x60,
+        0x28, 0xfd, 0x04, 0xef, 0xea, 0x88, 0x23, 0x73, 0xec, 0xf6, 0x0b, 0xa2, 0xf6, 0x37, 0xe4, 0xcd,
+        0xaa, 0x1b, 0x60, 0x89, 0xd6, 0xc0, 0xb5, 0x61, 0xa8, 0xe5, 0x20, 0xe7, 0x96, 0xde, 0x27, 0xdf
+    };
+
+    struct Settings {
+        Settings()
+            : connector()
+            , output()
+            , duration(1000)
+            , vault(CRYPTOGRAPHY_VAULT_PLATFORM)
+            , sizes({ 16, 256, 1024, 16384 })
+            , threads({ 1, 2, 4 })
+        {
+        }
+
+        string connector;
+        string output;
+        uint32_t duration;
+        cryptographyvault vault;
+        std::vector<uint32_t> sizes;
+        std::vector<uint32_t> threads;
+    };
+
+    struct Result {
+        string path;
+        string operation;
+        uint32_t size;
+        uint32_t threads;
+        uint64_t operations;
+        double seconds;
+        bool failed;
+    };
+
+    // An operation runs until it fails (returns false), each thread gets its own instance.
+    using Operation = std::function<bool()>;
+
+    // Creates the operation for a message size, an empty operation if the case is not supported.
+    using Factory = std::function<Operation(const uint32_t size)>;
+
+    struct Case {
+        string name;
+        bool sized;
+        Factory factory;
+    };
+
+    template <typename INTERFACE>
+    std::shared_ptr<INTERFACE> Hold(INTERFACE* iface)
+    {
+        return (std::shared_ptr<INTERFACE>(iface, [](INTERFACE* object) { if (object != nullptr) { object->Release(); } }));
+    }
+
+    std::shared_ptr<std::vector<uint8_t>> Buffer(const uint32_t size)
+    {
+        std::shared_ptr<std::vector<uint8_t>> buffer = std::make_shared<std::vector<uint8_t>>(size);
+
+        for (uint32_t index = 0; index < size; index++) {
+            (*buffer)[index] = static_cast<uint8_t>(index * 7);
+        }
+
+        return (buffer);
+    }
+
+    Result Measure(const string& path, const Case& entry, const uint32_t size, const uint32_t threads, const uint32_t duration)
+    {
+        Result result{ path, entry.name, (entry.sized == true ? size : 0), threads, 0, 0, false };
+
+        std::vector<Operation> operations;
+
+        // Set up outside of the timed section
+        for (uint32_t index = 0; index < threads; index++) {
+            Operation operation = entry.factory(size);
+
+            if (operation == nullptr) {
+                result.failed = true;
+                break;
+            }
+
+            operations.push_back(std::move(operation));
+        }
+
+        if (result.failed == false) {
+            std::atomic<bool> running(true);
+            std::atomic<bool> failed(false);
+            std::atomic<uint64_t> count(0);
+            std::vector<std::thread> workers;
+
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            for (Operation& operation : operations) {
+                workers.emplace_back([&running, &failed, &count, &operation]() {
+                    uint64_t local = 0;
+
+                    while (running.load(std::memory_order_relaxed) == true) {
+                        if (operation() == false) {
+                            failed = true;
+                            break;
+                        }
+                        local++;
+                    }
+
+                    count += local;
+                });
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(duration));
+            running = false;
+
+            for (std::thread& worker : workers) {
+                worker.join();
+            }
+
+            result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            result.operations = count;
+            result.failed = failed;
+        }
+
+        return (result);
+    }
+
+    std::vector<Case> Cases(const std::shared_ptr<Cryptography::ICryptography>& cg, const std::shared_ptr<Cryptography::IVault>& vault)
+    {
+        std::vector<Case> cases;
+
+        const std::shared_ptr<std::vector<uint8_t>> key128 = Buffer(16);
+        const std::shared_ptr<std::vector<uint8_t>> key256 = Buffer(32);
+
+        // Keys shared by all threads, deleted with the last case that uses them
+        auto ImportKey = [vault](const std::shared_ptr<std::vector<uint8_t>>& key) -> std::shared_ptr<uint32_t> {
+            return (std::shared_ptr<uint32_t>(new uint32_t(vault->Import(key->size(), key->data())),
+                [vault](uint32_t* id) { vault->Delete(*id); delete id; }));
+        };
+
+        const std::shared_ptr<uint32_t> aesKey = ImportKey(key128);
+        const std::shared_ptr<uint32_t> wideKey = ImportKey(key256);
+
+        cases.push_back({ "digest-sha256", true, [cg](const uint32_t size) -> Operation {
+            std::shared_ptr<std::vector<uint8_t>> data = Buffer(size);
+            return ([cg, data]() {
+                uint8_t hash[32];
+                return (cg->Digest(Cryptography::hashtype::SHA256, data->size(), data->data(), sizeof(hash), hash) == sizeof(hash));
+            });
+        } });
+
+        cases.push_back({ "hash-sha256", true, [cg](const uint32_t size) -> Operation {
+            std::shared_ptr<Cryptography::IHash> hash = Hold(cg->Hash(Cryptography::hashtype::SHA256));
+            std::shared_ptr<std::vector<uint8_t>> data = Buffer(size);
+            return (hash == nullptr ? Operation() : [hash, data]() {
+                uint8_t output[32];
+                return ((hash->Ingest(data->size(), data->data()) == data->size())
+                    && (hash->Calculate(sizeof(output), output) == sizeof(output))
+                    && (hash->Reset() == Core::ERROR_NONE));
+            });
+        } });
+
+        cases.push_back({ "hmac-sha256", true, [vault, wideKey](const uint32_t size) -> Operation {
+            std::shared_ptr<std::vector<uint8_t>> data = Buffer(size);
+            return ([vault, wideKey, data]() {
+                uint8_t hmac[32];
+                return (vault->Sign(Cryptography::hashtype::SHA256, *wideKey, data->size(), data->data(), sizeof(hmac), hmac) == sizeof(hmac));
+            });
+        } });
+
+        const struct {
+            const char* name;
+            Cryptography::aesmode mode;
+        } aesModes[] = {
+            { "aes128-ecb", Cryptography::aesmode::ECB },
+            { "aes128-cbc", Cryptography::aesmode::CBC },
+            { "aes128-ofb", Cryptography::aesmode::OFB },
+            { "aes128-cfb128", Cryptography::aesmode::CFB128 },
+            { "aes128-ctr", Cryptography::aesmode::CTR }
+        };
+
+        for (auto& aes : aesModes) {
+            const Cryptography::aesmode mode = aes.mode;
+            cases.push_back({ aes.name, true, [vault, aesKey, mode](const uint32_t size) -> Operation {
+                std::shared_ptr<Cryptography::ICipher> cipher = Hold(vault->AES(mode, *aesKey));
+                std::shared_ptr<std::vector<uint8_t>> data = Buffer(size);
+                std::shared_ptr<std::vector<uint8_t>> output = std::make_shared<std::vector<uint8_t>>(size + 16);
+                return (cipher == nullptr ? Operation() : [cipher, data, output]() {
+                    const uint8_t iv[16] = {};
+                    return (cipher->Encrypt(sizeof(iv), iv, data->size(), data->data(), output->size(), output->data()) > 0);
+                });
+            } });
+        }
+
+        const struct {
+            const char* name;
+            Cryptography::aeadmode mode;
+        } aeadModes[] = {
+            { "aes256-gcm", Cryptography::aeadmode::AES_GCM },
+            { "chacha20-poly1305", Cryptography::aeadmode::CHACHA20_POLY1305 }
+        };
+
+        for (auto& aead : aeadModes) {
+            const Cryptography::aeadmode mode = aead.mode;
+            cases.push_back({ aead.name, true, [vault, wideKey, mode](const uint32_t size) -> Operation {
+                std::shared_ptr<Cryptography::IAuthenticatedCipher> cipher = Hold(vault->AEAD(mode, *wideKey));
+                std::shared_ptr<std::vector<uint8_t>> data = Buffer(size);
+                std::shared_ptr<std::vector<uint8_t>> output = std::make_shared<std::vector<uint8_t>>(size);
+                return (cipher == nullptr ? Operation() : [cipher, data, output]() {
+                    const uint8_t iv[12] = {};
+                    uint8_t tag[16];
+                    return (cipher->Encrypt(sizeof(iv), iv, 0, nullptr, data->size(), data->data(), output->size(), output->data(), sizeof(tag), tag) > 0);
+                });
+            } });
+        }
+
+        cases.push_back({ "dh1024-generate", false, [vault](const uint32_t) -> Operation {
+            std::shared_ptr<Cryptography::IDiffieHellman> dh = Hold(vault->DiffieHellman());
+            return (dh == nullptr ? Operation() : [vault, dh]() {
+                uint32_t privateKey = 0;
+                uint32_t publicKey = 0;
+                bool result = (dh->Generate(dhGenerator, sizeof(dhModulus), dhModulus, privateKey, publicKey) == 0);
+                vault->Delete(privateKey);
+                vault->Delete(publicKey);
+                return (result);
+            });
+        } });
+
+        cases.push_back({ "dh1024-derive", false, [vault](const uint32_t) -> Operation {
+            std::shared_ptr<Cryptography::IDiffieHellman> dh = Hold(vault->DiffieHellman());
+            uint32_t keys[4] = {};
+            if ((dh == nullptr)
+                || (dh->Generate(dhGenerator, sizeof(dhModulus), dhModulus, keys[0], keys[1]) != 0)
+                || (dh->Generate(dhGenerator, sizeof(dhModulus), dhModulus, keys[2], keys[3]) != 0)) {
+                return (Operation());
+            }
+            std::shared_ptr<uint32_t> pair(new uint32_t[4]{ keys[0], keys[1], keys[2], keys[3] },
+                [vault](uint32_t* ids) { for (uint8_t i = 0; i < 4; i++) { vault->Delete(ids[i]); } delete[] ids; });
+            return ([vault, dh, pair]() {
+                uint32_t secret = 0;
+                bool result = (dh->Derive(pair.get()[0], pair.get()[3], secret) == 0);
+                vault->Delete(secret);
+                return (result);
+            });
+        } });
+
+        const struct {
+            const char* name;
+            Cryptography::IKeyAgreement::curvetype curve;
+        } curves[] = {
+            { "x25519", Cryptography::IKeyAgreement::X25519 },
+            { "p256", Cryptography::IKeyAgreement::P256 }
+        };
+
+        for (auto& entry : curves) {
+            const Cryptography::IKeyAgreement::curvetype curve = entry.curve;
+
+            cases.push_back({ string(entry.name) + "-generate", false, [vault, curve](const uint32_t) -> Operation {
+                std::shared_ptr<Cryptography::IKeyAgreement> ka = Hold(vault->KeyAgreement());
+                return (ka == nullptr ? Operation() : [vault, ka, curve]() {
+                    uint32_t privateKey = 0;
+                    uint32_t publicKey = 0;
+                    bool result = (ka->Generate(curve, privateKey, publicKey) == 0);
+                    vault->Delete(privateKey);
+                    vault->Delete(publicKey);
+                    return (result);
+                });
+            } });
+
+            cases.push_back({ string(entry.name) + "-derive", false, [vault, curve](const uint32_t) -> Operation {
+                std::shared_ptr<Cryptography::IKeyAgreement> ka = Hold(vault->KeyAgreement());
+                uint32_t keys[4] = {};
+                if ((ka == nullptr) || (ka->Generate(curve, keys[0], keys[1]) != 0) || (ka->Generate(curve, keys[2], keys[3]) != 0)) {
+                    return (Operation());
+                }
+                std::shared_ptr<uint32_t> pair(new uint32_t[4]{ keys[0], keys[1], keys[2], keys[3] },
+                    [vault](uint32_t* ids) { for (uint8_t i = 0; i < 4; i++) { vault->Delete(ids[i]); } delete[] ids; });
+                return ([vault, ka, pair]() {
+                    uint32_t secret = 0;
+                    bool result = (ka->Derive(pair.get()[0], pair.get()[3], secret) == 0);
+                    vault->Delete(secret);
+                    return (result);
+                });
+            } });
+        }
+
+        cases.push_back({ "vault-import", true, [vault](const uint32_t size) -> Operation {
+            std::shared_ptr<std::vector<uint8_t>> data = Buffer(size);
+            return (size > 0xFFFF ? Operation() : [vault, data]() {
+                const uint32_t id = vault->Import(data->size(), data->data());
+                return ((id != 0) && (vault->Delete(id) == true));
+            });
+        } });
+
+        cases.push_back({ "vault-export", true, [vault](const uint32_t size) -> Operation {
+            std::shared_ptr<std::vector<uint8_t>> data = Buffer(size);
+            if (size > 0xFFFF) {
+                return (Operation());
+            }
+            std::shared_ptr<uint32_t> id(new uint32_t(vault->Import(data->size(), data->data())),
+                [vault](uint32_t* item) { vault->Delete(*item); delete item; });
+            return (*id == 0 ? Operation() : [vault, data, id]() {
+                return (vault->Export(*id, data->size(), data->data()) == data->size());
+            });
+        } });
+
+        return (cases);
+    }
+
+    void Run(const string& path, const string& connector, const Settings& settings, std::vector<Result>& results)
+    {
+        std::shared_ptr<Cryptography::ICryptography> cg = Hold(Cryptography::ICryptography::Instance(connector));
+
+        if (cg == nullptr) {
+            fprintf(stderr, "%s: failed to acquire ICryptography\n", path.c_str());
+        } else {
+            std::shared_ptr<Cryptography::IVault> vault = Hold(cg->Vault(settings.vault));
+
+            if (vault == nullptr) {
+                fprintf(stderr, "%s: failed to acquire vault %i\n", path.c_str(), settings.vault);
+            } else {
+                for (const Case& entry : Cases(cg, vault)) {
+                    const std::vector<uint32_t> sizes = (entry.sized == true ? settings.sizes : std::vector<uint32_t>{ 0 });
+
+                    for (const uint32_t size : sizes) {
+                        for (const uint32_t threads : settings.threads) {
+                            results.push_back(Measure(path, entry, size, threads, settings.duration));
+
+                            const Result& result = results.back();
+                            fprintf(stderr, "%-12s %-20s %6u bytes %2u threads: %s%.0f ops/s\n", result.path.c_str(), result.operation.c_str(),
+                                result.size, result.threads, (result.failed == true ? "FAILED " : ""), (result.seconds > 0 ? (result.operations / result.seconds) : 0));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    string Report(const std::vector<Result>& results)
+    {
+        std::ostringstream json;
+
+        json << "{\n  \"backend\": \"" << CRYPTOGRAPHY_BENCHMARK_BACKEND << "\",\n  \"results\": [";
+
+        for (std::vector<Result>::const_iterator it = results.begin(); it != results.end(); ++it) {
+            const double opsPerSecond = (it->seconds > 0 ? (it->operations / it->seconds) : 0);
+
+            json << (it == results.begin() ? "\n" : ",\n")
+                 << "    { \"path\": \"" << it->path << "\""
+                 << ", \"operation\": \"" << it->operation << "\""
+                 << ", \"size\": " << it->size
+                 << ", \"threads\": " << it->threads
+                 << ", \"operations\": " << it->operations
+                 << ", \"seconds\": " << it->seconds
+                 << ", \"ops_per_second\": " << opsPerSecond
+                 << ", \"mb_per_second\": " << ((opsPerSecond * it->size) / (1024 * 1024))
+                 << ", \"failed\": " << (it->failed == true ? "true" : "false") << " }";
+        }
+
+        json << "\n  ]\n}\n";
+
+        return (json.str());
+    }
+
+    std::vector<uint32_t> List(const char value[])
+    {
+        std::vector<uint32_t> list;
+        std::istringstream stream(value);
+        string item;
+
+        while (std::getline(stream, item, ',')) {
+            list.push_back(static_cast<uint32_t>(::strtoul(item.c_str(), nullptr, 0)));
+        }
+
+        return (list);
+    }
+
+    void Usage(const char name[])
+    {
+        fprintf(stderr, "Usage: %s [-c <connector>] [-o <output.json>] [-d <milliseconds>] [-s <sizes>] [-t <threads>] [-v <vault id>]\n", name);
+        fprintf(stderr, "  -c  also benchmark through COM-RPC, e.g. /tmp/svalbard\n");
+        fprintf(stderr, "  -s  comma separated message sizes (default 16,256,1024,16384)\n");
+        fprintf(stderr, "  -t  comma separated thread counts (default 1,2,4)\n");
+    }
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    Settings settings;
+    bool valid = true;
+
+    for (int index = 1; (index < argc) && (valid == true); index++) {
+        const string option(argv[index]);
+
+        if ((index + 1) >= argc) {
+            valid = false;
+        } else if (option == "-c") {
+            settings.connector = argv[++index];
+        } else if (option == "-o") {
+            settings.output = argv[++index];
+        } else if (option == "-d") {
+            settings.duration = static_cast<uint32_t>(::strtoul(argv[++index], nullptr, 0));
+        } else if (option == "-s") {
+            settings.sizes = List(argv[++index]);
+        } else if (option == "-t") {
+            settings.threads = List(argv[++index]);
+        } else if (option == "-v") {
+            settings.vault = static_cast<cryptographyvault>(::strtoul(argv[++index], nullptr, 0));
+        } else {
+            valid = false;
+        }
+    }
+
+    if (valid == false) {
+        Usage(argv[0]);
+    } else {
+        std::vector<Result> results;
+
+        Run("in-process", string(), settings, results);
+
+        if (settings.connector.empty() == false) {
+            Run("rpc", settings.connector, settings, results);
+        }
+
+        const string report = Report(results);
+
+        if (settings.output.empty() == true) {
+            fputs(report.c_str(), stdout);
+        } else {
+            FILE* file = fopen(settings.output.c_str(), "w");
+            if (file == nullptr) {
+                fprintf(stderr, "Failed to open %s\n", settings.output.c_str());
+                valid = false;
+            } else {
+                fputs(report.c_str(), file);
+                fclose(file);
+            }
+        }
+    }
+
+    Core::Singleton::Dispose();
+
+    return (valid == true ? 0 : 1);
+}
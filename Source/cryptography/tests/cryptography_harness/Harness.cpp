@@ -0,0 +1,860 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Module.h"
+
+#include <implementation/vault_implementation.h>
+#include <implementation/hash_implementation.h>
+#include <implementation/cipher_implementation.h>
+#include <implementation/diffiehellman_implementation.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Drives the C interface every backend implements (implementation/*_implementation.h) with a random
+// workload: operations, message sizes, split points, keys and key lifetimes are all drawn from a seed,
+// on a number of threads sharing one vault. Every operation is checked against itself (incremental vs.
+// one-shot, decrypt vs. encrypt, exported vs. imported), latency percentiles go out as JSON.
+// The outputs of the deterministic operations are folded in a fingerprint per operation, a report of
+// another backend run with the same workload (-r) is compared against, to catch backends that differ.
+
+using namespace WPEFramework;
+
+namespace {
+
+    static const uint8_t dhGenerator = 5;
+
+    static const uint8_t dhModulus[] = {
+        0x96, 0x94, 0xe9, 0xd8, 0xd9, 0x3a, 0x5a, 0xc7, 0x4c, 0x50, 0x9b, 0x4b, 0xbc, 0xe8, 0x5e, 0x92,
+        0x13, 0x2c, 0xd1, 0x9c, 0xce, 0x47, 0x7d, 0x1a, 0x7e, 0x47, 0xd5, 0x27, 0xd9, 0xec, 0x29, 0x15,
+        0x15, 0xf0, 0xb8, 0xb3, 0xe1, 0xea, 0xed, 0x50, 0x06, 0xe1, 0xb1, 0xb9, 0x1e, 0xa2, 0x5b, 0x91,
+        0xa0, 0x1b, 0x10, 0xe2, 0xe8, 0x34, 0xb8, 0xd6, 0x60, 0xb2, 0xe3, 0x21, 0xad, 0x64, 0x4c, 0xe1,
+        0xa8, 0x3b, 0x32, 0x8d, 0x90, 0x14, 0xee, 0x7e, 0x16, 0xf1, 0xe4, 0x4f, 0xfe, 0x89, 0x57, 0x9a,
+        0xc3, 0xee, 0x47, 0xd6, 0x68, 0xb6, 0xb7, 0x66, 0x87, 0xc2, 0xfe, 0x90, 0xa3, 0x5b, 0x5e, 0x60,
+        0x28, 0xfd, 0x04, 0xef, 0xea, 0x88, 0x23, 0x73, 0xec, 0xf6, 0x0b, 0xa2, 0xf6, 0x37, 0xe4, 0xcd,
+        0xaa, 0x1b, 0x60, 0x89, 0xd6, 0xc0, 0xb5, 0x61, 0xa8, 0xe5, 0x20, 0xe7, 0x96, 0xde, 0x27, 0xdf
+    };
+
+    static const hash_type hashTypes[] = { HASH_TYPE_SHA1, HASH_TYPE_SHA224, HASH_TYPE_SHA256, HASH_TYPE_SHA384, HASH_TYPE_SHA512 };
+
+    static const aes_mode aesModes[] = { AES_MODE_ECB, AES_MODE_CBC, AES_MODE_OFB, AES_MODE_CFB1, AES_MODE_CFB8, AES_MODE_CFB128, AES_MODE_CTR };
+
+    // Sizes around block and page boundaries, drawn more often than the others
+    static const uint32_t edgeSizes[] = { 1, 15, 16, 17, 31, 32, 33, 63, 64, 65, 255, 256, 257, 4095, 4096, 4097 };
+
+    enum operation : uint8_t {
+        DIGEST,
+        HASH,
+        HMAC,
+        AES,
+        AEAD,
+        VAULT,
+        DH,
+        OPERATIONS
+    };
+
+    static const struct {
+        const char* name;
+        uint8_t weight;
+        bool deterministic;
+    } operations[OPERATIONS] = {
+        { "digest", 4, true },
+        { "hash", 3, true },
+        { "hmac", 3, true },
+        { "aes", 6, true },
+        { "aead", 3, true },
+        { "vault", 3, false },
+        { "dh", 1, false }
+    };
+
+    struct Settings {
+        Settings()
+            : output()
+            , reference()
+            , seed(1)
+            , threads(4)
+            , iterations(2000)
+            , maxSize(16384)
+            , vault(CRYPTOGRAPHY_VAULT_PLATFORM)
+        {
+        }
+
+        // The fingerprints only compare between runs of the same workload
+        string Workload() const
+        {
+            std::ostringstream workload;
+            workload << "seed=" << seed << " threads=" << threads << " iterations=" << iterations << " max=" << maxSize;
+            return (workload.str());
+        }
+
+        string output;
+        string reference;
+        uint64_t seed;
+        uint32_t threads;
+        uint32_t iterations;
+        uint32_t maxSize;
+        cryptographyvault vault;
+    };
+
+    struct Statistics {
+        Statistics()
+            : latencies()
+            , bytes(0)
+            , failures(0)
+            , mismatches(0)
+            , fingerprint(0xcbf29ce484222325ULL)
+        {
+        }
+
+        // FNV-1a, the same on every platform
+        void Fold(const uint32_t length, const uint8_t data[])
+        {
+            for (uint32_t index = 0; index < length; index++) {
+                fingerprint = ((fingerprint ^ data[index]) * 0x100000001b3ULL);
+            }
+        }
+
+        std::vector<uint32_t> latencies; // nanoseconds
+        uint64_t bytes;
+        uint32_t failures;
+        uint32_t mismatches;
+        uint64_t fingerprint;
+    };
+
+    // xorshift64*, the standard distributions are implementation defined and would give
+    // another workload on another toolchain.
+    class Random {
+    public:
+        Random() = delete;
+        Random(const Random&) = delete;
+        Random& operator=(const Random&) = delete;
+
+        explicit Random(const uint64_t seed)
+            : _state(seed != 0 ? seed : 0x9e3779b97f4a7c15ULL)
+        {
+        }
+
+    public:
+        uint64_t Next()
+        {
+            _state ^= (_state >> 12);
+            _state ^= (_state << 25);
+            _state ^= (_state >> 27);
+            return (_state * 0x2545f4914f6cdd1dULL);
+        }
+
+        // 0 up to range - 1
+        uint32_t Draw(const uint32_t range)
+        {
+            return (static_cast<uint32_t>((Next() >> 32) % range));
+        }
+
+        // 1 up to max, a quarter of them at a block or page boundary
+        uint32_t Size(const uint32_t max)
+        {
+            uint32_t result = (Draw(4) == 0 ? edgeSizes[Draw(sizeof(edgeSizes) / sizeof(edgeSizes[0]))] : (1 + Draw(max)));
+            return (std::min(result, max));
+        }
+
+        void Fill(const uint32_t length, uint8_t data[])
+        {
+            for (uint32_t index = 0; index < length; index++) {
+                data[index] = static_cast<uint8_t>(Next() >> 56);
+            }
+        }
+
+    private:
+        uint64_t _state;
+    };
+
+    // The keys of a thread, each one is replaced (deleted and imported anew) when its uses run out
+    // or another length is asked for, so key lifetimes vary from a single operation to many.
+    class Keys {
+    private:
+        static constexpr uint8_t Slots = 4;
+        static constexpr uint16_t MaxUses = 64;
+
+        struct Key {
+            uint32_t id;
+            uint8_t length;
+            uint16_t uses;
+        };
+
+    public:
+        Keys() = delete;
+        Keys(const Keys&) = delete;
+        Keys& operator=(const Keys&) = delete;
+
+        Keys(VaultImplementation* vault, Random& random)
+            : _vault(vault)
+            , _random(random)
+            , _keys()
+        {
+            ::memset(_keys, 0, sizeof(_keys));
+        }
+        ~Keys()
+        {
+            for (Key& key : _keys) {
+                if (key.id != 0) {
+                    vault_delete(_vault, key.id);
+                }
+            }
+        }
+
+    public:
+        // A key of the given length, 0 if it could not be imported
+        uint32_t Get(const uint8_t length)
+        {
+            Key& key(_keys[_random.Draw(Slots)]);
+
+            if ((key.id == 0) || (key.uses == 0) || (key.length != length)) {
+                uint8_t blob[64];
+
+                if (key.id != 0) {
+                    vault_delete(_vault, key.id);
+                }
+
+                _random.Fill(length, blob);
+
+                key.id = vault_import(_vault, length, blob);
+                key.length = length;
+                key.uses = static_cast<uint16_t>(1 + _random.Draw(MaxUses));
+            }
+
+            key.uses--;
+
+            return (key.id);
+        }
+
+    private:
+        VaultImplementation* _vault;
+        Random& _random;
+        Key _keys[Slots];
+    };
+
+    class Worker {
+    public:
+        Worker() = delete;
+        Worker(const Worker&) = delete;
+        Worker& operator=(const Worker&) = delete;
+
+        Worker(VaultImplementation* vault, const Settings& settings, const uint32_t index)
+            : _vault(vault)
+            , _settings(settings)
+            , _index(index)
+            , _iteration(0)
+            , _random(settings.seed + ((index + 1) * 0x9e3779b97f4a7c15ULL))
+            , _keys(vault, _random)
+            , _input(settings.maxSize + 64)
+            , _output(settings.maxSize + 64)
+            , _check(settings.maxSize + 64)
+            , _statistics()
+        {
+        }
+
+    public:
+        const Statistics& operator[](const uint8_t index) const
+        {
+            return (_statistics[index]);
+        }
+
+        void Run()
+        {
+            uint32_t total = 0;
+
+            for (auto& entry : operations) {
+                total += entry.weight;
+            }
+
+            for (_iteration = 0; _iteration < _settings.iterations; _iteration++) {
+                uint32_t pick = _random.Draw(total);
+                uint8_t index = 0;
+
+                while (pick >= operations[index].weight) {
+                    pick -= operations[index].weight;
+                    index++;
+                }
+
+                switch (static_cast<operation>(index)) {
+                case DIGEST: Digest(_statistics[DIGEST]); break;
+                case HASH: Hash(_statistics[HASH]); break;
+                case HMAC: Hmac(_statistics[HMAC]); break;
+                case AES: Aes(_statistics[AES]); break;
+                case AEAD: Aead(_statistics[AEAD]); break;
+                case VAULT: Vault(_statistics[VAULT]); break;
+                case DH: DiffieHellman(_statistics[DH]); break;
+                default: break;
+                }
+            }
+        }
+
+    private:
+        template <typename FUNCTION>
+        auto Time(Statistics& statistics, FUNCTION function) -> decltype(function())
+        {
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            auto result = function();
+
+            statistics.latencies.push_back(static_cast<uint32_t>(std::min(static_cast<int64_t>(UINT32_MAX),
+                static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()))));
+
+            return (result);
+        }
+
+        // Reports the iteration, together with the seed it reproduces the case.
+        void Failed(Statistics& statistics, const bool mismatch, const char what[], const uint32_t size)
+        {
+            if (mismatch == true) {
+                statistics.mismatches++;
+            } else {
+                statistics.failures++;
+            }
+
+            fprintf(stderr, "thread %u, iteration %u: %s (%u bytes)\n", _index, _iteration, what, size);
+        }
+
+        void Digest(Statistics& statistics)
+        {
+            const hash_type type = hashTypes[_random.Draw(sizeof(hashTypes) / sizeof(hashTypes[0]))];
+            const uint32_t size = (_random.Draw(8) == 0 ? 0 : _random.Size(_settings.maxSize));
+            uint8_t digest[64];
+
+            _random.Fill(size, _input.data());
+
+            const uint8_t length = Time(statistics, [&]() { return (hash_digest(type, size, _input.data(), sizeof(digest), digest)); });
+
+            if (length != static_cast<uint8_t>(type)) {
+                Failed(statistics, false, "hash_digest", size);
+            } else {
+                statistics.bytes += size;
+                statistics.Fold(length, digest);
+            }
+        }
+
+        // Ingested in random pieces, with a copy taken halfway, both have to match the one-shot digest.
+        void Hash(Statistics& statistics)
+        {
+            const hash_type type = hashTypes[_random.Draw(sizeof(hashTypes) / sizeof(hashTypes[0]))];
+            const uint32_t size = _random.Size(_settings.maxSize);
+            const uint32_t split = _random.Draw(size + 1);
+            uint8_t digest[64];
+            uint8_t expected[64];
+            uint8_t copied[64];
+
+            _random.Fill(size, _input.data());
+
+            HashImplementation* hash = hash_create(type);
+
+            if (hash == nullptr) {
+                Failed(statistics, false, "hash_create", size);
+            } else {
+                HashImplementation* copy = nullptr;
+
+                const uint8_t length = Time(statistics, [&]() -> uint8_t {
+                    uint8_t result = 0;
+                    if (hash_ingest(hash, split, _input.data()) == split) {
+                        copy = hash_copy(hash);
+                        if (hash_ingest(hash, (size - split), (_input.data() + split)) == (size - split)) {
+                            result = hash_calculate(hash, sizeof(digest), digest);
+                        }
+                    }
+                    return (result);
+                });
+
+                if ((length != static_cast<uint8_t>(type)) || (copy == nullptr)) {
+                    Failed(statistics, false, "hash_ingest/hash_copy/hash_calculate", size);
+                } else {
+                    statistics.bytes += size;
+                    statistics.Fold(length, digest);
+
+                    if ((hash_ingest(copy, (size - split), (_input.data() + split)) != (size - split))
+                        || (hash_calculate(copy, sizeof(copied), copied) != length)
+                        || (hash_digest(type, size, _input.data(), sizeof(expected), expected) != length)
+                        || (::memcmp(digest, expected, length) != 0)
+                        || (::memcmp(copied, expected, length) != 0)) {
+                        Failed(statistics, true, "incremental hash differs from hash_digest", size);
+                    }
+                }
+
+                if (copy != nullptr) {
+                    hash_destroy(copy);
+                }
+
+                hash_destroy(hash);
+            }
+        }
+
+        void Hmac(Statistics& statistics)
+        {
+            const hash_type type = hashTypes[_random.Draw(sizeof(hashTypes) / sizeof(hashTypes[0]))];
+            const uint32_t key = _keys.Get(static_cast<uint8_t>(16 + _random.Draw(49)));
+            const uint32_t size = _random.Size(_settings.maxSize);
+            uint8_t hmac[64];
+            uint8_t expected[64];
+
+            _random.Fill(size, _input.data());
+
+            if (key == 0) {
+                Failed(statistics, false, "vault_import", size);
+            } else {
+                const uint8_t length = Time(statistics, [&]() { return (hash_hmac(_vault, type, key, size, _input.data(), sizeof(hmac), hmac)); });
+
+                if (length != static_cast<uint8_t>(type)) {
+                    Failed(statistics, false, "hash_hmac", size);
+                } else {
+                    statistics.bytes += size;
+                    statistics.Fold(length, hmac);
+
+                    HashImplementation* hash = hash_create_hmac(_vault, type, key);
+
+                    if ((hash == nullptr)
+                        || (hash_ingest(hash, size, _input.data()) != size)
+                        || (hash_calculate(hash, sizeof(expected), expected) != length)
+                        || (::memcmp(hmac, expected, length) != 0)) {
+                        Failed(statistics, true, "incremental HMAC differs from hash_hmac", size);
+                    }
+
+                    if (hash != nullptr) {
+                        hash_destroy(hash);
+                    }
+                }
+            }
+        }
+
+        void Aes(Statistics& statistics)
+        {
+            const aes_mode mode = aesModes[_random.Draw(sizeof(aesModes) / sizeof(aesModes[0]))];
+            const uint32_t key = _keys.Get(static_cast<uint8_t>(16 + (8 * _random.Draw(3))));
+            const uint32_t size = _random.Size(_settings.maxSize);
+            const bool padded = ((mode == AES_MODE_ECB) || (mode == AES_MODE_CBC));
+            const int32_t expected = (padded == true ? (size + (16 - (size % 16))) : size);
+            uint8_t iv[16];
+
+            _random.Fill(sizeof(iv), iv);
+            _random.Fill(size, _input.data());
+
+            CipherImplementation* cipher = (key == 0 ? nullptr : cipher_create_aes(_vault, mode, key));
+
+            if (cipher == nullptr) {
+                Failed(statistics, false, "cipher_create_aes", size);
+            } else {
+                const int32_t length = Time(statistics, [&]() { return (cipher_encrypt(cipher, sizeof(iv), iv, size, _input.data(), _output.size(), _output.data())); });
+
+                if (length != expected) {
+                    Failed(statistics, false, "cipher_encrypt", size);
+                } else {
+                    statistics.bytes += size;
+                    statistics.Fold(length, _output.data());
+
+                    if ((cipher_decrypt(cipher, sizeof(iv), iv, length, _output.data(), _check.size(), _check.data()) != static_cast<int32_t>(size))
+                        || (::memcmp(_check.data(), _input.data(), size) != 0)) {
+                        Failed(statistics, true, "cipher_decrypt does not give the plaintext", size);
+                    }
+                }
+
+                cipher_destroy(cipher);
+            }
+        }
+
+        // Round trip, and a tag with a bit flipped has to be refused.
+        void Aead(Statistics& statistics)
+        {
+            const aead_mode mode = (_random.Draw(2) == 0 ? AEAD_MODE_AES_GCM : AEAD_MODE_CHACHA20_POLY1305);
+            const uint32_t key = _keys.Get(mode == AEAD_MODE_AES_GCM ? static_cast<uint8_t>(16 + (16 * _random.Draw(2))) : 32);
+            const uint32_t size = _random.Size(_settings.maxSize);
+            const uint16_t aadSize = static_cast<uint16_t>(_random.Draw(65));
+            const uint8_t tagSize = static_cast<uint8_t>(12 + _random.Draw(5));
+            uint8_t iv[12];
+            uint8_t aad[64];
+            uint8_t tag[16];
+
+            _random.Fill(sizeof(iv), iv);
+            _random.Fill(aadSize, aad);
+            _random.Fill(size, _input.data());
+
+            CipherImplementation* cipher = (key == 0 ? nullptr : cipher_create_aead(_vault, mode, key));
+
+            if (cipher == nullptr) {
+                // ChaCha20-Poly1305 is optional
+                if (mode == AEAD_MODE_AES_GCM) {
+                    Failed(statistics, false, "cipher_create_aead", size);
+                }
+            } else {
+                const int32_t length = Time(statistics, [&]() {
+                    return (cipher_aead_encrypt(cipher, sizeof(iv), iv, aadSize, aad, size, _input.data(), _output.size(), _output.data(), tagSize, tag));
+                });
+
+                if (length != static_cast<int32_t>(size)) {
+                    Failed(statistics, false, "cipher_aead_encrypt", size);
+                } else {
+                    statistics.bytes += size;
+                    statistics.Fold(length, _output.data());
+                    statistics.Fold(tagSize, tag);
+
+                    if ((cipher_aead_decrypt(cipher, sizeof(iv), iv, aadSize, aad, length, _output.data(), _check.size(), _check.data(), tagSize, tag) != length)
+                        || (::memcmp(_check.data(), _input.data(), size) != 0)) {
+                        Failed(statistics, true, "cipher_aead_decrypt does not give the plaintext", size);
+                    }
+
+                    tag[_random.Draw(tagSize)] ^= static_cast<uint8_t>(1 << _random.Draw(8));
+
+                    if (cipher_aead_decrypt(cipher, sizeof(iv), iv, aadSize, aad, length, _output.data(), _check.size(), _check.data(), tagSize, tag) != 0) {
+                        Failed(statistics, true, "cipher_aead_decrypt accepts a forged tag", size);
+                    }
+                }
+
+                cipher_destroy(cipher);
+            }
+        }
+
+        void Vault(Statistics& statistics)
+        {
+            const uint32_t size = _random.Size(std::min(_settings.maxSize, 4096u));
+
+            _random.Fill(size, _input.data());
+
+            const uint32_t id = Time(statistics, [&]() { return (vault_import(_vault, static_cast<uint16_t>(size), _input.data())); });
+
+            if (id == 0) {
+                Failed(statistics, false, "vault_import", size);
+            } else {
+                statistics.bytes += size;
+
+                if ((vault_size(_vault, id) != size)
+                    || (vault_export(_vault, id, static_cast<uint16_t>(_check.size()), _check.data()) != size)
+                    || (::memcmp(_check.data(), _input.data(), size) != 0)) {
+                    Failed(statistics, true, "vault_export does not give the imported blob", size);
+                }
+
+                if ((vault_delete(_vault, id) == false) || (vault_size(_vault, id) != 0)) {
+                    Failed(statistics, false, "vault_delete", size);
+                }
+            }
+        }
+
+        // Both sides have to end up with the same secret, checked by an HMAC with either one.
+        void DiffieHellman(Statistics& statistics)
+        {
+            uint32_t keys[4] = {};
+            uint32_t secrets[2] = {};
+
+            const bool generated = Time(statistics, [&]() {
+                return ((diffiehellman_generate(_vault, dhGenerator, sizeof(dhModulus), dhModulus, &keys[0], &keys[1]) == 0)
+                    && (diffiehellman_generate(_vault, dhGenerator, sizeof(dhModulus), dhModulus, &keys[2], &keys[3]) == 0));
+            });
+
+            if (generated == false) {
+                Failed(statistics, false, "diffiehellman_generate", 0);
+            } else if ((diffiehellman_derive(_vault, keys[0], keys[3], &secrets[0]) != 0)
+                || (diffiehellman_derive(_vault, keys[2], keys[1], &secrets[1]) != 0)) {
+                Failed(statistics, false, "diffiehellman_derive", 0);
+            } else {
+                uint8_t hmacs[2][32];
+
+                _random.Fill(64, _input.data());
+
+                if ((hash_hmac(_vault, HASH_TYPE_SHA256, secrets[0], 64, _input.data(), sizeof(hmacs[0]), hmacs[0]) != sizeof(hmacs[0]))
+                    || (hash_hmac(_vault, HASH_TYPE_SHA256, secrets[1], 64, _input.data(), sizeof(hmacs[1]), hmacs[1]) != sizeof(hmacs[1]))
+                    || (::memcmp(hmacs[0], hmacs[1], sizeof(hmacs[0])) != 0)) {
+                    Failed(statistics, true, "diffiehellman_derive gives different secrets", 0);
+                }
+            }
+
+            for (const uint32_t id : keys) {
+                if (id != 0) {
+                    vault_delete(_vault, id);
+                }
+            }
+            for (const uint32_t id : secrets) {
+                if (id != 0) {
+                    vault_delete(_vault, id);
+                }
+            }
+        }
+
+    private:
+        VaultImplementation* _vault;
+        const Settings& _settings;
+        const uint32_t _index;
+        uint32_t _iteration;
+        Random _random;
+        Keys _keys;
+        std::vector<uint8_t> _input;
+        std::vector<uint8_t> _output;
+        std::vector<uint8_t> _check;
+        Statistics _statistics[OPERATIONS];
+    };
+
+    // The threads in order, so the fingerprint does not depend on the scheduling.
+    Statistics Merge(const std::vector<std::unique_ptr<Worker>>& workers, const uint8_t index)
+    {
+        Statistics result;
+
+        for (const std::unique_ptr<Worker>& worker : workers) {
+            const Statistics& statistics((*worker)[index]);
+
+            result.latencies.insert(result.latencies.end(), statistics.latencies.begin(), statistics.latencies.end());
+            result.bytes += statistics.bytes;
+            result.failures += statistics.failures;
+            result.mismatches += statistics.mismatches;
+            result.Fold(sizeof(statistics.fingerprint), reinterpret_cast<const uint8_t*>(&statistics.fingerprint));
+        }
+
+        std::sort(result.latencies.begin(), result.latencies.end());
+
+        return (result);
+    }
+
+    double Percentile(const std::vector<uint32_t>& sorted, const uint8_t percentile)
+    {
+        return (sorted.empty() == true ? 0 : (sorted[((sorted.size() - 1) * percentile) / 100] / 1000.0));
+    }
+
+    string Fingerprint(const uint64_t value)
+    {
+        char text[17];
+        snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(value));
+        return (string(text));
+    }
+
+    string Report(const Settings& settings, const std::vector<Statistics>& results, const double seconds)
+    {
+        std::ostringstream json;
+
+        json << "{\n  \"backend\": \"" << CRYPTOGRAPHY_HARNESS_BACKEND << "\",\n  \"workload\": \"" << settings.Workload()
+             << "\",\n  \"seconds\": " << seconds << ",\n  \"results\": [";
+
+        for (uint8_t index = 0; index < OPERATIONS; index++) {
+            const Statistics& result(results[index]);
+            uint64_t total = 0;
+
+            for (const uint32_t latency : result.latencies) {
+                total += latency;
+            }
+
+            json << (index == 0 ? "\n" : ",\n")
+                 << "    { \"operation\": \"" << operations[index].name << "\""
+                 << ", \"count\": " << result.latencies.size()
+                 << ", \"failures\": " << result.failures
+                 << ", \"mismatches\": " << result.mismatches
+                 << ", \"mb_per_second\": " << (total > 0 ? ((result.bytes * 1000000000.0) / total / (1024 * 1024)) : 0)
+                 << ", \"p50_us\": " << Percentile(result.latencies, 50)
+                 << ", \"p90_us\": " << Percentile(result.latencies, 90)
+                 << ", \"p99_us\": " << Percentile(result.latencies, 99)
+                 << ", \"max_us\": " << Percentile(result.latencies, 100);
+
+            if (operations[index].deterministic == true) {
+                json << ", \"fingerprint\": \"" << Fingerprint(result.fingerprint) << "\"";
+            }
+
+            json << " }";
+        }
+
+        json << "\n  ]\n}\n";
+
+        return (json.str());
+    }
+
+    // The value of a "key": "value" pair on the line, empty if not there.
+    string Value(const string& line, const string& key)
+    {
+        string result;
+        const string tag = ("\"" + key + "\": \"");
+        const size_t start = line.find(tag);
+
+        if (start != string::npos) {
+            const size_t end = line.find('"', start + tag.length());
+
+            if (end != string::npos) {
+                result = line.substr(start + tag.length(), end - start - tag.length());
+            }
+        }
+
+        return (result);
+    }
+
+    // Only reads back what Report() writes, one result per line.
+    bool Compare(const Settings& settings, const std::vector<Statistics>& results)
+    {
+        bool result = false;
+        std::ifstream file(settings.reference);
+
+        if (file.is_open() == false) {
+            fprintf(stderr, "Failed to open %s\n", settings.reference.c_str());
+        } else {
+            string line;
+            string backend;
+            uint8_t compared = 0;
+
+            result = true;
+
+            while ((result == true) && (std::getline(file, line))) {
+                const string workload = Value(line, "workload");
+
+                if (backend.empty() == true) {
+                    backend = Value(line, "backend");
+                }
+
+                if ((workload.empty() == false) && (workload != settings.Workload())) {
+                    fprintf(stderr, "%s was run with another workload: %s\n", settings.reference.c_str(), workload.c_str());
+                    result = false;
+                }
+
+                const string name = Value(line, "operation");
+                const string fingerprint = Value(line, "fingerprint");
+
+                for (uint8_t index = 0; (index < OPERATIONS) && (fingerprint.empty() == false); index++) {
+                    if (name == operations[index].name) {
+                        compared++;
+
+                        if (fingerprint != Fingerprint(results[index].fingerprint)) {
+                            fprintf(stderr, "%s: output differs from backend %s\n", operations[index].name, backend.c_str());
+                            result = false;
+                        }
+                    }
+                }
+            }
+
+            if ((result == true) && (compared == 0)) {
+                fprintf(stderr, "No fingerprints found in %s\n", settings.reference.c_str());
+                result = false;
+            }
+        }
+
+        return (result);
+    }
+
+    void Usage(const char name[])
+    {
+        fprintf(stderr, "Usage: %s [-o <output.json>] [-r <reference.json>] [-s <seed>] [-t <threads>] [-n <iterations>] [-m <max size>] [-v <vault id>]\n", name);
+        fprintf(stderr, "  -r  report of another backend, run with the same -s, -t, -n and -m, to compare the outputs with\n");
+        fprintf(stderr, "  -n  operations per thread (default 2000)\n");
+        fprintf(stderr, "  -m  largest message in bytes (default 16384)\n");
+    }
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    Settings settings;
+    bool valid = true;
+
+    for (int index = 1; (index < argc) && (valid == true); index++) {
+        const string option(argv[index]);
+
+        if ((index + 1) >= argc) {
+            valid = false;
+        } else if (option == "-o") {
+            settings.output = argv[++index];
+        } else if (option == "-r") {
+            settings.reference = argv[++index];
+        } else if (option == "-s") {
+            settings.seed = ::strtoull(argv[++index], nullptr, 0);
+        } else if (option == "-t") {
+            settings.threads = std::max(static_cast<uint32_t>(::strtoul(argv[++index], nullptr, 0)), 1u);
+        } else if (option == "-n") {
+            settings.iterations = static_cast<uint32_t>(::strtoul(argv[++index], nullptr, 0));
+        } else if (option == "-m") {
+            settings.maxSize = std::max(static_cast<uint32_t>(::strtoul(argv[++index], nullptr, 0)), 1u);
+        } else if (option == "-v") {
+            settings.vault = static_cast<cryptographyvault>(::strtoul(argv[++index], nullptr, 0));
+        } else {
+            valid = false;
+        }
+    }
+
+    if (valid == false) {
+        Usage(argv[0]);
+    } else {
+        VaultImplementation* vault = vault_instance(settings.vault);
+
+        if (vault == nullptr) {
+            fprintf(stderr, "Failed to acquire vault %i\n", settings.vault);
+            valid = false;
+        } else {
+            std::vector<std::unique_ptr<Worker>> workers;
+            std::vector<std::thread> threads;
+            std::vector<Statistics> results;
+
+            for (uint32_t index = 0; index < settings.threads; index++) {
+                workers.emplace_back(new Worker(vault, settings, index));
+            }
+
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            for (std::unique_ptr<Worker>& worker : workers) {
+                threads.emplace_back(&Worker::Run, worker.get());
+            }
+            for (std::thread& thread : threads) {
+                thread.join();
+            }
+
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            for (uint8_t index = 0; index < OPERATIONS; index++) {
+                results.push_back(Merge(workers, index));
+
+                const Statistics& result(results.back());
+                fprintf(stderr, "%-8s %7u ops %5u failed %5u mismatched  p50 %9.1f us  p99 %9.1f us\n", operations[index].name,
+                    static_cast<uint32_t>(result.latencies.size()), result.failures, result.mismatches,
+                    Percentile(result.latencies, 50), Percentile(result.latencies, 99));
+
+                if ((result.failures != 0) || (result.mismatches != 0)) {
+                    valid = false;
+                }
+            }
+
+            // The keys go before the vault does
+            workers.clear();
+
+            const string report = Report(settings, results, seconds);
+
+            if (settings.output.empty() == true) {
+                fputs(report.c_str(), stdout);
+            } else {
+                FILE* file = fopen(settings.output.c_str(), "w");
+                if (file == nullptr) {
+                    fprintf(stderr, "Failed to open %s\n", settings.output.c_str());
+                    valid = false;
+                } else {
+                    fputs(report.c_str(), file);
+                    fclose(file);
+                }
+            }
+
+            if ((settings.reference.empty() == false) && (Compare(settings, results) == false)) {
+                valid = false;
+            }
+        }
+    }
+
+    Core::Singleton::Dispose();
+
+    return (valid == true ? 0 : 1);
+}
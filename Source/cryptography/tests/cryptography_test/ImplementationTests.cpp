@@ -26,8 +26,12 @@
 #include <string.h>
 #include <stdbool.h>
 #include <limits.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 #include <openssl/dh.h>
+#include <openssl/evp.h>
 #include <openssl/hmac.h>
 #include <openssl/sha.h>
 
@@ -35,6 +39,9 @@
 #include <implementation/hash_implementation.h>
 #include <implementation/cipher_implementation.h>
 #include <implementation/diffiehellman_implementation.h>
+#include <implementation/keyagreement_implementation.h>
+#include <implementation/persistent_implementation.h>
+#include <implementation/AESAccelerated.h>
 
 #include "Helpers.h"
 #include "Test.h"
@@ -170,6 +177,52 @@ static uint32_t TestVaultSet(const uint8_t vector[], const uint16_t vectorSize,
     return (sealedId);
 }
 
+TEST(Vault, Statistics)
+{
+    vault_stats before;
+    vault_stats during;
+    vault_stats after;
+
+    if (vault_statistics(vault, &before) == false) {
+        printf("> Vault statistics not supported, skipped\n");
+    } else {
+        uint32_t id1 = vault_import(vault, sizeof(testVector1), testVector1);
+        uint32_t id2 = vault_import(vault, sizeof(testVector4), testVector4);
+        EXPECT_NE(id1, 0);
+        EXPECT_NE(id2, 0);
+
+        EXPECT_NE(vault_statistics(vault, &during), false);
+        EXPECT_EQ(during.items, before.items + 2);
+        EXPECT_GT(during.bytes, before.bytes + sizeof(testVector1) + sizeof(testVector4));
+        EXPECT_GE(during.peak_bytes, during.bytes);
+
+        EXPECT_NE(vault_delete(vault, id1), false);
+        EXPECT_NE(vault_delete(vault, id2), false);
+
+        EXPECT_NE(vault_statistics(vault, &after), false);
+        EXPECT_EQ(after.items, before.items);
+        EXPECT_EQ(after.bytes, before.bytes);
+        EXPECT_EQ(after.peak_bytes, during.peak_bytes);
+
+        /* Enough blobs to take several slab pages per shard, which are given back on deletion */
+        uint32_t ids[1024];
+        for (uint16_t i = 0; i < (sizeof(ids) / sizeof(ids[0])); i++) {
+            ids[i] = vault_import(vault, sizeof(testVector1), testVector1);
+            EXPECT_NE(ids[i], 0);
+        }
+        for (uint16_t i = 0; i < (sizeof(ids) / sizeof(ids[0])); i += 2) {
+            EXPECT_NE(vault_delete(vault, ids[i]), false);
+        }
+        for (uint16_t i = 1; i < (sizeof(ids) / sizeof(ids[0])); i += 2) {
+            EXPECT_NE(vault_delete(vault, ids[i]), false);
+        }
+
+        EXPECT_NE(vault_statistics(vault, &after), false);
+        EXPECT_EQ(after.items, before.items);
+        EXPECT_EQ(after.bytes, before.bytes);
+    }
+}
+
 TEST(Vault, SetGet)
 {
     /* Empty vault */
@@ -202,6 +255,101 @@ TEST(Vault, SetGet)
     EXPECT_EQ(vault_size(vault, id4), 0);
 }
 
+static const char keyStore[] = "/tmp/cgimptests.keystore";
+
+/* The platform vault opens its key store once per process, so every session runs in a child of its own.
+   Returns the HMAC of a test vector with the created or loaded key, to compare the key across sessions. */
+static bool PersistentSession(const char locator[], const bool create, uint8_t hmac[32])
+{
+    bool result = false;
+    int channel[2];
+
+    if (pipe(channel) == 0) {
+        pid_t child = fork();
+
+        if (child == 0) {
+            struct VaultImplementation* platform = NULL;
+            uint32_t id = 0;
+            uint8_t output[32];
+            uint8_t length = 0;
+
+            close(channel[0]);
+            setenv("CRYPTOGRAPHY_KEYSTORE", keyStore, 1);
+            platform = vault_instance(CRYPTOGRAPHY_VAULT_PLATFORM);
+
+            if ((platform != NULL)
+                && ((create == true) ? ((persistent_key_create(platform, locator, HMAC256, &id) == 0) && (persistent_flush(platform) == 0))
+                                     : (persistent_key_load(platform, locator, &id) == 0))) {
+                length = hash_hmac(platform, HASH_TYPE_SHA256, id, sizeof(testVector2), testVector2, sizeof(output), output);
+            }
+
+            const bool written = ((length == sizeof(output)) && (write(channel[1], output, sizeof(output)) == sizeof(output)));
+
+            close(channel[1]);
+            _exit(written == true ? 0 : 1);
+        } else if (child > 0) {
+            int status = 1;
+
+            close(channel[1]);
+            result = (read(channel[0], hmac, 32) == 32);
+            close(channel[0]);
+
+            result = ((waitpid(child, &status, 0) == child) && (WIFEXITED(status) != 0) && (WEXITSTATUS(status) == 0) && (result == true));
+        } else {
+            close(channel[0]);
+            close(channel[1]);
+        }
+    }
+
+    return (result);
+}
+
+TEST(Vault, Persistent)
+{
+    uint8_t hmacA[32];
+    uint8_t hmacB[32];
+    uint8_t hmac[32];
+
+    unlink(keyStore);
+
+    printf("> Testing a key store round trip\n");
+    EXPECT_NE(PersistentSession("test-a", true, hmacA), false);
+    EXPECT_NE(PersistentSession("test-a", false, hmac), false);
+    EXPECT_EQ(memcmp(hmac, hmacA, sizeof(hmac)), 0);
+    EXPECT_EQ(PersistentSession("test-a", true, hmac), false);
+    EXPECT_EQ(PersistentSession("test-x", false, hmac), false);
+
+    EXPECT_NE(PersistentSession("test-b", true, hmacB), false);
+    EXPECT_NE(memcmp(hmacB, hmacA, sizeof(hmacB)), 0);
+    EXPECT_NE(PersistentSession("test-b", false, hmac), false);
+    EXPECT_EQ(memcmp(hmac, hmacB, sizeof(hmac)), 0);
+
+    printf("> Testing a key store with a corrupted record\n");
+    FILE* file = fopen(keyStore, "r+b");
+    EXPECT_NE(file, NULL);
+
+    if (file != NULL) {
+        // The last byte belongs to the sealed key of the record appended last
+        uint8_t last = 0;
+        EXPECT_EQ(fseek(file, -1, SEEK_END), 0);
+        EXPECT_EQ(fread(&last, 1, 1, file), 1);
+        last ^= 0x01;
+        EXPECT_EQ(fseek(file, -1, SEEK_END), 0);
+        EXPECT_EQ(fwrite(&last, 1, 1, file), 1);
+        fclose(file);
+
+        // Only the corrupted record is dropped, the key can be created anew behind the intact ones
+        EXPECT_EQ(PersistentSession("test-b", false, hmac), false);
+        EXPECT_NE(PersistentSession("test-a", false, hmac), false);
+        EXPECT_EQ(memcmp(hmac, hmacA, sizeof(hmac)), 0);
+        EXPECT_NE(PersistentSession("test-b", true, hmacB), false);
+        EXPECT_NE(PersistentSession("test-b", false, hmac), false);
+        EXPECT_EQ(memcmp(hmac, hmacB, sizeof(hmac)), 0);
+    }
+
+    unlink(keyStore);
+}
+
 /*
   ===================================
     HASH
@@ -245,6 +393,17 @@ static void TestHash(const char *name, const hash_type type, const uint8_t data[
     } else {
         printf("  FATAL: Failed to create signing implementation, hash %s test will be skipped\n", name);
     }
+
+    printf("> Testing hash %s (single call)\n", name);
+    {
+        uint8_t* output = static_cast<uint8_t*>(malloc(expectedLength));
+        memset(output, 0, expectedLength);
+        EXPECT_EQ(hash_digest(type, length, data, 0, output), 0);
+        EXPECT_EQ(hash_digest(type, length, data, expectedLength, output), expectedLength);
+        DumpBuffer(output, expectedLength);
+        EXPECT_EQ(memcmp(output, expected, expectedLength), 0);
+        free(output);
+    }
 }
 
 static void TestHMAC(const char *name, const hash_type type, const uint32_t secret, const uint8_t data[], const uint16_t length, const uint8_t expected[], const uint16_t expectedLength)
@@ -294,6 +453,16 @@ static void TestHMAC(const char *name, const hash_type type, const uint32_t secr
         printf("  FATAL: Failed to create signing implementation, HMAC %s test will be skipped\n", name);
     }
 
+    printf("> Testing HMAC %s (single call)\n", name);
+    {
+        uint8_t* output = static_cast<uint8_t*>(malloc(128));
+        memset(output, 0, 128);
+        EXPECT_EQ(hash_hmac(vault, type, secret, length, data, 0, output), 0);
+        EXPECT_EQ(hash_hmac(vault, type, secret, length, data, 128, output), expectedLength);
+        DumpBuffer(output, expectedLength);
+        EXPECT_EQ(memcmp(output, expected, expectedLength), 0);
+        free(output);
+    }
 }
 
 TEST(Signing, Hash)
@@ -375,6 +544,176 @@ TEST(Signing, HMAC)
     }
 }
 
+TEST(Signing, ResetCopy)
+{
+    const uint8_t data[] = "Etaoin Shrldu";
+    const uint8_t password[] = "Thunder";
+    const uint16_t length = (sizeof(data) - 1);
+
+    const uint8_t hmac_sha256[] = { 0x2D, 0xF5, 0x9C, 0xBE, 0x61, 0x59, 0x7F, 0x14, 0xEC, 0xD2, 0x85, 0x6F,
+                                    0xAB, 0xF1, 0x12, 0xFC, 0xF4, 0x68, 0x6D, 0xFE, 0x93, 0x5F, 0xDB, 0xB7,
+                                    0x34, 0x8C, 0x6C, 0x6B, 0xF1, 0x64, 0xE9, 0x27 };
+
+    uint32_t secret = vault_import(vault, (sizeof(password) - 1), password);
+    if (secret != 0) {
+        struct HashImplementation* hash = hash_create_hmac(vault, HASH_TYPE_SHA256, secret);
+
+        if (hash != NULL) {
+            uint8_t output[sizeof(hmac_sha256)];
+
+            printf("> Testing HMAC SHA256 (reset)\n");
+            EXPECT_EQ(hash_ingest(hash, length, data), length);
+            EXPECT_EQ(hash_reset(hash), 0);
+            EXPECT_EQ(hash_ingest(hash, length, data), length);
+            memset(output, 0, sizeof(output));
+            EXPECT_EQ(hash_calculate(hash, sizeof(output), output), sizeof(output));
+            EXPECT_EQ(memcmp(output, hmac_sha256, sizeof(output)), 0);
+
+            EXPECT_EQ(hash_reset(hash), 0);
+            EXPECT_EQ(hash_ingest(hash, length, data), length);
+            memset(output, 0, sizeof(output));
+            EXPECT_EQ(hash_calculate(hash, sizeof(output), output), sizeof(output));
+            EXPECT_EQ(memcmp(output, hmac_sha256, sizeof(output)), 0);
+
+            printf("> Testing HMAC SHA256 (copy)\n");
+            EXPECT_EQ(hash_reset(hash), 0);
+            EXPECT_EQ(hash_ingest(hash, length/2, data), length/2);
+
+            struct HashImplementation* copy = hash_copy(hash);
+
+            if (copy != NULL) {
+                EXPECT_EQ(hash_ingest(copy, (length - length/2), data + length/2), (length - length/2));
+                memset(output, 0, sizeof(output));
+                EXPECT_EQ(hash_calculate(copy, sizeof(output), output), sizeof(output));
+                EXPECT_EQ(memcmp(output, hmac_sha256, sizeof(output)), 0);
+                hash_destroy(copy);
+            } else {
+                printf("  Copying a running HMAC calculation is not supported by this implementation\n");
+            }
+
+            EXPECT_EQ(hash_ingest(hash, (length - length/2), data + length/2), (length - length/2));
+            memset(output, 0, sizeof(output));
+            EXPECT_EQ(hash_calculate(hash, sizeof(output), output), sizeof(output));
+            EXPECT_EQ(memcmp(output, hmac_sha256, sizeof(output)), 0);
+
+            hash_destroy(hash);
+        } else {
+            printf("  FATAL: Failed to create signing implementation, reset/copy tests will be skipped\n");
+        }
+
+        EXPECT_EQ(vault_delete(vault, secret), true);
+    } else {
+        printf("FATAL: Failed to store secret into vault, reset/copy tests are skipped\n");
+    }
+}
+
+TEST(Signing, HMACBatch)
+{
+    const uint8_t data[] = "Etaoin ShrlduLook behind you, a Three-Headed Monkey!Thunder";
+    const uint32_t lengths[] = { 13, 39, 0, 7 };
+    const uint16_t count = (sizeof(lengths) / sizeof(lengths[0]));
+    const uint8_t password[] = "Thunder";
+
+    uint32_t secret = vault_import(vault, (sizeof(password) - 1), password);
+    if (secret != 0) {
+        uint8_t output[count * HASH_TYPE_SHA256];
+        uint8_t expected[HASH_TYPE_SHA256];
+        uint32_t offset = 0;
+
+        printf("> Testing HMAC SHA256 (batch)\n");
+        memset(output, 0, sizeof(output));
+        EXPECT_EQ(hash_hmac_batch(vault, HASH_TYPE_SHA256, secret, count, lengths, data, (sizeof(output) - 1), output), (count - 1));
+        EXPECT_EQ(hash_hmac_batch(vault, HASH_TYPE_SHA256, secret, count, lengths, data, sizeof(output), output), count);
+
+        for (uint16_t index = 0; index < count; index++) {
+            memset(expected, 0, sizeof(expected));
+            EXPECT_EQ(hash_hmac(vault, HASH_TYPE_SHA256, secret, lengths[index], data + offset, sizeof(expected), expected), sizeof(expected));
+            EXPECT_EQ(memcmp(output + (index * HASH_TYPE_SHA256), expected, sizeof(expected)), 0);
+            offset += lengths[index];
+        }
+
+        EXPECT_EQ(vault_delete(vault, secret), true);
+    } else {
+        printf("FATAL: Failed to store secret into vault, HMAC batch tests are skipped\n");
+    }
+}
+
+/* The multi-buffer kernel of the Thunder backend, built into the tests on its own and checked against OpenSSL */
+TEST(Signing, HMACMultiBuffer)
+{
+    // RFC 4231, test case 2
+    const uint8_t key[] = "Jefe";
+    const uint8_t message[] = "what do ya want for nothing?";
+    const uint8_t expected[] = {
+        0x5b, 0xdc, 0xc1, 0x46, 0xbf, 0x60, 0x75, 0x4e, 0x6a, 0x04, 0x24, 0x26, 0x08, 0x95, 0x75, 0xc7,
+        0x5a, 0x00, 0x3f, 0x08, 0x9d, 0x27, 0x39, 0x83, 0x9d, 0xec, 0x58, 0xb9, 0x64, 0xec, 0x38, 0x43
+    };
+
+    // Messages around the padding boundaries, and more of them than the kernel has lanes or takes per pass
+    const uint32_t sizes[] = { 0, 1, 55, 56, 63, 64, 65, 119, 120, 128, 300 };
+    const uint16_t count = 70;
+
+    uint8_t data[count * 300];
+    uint8_t longKey[100];
+    uint32_t lengths[count] = { (sizeof(message) - 1) };
+    uint8_t output[count * HASH_TYPE_SHA256];
+
+    printf("> Testing HMAC SHA256 (multi-buffer batch)\n");
+
+    uint32_t secret = vault_import(vault, (sizeof(key) - 1), key);
+    EXPECT_NE(secret, 0);
+    if (secret != 0) {
+        EXPECT_EQ(hash_hmac_batch(vault, HASH_TYPE_SHA256, secret, 1, lengths, message, sizeof(output), output), 1);
+        EXPECT_EQ(memcmp(output, expected, sizeof(expected)), 0);
+        EXPECT_EQ(vault_delete(vault, secret), true);
+    }
+
+    for (uint16_t index = 0; index < sizeof(longKey); index++) {
+        longKey[index] = static_cast<uint8_t>(index ^ 0x5A);
+    }
+
+    uint32_t total = 0;
+    for (uint16_t index = 0; index < count; index++) {
+        lengths[index] = sizes[index % (sizeof(sizes) / sizeof(sizes[0]))];
+        for (uint32_t position = 0; position < lengths[index]; position++) {
+            data[total + position] = static_cast<uint8_t>((index + position) * 7);
+        }
+        total += lengths[index];
+    }
+
+    const uint32_t keyLengths[] = { sizeof(key) - 1, sizeof(longKey) };
+    const uint8_t* keys[] = { key, longKey };
+
+    for (uint8_t k = 0; k < 2; k++) {
+        secret = vault_import(vault, keyLengths[k], keys[k]);
+        EXPECT_NE(secret, 0);
+
+        if (secret != 0) {
+            uint32_t failed = 0;
+            uint32_t offset = 0;
+
+            memset(output, 0, sizeof(output));
+            EXPECT_EQ(hash_hmac_batch(vault, HASH_TYPE_SHA256, secret, count, lengths, data, sizeof(output), output), count);
+
+            for (uint16_t index = 0; index < count; index++) {
+                uint8_t reference[HASH_TYPE_SHA256];
+                unsigned int referenceLength = sizeof(reference);
+
+                HMAC(EVP_sha256(), keys[k], keyLengths[k], (data + offset), lengths[index], reference, &referenceLength);
+
+                if (memcmp(output + (index * HASH_TYPE_SHA256), reference, sizeof(reference)) != 0) {
+                    failed++;
+                }
+
+                offset += lengths[index];
+            }
+
+            EXPECT_EQ(failed, 0);
+            EXPECT_EQ(vault_delete(vault, secret), true);
+        }
+    }
+}
+
 /*
   ===================================
     CIPHER
@@ -451,6 +790,8 @@ TEST(DH, DeriveStandard)
     uint32_t publicKeyId = 0;
     uint32_t peerPublicKeyId = 0;
     uint32_t secretId = 0;
+    uint8_t firstPublicKey[sizeof(testPrime1024)];
+    uint16_t firstPublicKeySize = 0;
 
     DH* dh = DHGenerate(testGenerator, testPrime1024, sizeof(testPrime1024));
     assert(dh != NULL);
@@ -474,58 +815,142 @@ TEST(DH, DeriveStandard)
         EXPECT_GT(peerPublicKeyId, 0x80000000U);
         EXPECT_EQ(vault_size(vault, peerPublicKeyId), peerPublicKeySize);
 
-        EXPECT_EQ(diffiehellman_generate(vault, testGenerator, sizeof(testPrime1024), testPrime1024, &privateKeyId, &publicKeyId), 0);
-        EXPECT_GT(privateKeyId, 0x80000000U);
-        EXPECT_GT(publicKeyId, 0x80000000U);
-        EXPECT_NE(privateKeyId, publicKeyId);
-
-        if (privateKeyId != 0) {
-            uint16_t publicKeySize = 0;
-            EXPECT_NE(publicKeySize = vault_size(vault, publicKeyId), 0);
-            EXPECT_NE(publicKeySize = vault_size(vault, publicKeyId), USHRT_MAX);
-            uint8_t* publicKeyBuf = (uint8_t*) alloca(publicKeySize);
-            EXPECT_EQ(vault_export(vault, publicKeyId, publicKeySize, publicKeyBuf), publicKeySize);
-            printf("TEE public key:\n");
-            DumpBuffer(publicKeyBuf, publicKeySize);
-
-            EXPECT_EQ(diffiehellman_derive(vault, privateKeyId, peerPublicKeyId, &secretId), 0);
-            EXPECT_GT(secretId, 0x80000000L);
-            EXPECT_EQ(vault_size(vault, secretId), USHRT_MAX);
-
-            BIGNUM *publicKeyBn = BN_bin2bn(publicKeyBuf, publicKeySize, NULL);
-            assert(publicKeyBn != NULL);
-            uint8_t* peerSecret = DHDerive(dh, publicKeyBn);
-
-            // Verify secret by calculating a HMAC of a common buffer
-            uint8_t teeHmac[SHA256_DIGEST_LENGTH] = { 0 };
-            uint8_t hostHmac[SHA256_DIGEST_LENGTH] = { 0 };
-            const char testStr[] = "Thunder";
-
-            HMAC(EVP_sha256(), peerSecret, sizeof(testPrime1024), (uint8_t*)testStr, sizeof(testStr), hostHmac, NULL);
-            printf("Host HMAC:\n");
-            DumpBuffer(hostHmac, sizeof(hostHmac));
-
-            struct HashImplementation* himp = hash_create_hmac(vault, HASH_TYPE_SHA256, secretId);
-            EXPECT_NE(himp, NULL);
-            if (himp) {
-                EXPECT_EQ(hash_ingest(himp, sizeof(testStr), (uint8_t*)testStr), sizeof(testStr));
-                EXPECT_EQ(hash_calculate(himp, sizeof(teeHmac), teeHmac), sizeof(teeHmac));
-                hash_destroy(himp);
-                himp = NULL;
-
-                printf("TEE HMAC:\n");
-                DumpBuffer(teeHmac, sizeof(teeHmac));
+        // Twice on the same group: the first round sets it up, the second takes a pregenerated key pair
+        for (uint8_t round = 0; round < 2; round++) {
+            if (round == 1) {
+                // Give the pool a moment to be filled
+                usleep(200 * 1000);
             }
 
-            EXPECT_EQ(memcmp(teeHmac, hostHmac, SHA256_DIGEST_LENGTH), 0);
-
-            BN_free(publicKeyBn);
+            printf("> Round %i\n", (round + 1));
+
+            EXPECT_EQ(diffiehellman_generate(vault, testGenerator, sizeof(testPrime1024), testPrime1024, &privateKeyId, &publicKeyId), 0);
+            EXPECT_GT(privateKeyId, 0x80000000U);
+            EXPECT_GT(publicKeyId, 0x80000000U);
+            EXPECT_NE(privateKeyId, publicKeyId);
+
+            if (privateKeyId != 0) {
+                uint16_t publicKeySize = 0;
+                EXPECT_NE(publicKeySize = vault_size(vault, publicKeyId), 0);
+                EXPECT_NE(publicKeySize = vault_size(vault, publicKeyId), USHRT_MAX);
+                uint8_t* publicKeyBuf = (uint8_t*) alloca(publicKeySize);
+                EXPECT_EQ(vault_export(vault, publicKeyId, publicKeySize, publicKeyBuf), publicKeySize);
+                printf("TEE public key:\n");
+                DumpBuffer(publicKeyBuf, publicKeySize);
+
+                // The second key pair comes from the pool, it shall not be the first one handed out again
+                if (round == 0) {
+                    firstPublicKeySize = MIN(publicKeySize, sizeof(firstPublicKey));
+                    memcpy(firstPublicKey, publicKeyBuf, firstPublicKeySize);
+                } else {
+                    EXPECT_EQ(((publicKeySize == firstPublicKeySize) && (memcmp(publicKeyBuf, firstPublicKey, publicKeySize) == 0)), false);
+                }
+
+                EXPECT_EQ(diffiehellman_derive(vault, privateKeyId, peerPublicKeyId, &secretId), 0);
+                EXPECT_GT(secretId, 0x80000000L);
+                EXPECT_EQ(vault_size(vault, secretId), USHRT_MAX);
+
+                BIGNUM *publicKeyBn = BN_bin2bn(publicKeyBuf, publicKeySize, NULL);
+                assert(publicKeyBn != NULL);
+                uint8_t* peerSecret = DHDerive(dh, publicKeyBn);
+
+                // Verify secret by calculating a HMAC of a common buffer
+                uint8_t teeHmac[SHA256_DIGEST_LENGTH] = { 0 };
+                uint8_t hostHmac[SHA256_DIGEST_LENGTH] = { 0 };
+                const char testStr[] = "Thunder";
+
+                HMAC(EVP_sha256(), peerSecret, sizeof(testPrime1024), (uint8_t*)testStr, sizeof(testStr), hostHmac, NULL);
+                printf("Host HMAC:\n");
+                DumpBuffer(hostHmac, sizeof(hostHmac));
+
+                struct HashImplementation* himp = hash_create_hmac(vault, HASH_TYPE_SHA256, secretId);
+                EXPECT_NE(himp, NULL);
+                if (himp) {
+                    EXPECT_EQ(hash_ingest(himp, sizeof(testStr), (uint8_t*)testStr), sizeof(testStr));
+                    EXPECT_EQ(hash_calculate(himp, sizeof(teeHmac), teeHmac), sizeof(teeHmac));
+                    hash_destroy(himp);
+                    himp = NULL;
+
+                    printf("TEE HMAC:\n");
+                    DumpBuffer(teeHmac, sizeof(teeHmac));
+                }
+
+                EXPECT_EQ(memcmp(teeHmac, hostHmac, SHA256_DIGEST_LENGTH), 0);
+
+                BN_free(publicKeyBn);
+            }
         }
 
         DH_free(dh);
     }
 }
 
+static void TestKeyAgreement(const char* name, const key_agreement_curve curve, const uint16_t expectedPublicKeySize)
+{
+    uint32_t alicePrivateKeyId = 0;
+    uint32_t alicePublicKeyId = 0;
+    uint32_t bobPrivateKeyId = 0;
+    uint32_t bobPublicKeyId = 0;
+    uint32_t aliceSecretId = 0;
+    uint32_t bobSecretId = 0;
+
+    printf("> Testing %s key agreement\n", name);
+
+    EXPECT_EQ(keyagreement_generate(vault, curve, &alicePrivateKeyId, &alicePublicKeyId), 0);
+    EXPECT_EQ(keyagreement_generate(vault, curve, &bobPrivateKeyId, &bobPublicKeyId), 0);
+
+    EXPECT_EQ(vault_size(vault, alicePrivateKeyId), USHRT_MAX);
+    EXPECT_EQ(vault_size(vault, alicePublicKeyId), expectedPublicKeySize);
+    EXPECT_EQ(vault_size(vault, bobPublicKeyId), expectedPublicKeySize);
+
+    EXPECT_EQ(keyagreement_derive(vault, alicePrivateKeyId, bobPublicKeyId, &aliceSecretId), 0);
+    EXPECT_EQ(keyagreement_derive(vault, bobPrivateKeyId, alicePublicKeyId, &bobSecretId), 0);
+    EXPECT_NE(aliceSecretId, bobSecretId);
+    EXPECT_EQ(vault_size(vault, aliceSecretId), USHRT_MAX);
+
+    // Both sides shall end up with the same secret, verify by calculating a HMAC of a common buffer
+    uint8_t aliceHmac[SHA256_DIGEST_LENGTH] = { 0 };
+    uint8_t bobHmac[SHA256_DIGEST_LENGTH] = { 0 };
+    const char testStr[] = "Thunder";
+
+    EXPECT_EQ(hash_hmac(vault, HASH_TYPE_SHA256, aliceSecretId, sizeof(testStr), (uint8_t*)testStr, sizeof(aliceHmac), aliceHmac), sizeof(aliceHmac));
+    EXPECT_EQ(hash_hmac(vault, HASH_TYPE_SHA256, bobSecretId, sizeof(testStr), (uint8_t*)testStr, sizeof(bobHmac), bobHmac), sizeof(bobHmac));
+    DumpBuffer(aliceHmac, sizeof(aliceHmac));
+    EXPECT_EQ(memcmp(aliceHmac, bobHmac, SHA256_DIGEST_LENGTH), 0);
+
+    // A public key is not a private key
+    uint32_t secretId = 0;
+    EXPECT_NE(keyagreement_derive(vault, alicePublicKeyId, bobPublicKeyId, &secretId), 0);
+    EXPECT_EQ(secretId, 0);
+
+    // Nor is any other blob that happens to start with a curve
+    uint8_t blob[1 + 32];
+    memset(blob, 0x5A, sizeof(blob));
+    blob[0] = curve;
+    uint32_t blobId = vault_import(vault, sizeof(blob), blob);
+    EXPECT_NE(blobId, 0);
+    EXPECT_NE(keyagreement_derive(vault, blobId, bobPublicKeyId, &secretId), 0);
+    EXPECT_EQ(secretId, 0);
+    vault_delete(vault, blobId);
+
+    vault_delete(vault, alicePrivateKeyId);
+    vault_delete(vault, alicePublicKeyId);
+    vault_delete(vault, bobPrivateKeyId);
+    vault_delete(vault, bobPublicKeyId);
+    vault_delete(vault, aliceSecretId);
+    vault_delete(vault, bobSecretId);
+}
+
+TEST(KeyAgreement, X25519)
+{
+    TestKeyAgreement("X25519", KEY_AGREEMENT_CURVE_X25519, 32);
+}
+
+TEST(KeyAgreement, P256)
+{
+    TestKeyAgreement("P-256", KEY_AGREEMENT_CURVE_P256, 65);
+}
+
 static void TestCryptAES(const char *name, const aes_mode mode, const uint32_t key,
                          const uint8_t iv[], const uint16_t ivLength,
                          const uint8_t data[], const uint16_t length,
@@ -702,12 +1127,310 @@ TEST(Cipher, AES_Unpadded)
     }
 }
 
+TEST(Cipher, DeletedKey)
+{
+    const uint8_t data[] = "0123456789abcdef";
+    const uint16_t length = (sizeof(data) - 1);
+    const uint8_t iv[16] = { 0 };
+    const uint8_t key[16] = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff, 0x11 };
+    uint8_t output[64];
+
+    uint32_t keyId = vault_import(vault, sizeof(key), key);
+    EXPECT_NE(keyId, 0);
+    if (keyId != 0) {
+        struct CipherImplementation* cipher = cipher_create_aes(vault, AES_MODE_CTR, keyId);
+        struct HashImplementation* hmac = hash_create_hmac(vault, HASH_TYPE_SHA256, keyId);
+        EXPECT_NE(cipher, NULL);
+        EXPECT_NE(hmac, NULL);
+
+        if ((cipher != NULL) && (hmac != NULL)) {
+            EXPECT_EQ(cipher_encrypt(cipher, sizeof(iv), iv, length, data, sizeof(output), output), length);
+            EXPECT_EQ(hash_ingest(hmac, length, data), length);
+
+            /* Operations created before the key got deleted must not keep using it */
+            EXPECT_NE(vault_delete(vault, keyId), false);
+            EXPECT_LE(cipher_encrypt(cipher, sizeof(iv), iv, length, data, sizeof(output), output), 0);
+            EXPECT_EQ(hash_calculate(hmac, sizeof(output), output), 0);
+            EXPECT_NE(hash_reset(hmac), 0);
+        } else {
+            vault_delete(vault, keyId);
+        }
+
+        if (cipher != NULL) {
+            cipher_destroy(cipher);
+        }
+        if (hmac != NULL) {
+            hash_destroy(hmac);
+        }
+    }
+}
+
+static void TestCryptAEAD(const char* name, const aead_mode mode, const uint32_t key,
+                          const uint8_t data[], const uint16_t length,
+                          const uint8_t expected[], const uint8_t expectedTag[])
+{
+    const uint8_t iv[12] = { 0 };
+    const uint8_t aad[] = "Thunder";
+
+    printf("> Testing %s encryption\n", name);
+    struct CipherImplementation* cipher = cipher_create_aead(vault, mode, key);
+    EXPECT_NE(cipher, NULL);
+
+    if (cipher != NULL) {
+        uint8_t* output = static_cast<uint8_t*>(malloc(length));
+        uint8_t* input = static_cast<uint8_t*>(malloc(length));
+        uint8_t tag[16];
+
+        EXPECT_EQ(cipher_aead_encrypt(cipher, sizeof(iv), iv, 0, NULL, length, data, length, output, sizeof(tag), tag), length);
+        DumpBuffer(output, length);
+        DumpBuffer(tag, sizeof(tag));
+
+        if (expected != NULL) {
+            EXPECT_EQ(memcmp(output, expected, length), 0);
+            EXPECT_EQ(memcmp(tag, expectedTag, sizeof(tag)), 0);
+        }
+
+        EXPECT_EQ(cipher_aead_decrypt(cipher, sizeof(iv), iv, 0, NULL, length, output, length, input, sizeof(tag), tag), length);
+        EXPECT_EQ(memcmp(input, data, length), 0);
+
+        // The additional data is part of the tag
+        EXPECT_EQ(cipher_aead_encrypt(cipher, sizeof(iv), iv, sizeof(aad), aad, length, data, length, output, sizeof(tag), tag), length);
+        EXPECT_EQ(cipher_aead_decrypt(cipher, sizeof(iv), iv, 0, NULL, length, output, length, input, sizeof(tag), tag), 0);
+        EXPECT_EQ(cipher_aead_decrypt(cipher, sizeof(iv), iv, sizeof(aad), aad, length, output, length, input, sizeof(tag), tag), length);
+
+        // A tampered message is rejected
+        output[0] ^= 0x01;
+        EXPECT_EQ(cipher_aead_decrypt(cipher, sizeof(iv), iv, sizeof(aad), aad, length, output, length, input, sizeof(tag), tag), 0);
+
+        // An empty plaintext is refused, a tampered tag on it can not pass for a success
+        EXPECT_EQ(cipher_aead_encrypt(cipher, sizeof(iv), iv, sizeof(aad), aad, 0, data, length, output, sizeof(tag), tag), 0);
+        tag[0] ^= 0x01;
+        EXPECT_EQ(cipher_aead_decrypt(cipher, sizeof(iv), iv, sizeof(aad), aad, 0, output, length, input, sizeof(tag), tag), 0);
+
+        free(input);
+        free(output);
+        cipher_destroy(cipher);
+    }
+}
+
+static bool ReferenceAES(const EVP_CIPHER* type, const bool encrypt, const uint8_t key[], const uint8_t iv[],
+                         const uint32_t length, const uint8_t input[], uint8_t output[], int* outputLength)
+{
+    EVP_CIPHER_CTX* context = EVP_CIPHER_CTX_new();
+    int len = 0;
+    int final = 0;
+
+    bool result = (context != NULL)
+        && (EVP_CipherInit_ex(context, type, NULL, key, iv, (encrypt ? 1 : 0)) == 1)
+        && (EVP_CipherUpdate(context, output, &len, input, length) == 1)
+        && (EVP_CipherFinal_ex(context, (output + len), &final) == 1);
+
+    EVP_CIPHER_CTX_free(context);
+    (*outputLength) = (len + final);
+
+    return (result);
+}
+
+/* Inputs large enough to be split over the worker pool (main() lowers the threshold), checked against a single OpenSSL pass */
+TEST(Cipher, AES_Parallel)
+{
+    const uint8_t key128[] = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff, 0x11 };
+    // The counter carries over into the upper half of the block halfway through the input
+    const uint8_t iv[] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xd0, 0x00 };
+    const uint32_t sizes[] = { 300000, 300005, 131072 + 16 + 1 };
+
+    uint32_t key128Id = vault_import(vault, sizeof(key128), key128);
+    EXPECT_NE(key128Id, 0);
+
+    if (key128Id != 0) {
+        const uint32_t bufferSize = 300032;
+        uint8_t* data = static_cast<uint8_t*>(malloc(bufferSize));
+        uint8_t* output = static_cast<uint8_t*>(malloc(bufferSize));
+        uint8_t* expected = static_cast<uint8_t*>(malloc(bufferSize));
+        uint8_t* check = static_cast<uint8_t*>(malloc(bufferSize));
+
+        for (uint32_t index = 0; index < bufferSize; index++) {
+            data[index] = static_cast<uint8_t>((index * 31) + (index >> 8));
+        }
+
+        struct CipherImplementation* ecb = cipher_create_aes(vault, AES_MODE_ECB, key128Id);
+        struct CipherImplementation* ctr = cipher_create_aes(vault, AES_MODE_CTR, key128Id);
+        EXPECT_NE(ecb, NULL);
+        EXPECT_NE(ctr, NULL);
+
+        for (uint8_t index = 0; (ecb != NULL) && (ctr != NULL) && (index < (sizeof(sizes) / sizeof(sizes[0]))); index++) {
+            const uint32_t size = sizes[index];
+            int expectedLength = 0;
+
+            printf("> Testing split 128-bit AES/ECB and AES/CTR of %u bytes\n", size);
+
+            // ECB pads, an exact multiple of the block size gets a full block of padding
+            EXPECT_EQ(ReferenceAES(EVP_aes_128_ecb(), true, key128, NULL, size, data, expected, &expectedLength), true);
+            EXPECT_EQ(cipher_encrypt(ecb, sizeof(iv), iv, size, data, bufferSize, output), expectedLength);
+            EXPECT_EQ(memcmp(output, expected, expectedLength), 0);
+            EXPECT_EQ(cipher_decrypt(ecb, sizeof(iv), iv, expectedLength, output, bufferSize, check), size);
+            EXPECT_EQ(memcmp(check, data, size), 0);
+
+            // CTR, the last block is a partial one for the odd sizes
+            EXPECT_EQ(ReferenceAES(EVP_aes_128_ctr(), true, key128, iv, size, data, expected, &expectedLength), true);
+            EXPECT_EQ(expectedLength, size);
+            EXPECT_EQ(cipher_encrypt(ctr, sizeof(iv), iv, size, data, bufferSize, output), size);
+            EXPECT_EQ(memcmp(output, expected, size), 0);
+            EXPECT_EQ(cipher_decrypt(ctr, sizeof(iv), iv, size, output, bufferSize, check), size);
+            EXPECT_EQ(memcmp(check, data, size), 0);
+        }
+
+        if (ecb != NULL) {
+            cipher_destroy(ecb);
+        }
+        if (ctr != NULL) {
+            cipher_destroy(ctr);
+        }
+
+        free(check);
+        free(expected);
+        free(output);
+        free(data);
+
+        EXPECT_NE(vault_delete(vault, key128Id), false);
+    }
+}
+
+/* The AES instruction kernels of the Thunder backend, built into the tests on its own, NIST SP 800-38A vectors */
+TEST(Cipher, AESAccelerated)
+{
+    const uint8_t key128[] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
+    const uint8_t key256[] = { 0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe, 0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81,
+                               0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7, 0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4 };
+    const uint8_t plain[] = {
+        0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+        0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+        0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+        0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10
+    };
+    const uint8_t ecb128[] = {
+        0x3a, 0xd7, 0x7b, 0xb4, 0x0d, 0x7a, 0x36, 0x60, 0xa8, 0x9e, 0xca, 0xf3, 0x24, 0x66, 0xef, 0x97,
+        0xf5, 0xd3, 0xd5, 0x85, 0x03, 0xb9, 0x69, 0x9d, 0xe7, 0x85, 0x89, 0x5a, 0x96, 0xfd, 0xba, 0xaf,
+        0x43, 0xb1, 0xcd, 0x7f, 0x59, 0x8e, 0xce, 0x23, 0x88, 0x1b, 0x00, 0xe3, 0xed, 0x03, 0x06, 0x88,
+        0x7b, 0x0c, 0x78, 0x5e, 0x27, 0xe8, 0xad, 0x3f, 0x82, 0x23, 0x20, 0x71, 0x04, 0x72, 0x5d, 0xd4
+    };
+    const uint8_t ecb256[] = {
+        0xf3, 0xee, 0xd1, 0xbd, 0xb5, 0xd2, 0xa0, 0x3c, 0x06, 0x4b, 0x5a, 0x7e, 0x3d, 0xb1, 0x81, 0xf8,
+        0x59, 0x1c, 0xcb, 0x10, 0xd4, 0x10, 0xed, 0x26, 0xdc, 0x5b, 0xa7, 0x4a, 0x31, 0x36, 0x28, 0x70,
+        0xb6, 0xed, 0x21, 0xb9, 0x9c, 0xa6, 0xf4, 0xf9, 0xf1, 0x53, 0xe7, 0xb1, 0xbe, 0xaf, 0xed, 0x1d,
+        0x23, 0x30, 0x4b, 0x7a, 0x39, 0xf9, 0xf3, 0xff, 0x06, 0x7d, 0x8d, 0x8f, 0x9e, 0x24, 0xec, 0xc7
+    };
+    const uint8_t cbcIV[] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
+    const uint8_t cbc128[] = {
+        0x76, 0x49, 0xab, 0xac, 0x81, 0x19, 0xb2, 0x46, 0xce, 0xe9, 0x8e, 0x9b, 0x12, 0xe9, 0x19, 0x7d,
+        0x50, 0x86, 0xcb, 0x9b, 0x50, 0x72, 0x19, 0xee, 0x95, 0xdb, 0x11, 0x3a, 0x91, 0x76, 0x78, 0xb2,
+        0x73, 0xbe, 0xd6, 0xb8, 0xe3, 0xc1, 0x74, 0x3b, 0x71, 0x16, 0xe6, 0x9e, 0x22, 0x22, 0x95, 0x16,
+        0x3f, 0xf1, 0xca, 0xa1, 0x68, 0x1f, 0xac, 0x09, 0x12, 0x0e, 0xca, 0x30, 0x75, 0x86, 0xe1, 0xa7
+    };
+    const uint8_t ctrCounter[] = { 0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff };
+    const uint8_t ctrCounterNext[] = { 0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xff, 0x03 };
+    const uint8_t ctr128[] = {
+        0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26, 0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce,
+        0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70, 0xfd, 0xff, 0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff,
+        0x5a, 0xe4, 0xdf, 0x3e, 0xdb, 0xd5, 0xd3, 0x5e, 0x5b, 0x4f, 0x09, 0x02, 0x0d, 0xb0, 0x3e, 0xab,
+        0x1e, 0x03, 0x1d, 0xda, 0x2f, 0xbe, 0x03, 0xd1, 0x79, 0x21, 0x70, 0xa0, 0xf3, 0x00, 0x9c, 0xee
+    };
+
+    if (Implementation::AESAccelerated::Available() == false) {
+        printf("> AES instructions not available, skipped\n");
+    } else {
+        Implementation::AESAccelerated::Key prepared;
+        uint8_t output[sizeof(plain)];
+        uint8_t check[sizeof(plain)];
+        uint8_t chain[16];
+
+        EXPECT_EQ(Implementation::AESAccelerated::Prepare(15, key128, prepared), false);
+
+        printf("> Testing accelerated 128-bit AES/ECB\n");
+        EXPECT_EQ(Implementation::AESAccelerated::Prepare(sizeof(key128), key128, prepared), true);
+        Implementation::AESAccelerated::ECB(prepared, true, sizeof(plain), plain, output);
+        EXPECT_EQ(memcmp(output, ecb128, sizeof(output)), 0);
+        Implementation::AESAccelerated::ECB(prepared, false, sizeof(output), output, check);
+        EXPECT_EQ(memcmp(check, plain, sizeof(check)), 0);
+
+        printf("> Testing accelerated 128-bit AES/CBC\n");
+        memcpy(chain, cbcIV, sizeof(chain));
+        Implementation::AESAccelerated::CBC(prepared, true, chain, sizeof(plain), plain, output);
+        EXPECT_EQ(memcmp(output, cbc128, sizeof(output)), 0);
+        EXPECT_EQ(memcmp(chain, (cbc128 + sizeof(cbc128) - sizeof(chain)), sizeof(chain)), 0);
+        memcpy(chain, cbcIV, sizeof(chain));
+        Implementation::AESAccelerated::CBC(prepared, false, chain, sizeof(output), output, check);
+        EXPECT_EQ(memcmp(check, plain, sizeof(check)), 0);
+
+        printf("> Testing accelerated 128-bit AES/CTR\n");
+        memcpy(chain, ctrCounter, sizeof(chain));
+        Implementation::AESAccelerated::CTR(prepared, chain, sizeof(plain), plain, output);
+        EXPECT_EQ(memcmp(output, ctr128, sizeof(output)), 0);
+        EXPECT_EQ(memcmp(chain, ctrCounterNext, sizeof(chain)), 0);
+
+        // A partial last block
+        memcpy(chain, ctrCounter, sizeof(chain));
+        memset(output, 0, sizeof(output));
+        Implementation::AESAccelerated::CTR(prepared, chain, (sizeof(plain) - 5), plain, output);
+        EXPECT_EQ(memcmp(output, ctr128, (sizeof(output) - 5)), 0);
+        EXPECT_EQ(output[sizeof(output) - 5], 0);
+
+        printf("> Testing accelerated 256-bit AES/ECB\n");
+        EXPECT_EQ(Implementation::AESAccelerated::Prepare(sizeof(key256), key256, prepared), true);
+        Implementation::AESAccelerated::ECB(prepared, true, sizeof(plain), plain, output);
+        EXPECT_EQ(memcmp(output, ecb256, sizeof(output)), 0);
+        Implementation::AESAccelerated::ECB(prepared, false, sizeof(output), output, check);
+        EXPECT_EQ(memcmp(check, plain, sizeof(check)), 0);
+    }
+}
+
+TEST(Cipher, AEAD)
+{
+    // NIST GCM specification, test case 2
+    const uint8_t key128[16] = { 0 };
+    const uint8_t data[16] = { 0 };
+    const uint8_t expected_AES_GCM_128[] = {
+        0x03, 0x88, 0xda, 0xce, 0x60, 0xb6, 0xa3, 0x92, 0xf3, 0x28, 0xc2, 0xb9, 0x71, 0xb2, 0xfe, 0x78
+    };
+    const uint8_t expectedTag_AES_GCM_128[] = {
+        0xab, 0x6e, 0x47, 0xd4, 0x2c, 0xec, 0x13, 0xbd, 0xf5, 0x3a, 0x67, 0xb2, 0x12, 0x57, 0xbd, 0xdf
+    };
+
+    const uint8_t key256[32] = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff, 0x11,
+                                 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff, 0x11 };
+    const uint8_t message[] = "Look behind you, a Three-Headed Monkey!";
+
+    uint32_t key128Id = vault_import(vault, sizeof(key128), key128);
+    uint32_t key256Id = vault_import(vault, sizeof(key256), key256);
+    EXPECT_NE(key128Id, 0);
+    EXPECT_NE(key256Id, 0);
+
+    if ((key128Id != 0) && (key256Id != 0)) {
+        TestCryptAEAD("128-bit AES/GCM", AEAD_MODE_AES_GCM, key128Id, data, sizeof(data), expected_AES_GCM_128, expectedTag_AES_GCM_128);
+        TestCryptAEAD("256-bit AES/GCM", AEAD_MODE_AES_GCM, key256Id, message, sizeof(message), NULL, NULL);
+        TestCryptAEAD("ChaCha20-Poly1305", AEAD_MODE_CHACHA20_POLY1305, key256Id, message, sizeof(message), NULL, NULL);
+
+        // ChaCha20 takes 256-bit keys only
+        EXPECT_EQ(cipher_create_aead(vault, AEAD_MODE_CHACHA20_POLY1305, key128Id), NULL);
+
+        EXPECT_NE(vault_delete(vault, key128Id), false);
+        EXPECT_NE(vault_delete(vault, key256Id), false);
+    } else {
+        printf("  FATAL: Failed to store keys to vault, AEAD tests will be skipped\n");
+    }
+}
+
 /*
   ===================================
 */
 
 int main(void)
 {
+    // Split large ECB and CTR operations from 64 KiB on, with a fixed pool so it does not depend on the cores.
+    // Read once, before the first cipher operation.
+    setenv("CRYPTOGRAPHY_CIPHER_PARALLEL_THRESHOLD", "65536", 1);
+    setenv("CRYPTOGRAPHY_CIPHER_WORKERS", "3", 1);
+
     CALL(Signing, Hash);
 
     vault = vault_instance(CRYPTOGRAPHY_VAULT_NETFLIX);
@@ -715,15 +1438,27 @@ int main(void)
         CALL(Vault, Common);
         CALL(Vault, ImportExport);
         CALL(Vault, SetGet); // Will not work on Sage
+        CALL(Vault, Statistics);
+        CALL(Vault, Persistent);
 
         CALL(Signing, Hash);
         CALL(Signing, HMAC);
+        CALL(Signing, ResetCopy);
+        CALL(Signing, HMACBatch);
+        CALL(Signing, HMACMultiBuffer);
 
         CALL(DH, Generate);
         CALL(DH, DeriveStandard); // Will not work on Sage
 
+        CALL(KeyAgreement, X25519);
+        CALL(KeyAgreement, P256);
+
         CALL(Cipher, AES_Padded);
         CALL(Cipher, AES_Unpadded);
+        CALL(Cipher, AES_Parallel);
+        CALL(Cipher, DeletedKey);
+        CALL(Cipher, AESAccelerated);
+        CALL(Cipher, AEAD);
     }
 
     printf("TOTAL: %i tests; %i PASSED, %i FAILED\n", TotalTests, TotalTestsPassed, (TotalTests - TotalTestsPassed));
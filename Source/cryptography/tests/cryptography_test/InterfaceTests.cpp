@@ -18,6 +18,9 @@
  */
 
 #include <climits>
+#include <thread>
+
+#include <poll.h>
 
 #include "Helpers.h"
 #include "Test.h"
@@ -102,6 +105,10 @@ TEST(Hash, Hash)
 
         hashImpl->Release();
 
+        ::memset(output, 0, sizeof(hash_sha256));
+        EXPECT_EQ(cg->Digest(WPEFramework::Cryptography::hashtype::SHA256, sizeof(data) - 1, data, sizeof(hash_sha256), output), sizeof(hash_sha256));
+        EXPECT_EQ(::memcmp(output, hash_sha256, sizeof(hash_sha256)), 0);
+
         delete[] output;
     }
 
@@ -134,6 +141,127 @@ TEST(Hash, Hash)
     }
 }
 
+TEST(Hash, Async)
+{
+    const uint8_t data[] = "Etaoin Shrldu";
+
+    static const uint8_t hash_sha256[] =  { 0x80, 0x72, 0xA8, 0x3C, 0x2C, 0xFB, 0xF3, 0x67, 0xA1, 0x64, 0x1C, 0x22,
+                                            0x03, 0xCD, 0x78, 0x1D, 0x2E, 0x85, 0x13, 0x11, 0x72, 0x7D, 0xCE, 0x8E,
+                                            0xD7, 0x25, 0x51, 0x0F, 0xE1, 0x3B, 0x78, 0x35 };
+
+    static constexpr uint8_t Hashes = 8;
+
+    WPEFramework::Cryptography::IHash* hashImpl[Hashes];
+    uint8_t output[Hashes][sizeof(hash_sha256)];
+    int32_t ingested[Hashes];
+    int32_t calculated[Hashes];
+
+    ::memset(output, 0, sizeof(output));
+
+    for (uint8_t i = 0; i < Hashes; i++) {
+        hashImpl[i] = cg->Hash(WPEFramework::Cryptography::hashtype::SHA256);
+        EXPECT_NE(hashImpl[i], nullptr);
+    }
+
+    {
+        // Leaving the scope runs all operations still queued.
+        WPEFramework::Cryptography::AsyncCryptography async(4);
+
+        for (uint8_t i = 0; i < Hashes; i++) {
+            if (hashImpl[i] != nullptr) {
+                // Ingest and Calculate on the same hash must complete in the order submitted
+                async.Ingest(hashImpl[i], sizeof(data) - 1, data, [&ingested, i](const int32_t result) { ingested[i] = result; });
+                async.Calculate(hashImpl[i], sizeof(hash_sha256), output[i], [&calculated, i](const int32_t result) { calculated[i] = result; });
+            }
+        }
+    }
+
+    for (uint8_t i = 0; i < Hashes; i++) {
+        if (hashImpl[i] != nullptr) {
+            EXPECT_EQ(ingested[i], static_cast<int32_t>(sizeof(data) - 1));
+            EXPECT_EQ(calculated[i], static_cast<int32_t>(sizeof(hash_sha256)));
+            EXPECT_EQ(::memcmp(output[i], hash_sha256, sizeof(hash_sha256)), 0);
+
+            hashImpl[i]->Release();
+        }
+    }
+}
+
+TEST(Hash, AsyncDeferred)
+{
+    const uint8_t data[] = "Etaoin Shrldu";
+
+    static const uint8_t hash_sha256[] =  { 0x80, 0x72, 0xA8, 0x3C, 0x2C, 0xFB, 0xF3, 0x67, 0xA1, 0x64, 0x1C, 0x22,
+                                            0x03, 0xCD, 0x78, 0x1D, 0x2E, 0x85, 0x13, 0x11, 0x72, 0x7D, 0xCE, 0x8E,
+                                            0xD7, 0x25, 0x51, 0x0F, 0xE1, 0x3B, 0x78, 0x35 };
+
+    static constexpr uint8_t Hashes = 8;
+
+    WPEFramework::Cryptography::IHash* hashImpl[Hashes];
+    uint8_t output[Hashes][sizeof(hash_sha256)];
+    uint8_t order[Hashes];
+    uint32_t expected = 0;
+    uint32_t called = 0;
+    uint32_t foreign = 0;
+
+    ::memset(output, 0, sizeof(output));
+    ::memset(order, 0, sizeof(order));
+
+    const std::thread::id self = std::this_thread::get_id();
+
+    WPEFramework::Cryptography::AsyncCryptography async(4, true);
+    EXPECT_NE(async.Descriptor(), -1);
+
+    for (uint8_t i = 0; i < Hashes; i++) {
+        hashImpl[i] = cg->Hash(WPEFramework::Cryptography::hashtype::SHA256);
+        EXPECT_NE(hashImpl[i], nullptr);
+
+        if (hashImpl[i] != nullptr) {
+            // Completions only run in Dispatch(), on this thread, in the order submitted per hash
+            async.Ingest(hashImpl[i], sizeof(data) - 1, data, [&, i](const int32_t result) {
+                foreign += (std::this_thread::get_id() != self ? 1 : 0);
+                order[i] = ((order[i] * 10) + (result == static_cast<int32_t>(sizeof(data) - 1) ? 1 : 9));
+                called++;
+            });
+            async.Calculate(hashImpl[i], sizeof(hash_sha256), output[i], [&, i](const int32_t result) {
+                foreign += (std::this_thread::get_id() != self ? 1 : 0);
+                order[i] = ((order[i] * 10) + (result == static_cast<int32_t>(sizeof(hash_sha256)) ? 2 : 9));
+                called++;
+            });
+            expected += 2;
+        }
+    }
+
+    EXPECT_EQ(called, 0);
+
+    uint32_t dispatched = 0;
+    uint8_t timeouts = 0;
+
+    while ((dispatched < expected) && (timeouts < 10)) {
+        struct pollfd descriptor = { async.Descriptor(), POLLIN, 0 };
+
+        if (::poll(&descriptor, 1, 1000) > 0) {
+            EXPECT_NE((descriptor.revents & POLLIN), 0);
+            dispatched += async.Dispatch();
+        } else {
+            timeouts++;
+        }
+    }
+
+    EXPECT_EQ(dispatched, expected);
+    EXPECT_EQ(called, expected);
+    EXPECT_EQ(foreign, 0);
+
+    for (uint8_t i = 0; i < Hashes; i++) {
+        if (hashImpl[i] != nullptr) {
+            EXPECT_EQ(order[i], 12);
+            EXPECT_EQ(::memcmp(output[i], hash_sha256, sizeof(hash_sha256)), 0);
+
+            hashImpl[i]->Release();
+        }
+    }
+}
+
 TEST(Hash, HMAC)
 {
     static const uint8_t data[] = "Etaoin Shrldu";
@@ -160,6 +288,10 @@ TEST(Hash, HMAC)
 
             hashImpl->Release();
 
+            ::memset(output, 0, 128);
+            EXPECT_EQ(vault->Sign(WPEFramework::Cryptography::hashtype::SHA256, keyId, sizeof(data) - 1, data, 128, output), sizeof(hash_sha256));
+            EXPECT_EQ(::memcmp(output, hash_sha256, sizeof(hash_sha256)), 0);
+
             delete[] output;
 
             EXPECT_NE(vault->Delete(keyId), false);
@@ -171,6 +303,94 @@ TEST(Hash, HMAC)
 }
 
 
+TEST(Hash, ResetCopy)
+{
+    static const uint8_t data[] = "Etaoin Shrldu";
+    static const uint8_t password[] = "Thunder";
+    static const uint32_t length = (sizeof(data) - 1);
+
+    static const uint8_t hash_sha256[] =  { 0x2D, 0xF5, 0x9C, 0xBE, 0x61, 0x59, 0x7F, 0x14, 0xEC, 0xD2, 0x85, 0x6F,
+	                                        0xAB, 0xF1, 0x12, 0xFC, 0xF4, 0x68, 0x6D, 0xFE, 0x93, 0x5F, 0xDB, 0xB7,
+	                                        0x34, 0x8C, 0x6C, 0x6B, 0xF1, 0x64, 0xE9, 0x27 };
+
+    uint32_t keyId = vault->Import(sizeof(password) - 1, password);
+    EXPECT_NE(keyId, 0);
+    if (keyId != 0) {
+        WPEFramework::Cryptography::IHash* hashImpl = vault->HMAC(WPEFramework::Cryptography::hashtype::SHA256, keyId);
+        EXPECT_NE(hashImpl, nullptr);
+        if (hashImpl != nullptr) {
+            uint8_t output[sizeof(hash_sha256)];
+
+            for (uint8_t round = 0; round < 2; round++) {
+                ::memset(output, 0, sizeof(output));
+                EXPECT_EQ(hashImpl->Reset(), WPEFramework::Core::ERROR_NONE);
+                EXPECT_EQ(hashImpl->Ingest(length, data), length);
+                EXPECT_EQ(hashImpl->Calculate(sizeof(output), output), sizeof(hash_sha256));
+                EXPECT_EQ(::memcmp(output, hash_sha256, sizeof(hash_sha256)), 0);
+            }
+
+            EXPECT_EQ(hashImpl->Reset(), WPEFramework::Core::ERROR_NONE);
+            EXPECT_EQ(hashImpl->Ingest(length/2, data), length/2);
+
+            WPEFramework::Cryptography::IHash* copyImpl = hashImpl->Copy();
+            if (copyImpl != nullptr) {
+                ::memset(output, 0, sizeof(output));
+                EXPECT_EQ(copyImpl->Ingest(length - length/2, data + length/2), length - length/2);
+                EXPECT_EQ(copyImpl->Calculate(sizeof(output), output), sizeof(hash_sha256));
+                EXPECT_EQ(::memcmp(output, hash_sha256, sizeof(hash_sha256)), 0);
+                copyImpl->Release();
+            } else {
+                printf("Copying a running HMAC calculation is not supported by this implementation\n");
+            }
+
+            ::memset(output, 0, sizeof(output));
+            EXPECT_EQ(hashImpl->Ingest(length - length/2, data + length/2), length - length/2);
+            EXPECT_EQ(hashImpl->Calculate(sizeof(output), output), sizeof(hash_sha256));
+            EXPECT_EQ(::memcmp(output, hash_sha256, sizeof(hash_sha256)), 0);
+
+            hashImpl->Release();
+        }
+
+        EXPECT_NE(vault->Delete(keyId), false);
+    } else {
+        printf("FATAL: Failed to put key into vault, reset/copy tests can't be performed\n");
+    }
+}
+
+
+TEST(Hash, HMACBatch)
+{
+    static const uint8_t data[] = "Etaoin ShrlduLook behind you, a Three-Headed Monkey!Thunder";
+    static const uint32_t lengths[] = { 13, 39, 0, 7 };
+    static const uint16_t count = (sizeof(lengths) / sizeof(lengths[0]));
+    static const uint8_t password[] = "Thunder";
+
+    uint32_t keyId = vault->Import(sizeof(password) - 1, password);
+    EXPECT_NE(keyId, 0);
+    if (keyId != 0) {
+        uint8_t hmacs[count * WPEFramework::Cryptography::hashtype::SHA256];
+        uint8_t results[count];
+
+        ::memset(hmacs, 0, sizeof(hmacs));
+        EXPECT_EQ(vault->SignBatch(WPEFramework::Cryptography::hashtype::SHA256, keyId, count, lengths, sizeof(data) - 1, data, sizeof(hmacs), hmacs), count);
+
+        ::memset(results, 0, sizeof(results));
+        EXPECT_EQ(vault->VerifyBatch(WPEFramework::Cryptography::hashtype::SHA256, keyId, count, lengths, sizeof(data) - 1, data, sizeof(hmacs), hmacs, results), count);
+        EXPECT_EQ(results[0] & results[1] & results[2] & results[3], 1);
+
+        hmacs[WPEFramework::Cryptography::hashtype::SHA256 + 1] ^= 0x01;
+
+        ::memset(results, 0, sizeof(results));
+        EXPECT_EQ(vault->VerifyBatch(WPEFramework::Cryptography::hashtype::SHA256, keyId, count, lengths, sizeof(data) - 1, data, sizeof(hmacs), hmacs, results), (count - 1));
+        EXPECT_EQ(results[1], 0);
+
+        EXPECT_NE(vault->Delete(keyId), false);
+    } else {
+        printf("FATAL: Failed to put key into vault, HMAC batch tests can't be performed\n");
+    }
+}
+
+
 TEST(Cipher, AES)
 {
     const uint8_t data[] = "Look behind you, a Three-Headed Monkey!";
@@ -306,7 +526,11 @@ int main()
             CALL(Vault, SetGet); // Will not work on Sage
 
             CALL(Hash, Hash);
+            CALL(Hash, Async);
+            CALL(Hash, AsyncDeferred);
             CALL(Hash, HMAC);
+            CALL(Hash, ResetCopy);
+            CALL(Hash, HMACBatch);
 
             CALL(Cipher, AES);
 
@@ -22,6 +22,7 @@
 #include <cryptography.h>
 #include <core/core.h>
 #include <string.h>
+#include <stdlib.h>
 #include <climits>
 
 #include <openssl/sha.h>
@@ -256,8 +257,78 @@ TEST(NetflixSecurity, AuthenticatedDerive)
     EXPECT_EQ(vault->Delete(teePskKeyId), true);
 }
 
+TEST(NetflixSecurity, DerivedKeyCache)
+{
+    // Same group as the authenticated derive test
+    static const uint32_t generator = 5;
+    static const uint8_t prime1024[128] = {
+        0x96, 0x94, 0xe9, 0xd8, 0xd9, 0x3a, 0x5a, 0xc7, 0x4c, 0x50, 0x9b, 0x4b, 0xbc, 0xe8, 0x5e, 0x92,
+        0x13, 0x2c, 0xd1, 0x9c, 0xce, 0x47, 0x7d, 0x1a, 0x7e, 0x47, 0xd5, 0x27, 0xd9, 0xec, 0x29, 0x15,
+        0x15, 0xf0, 0xb8, 0xb3, 0xe1, 0xea, 0xed, 0x50, 0x06, 0xe1, 0xb1, 0xb9, 0x1e, 0xa2, 0x5b, 0x91,
+        0xa0, 0x1b, 0x10, 0xe2, 0xe8, 0x34, 0xb8, 0xd6, 0x60, 0xb2, 0xe3, 0x21, 0xad, 0x64, 0x4c, 0xe1,
+        0xa8, 0x3b, 0x32, 0x8d, 0x90, 0x14, 0xee, 0x7e, 0x16, 0xf1, 0xe4, 0x4f, 0xfe, 0x89, 0x57, 0x9a,
+        0xc3, 0xee, 0x47, 0xd6, 0x68, 0xb6, 0xb7, 0x66, 0x87, 0xc2, 0xfe, 0x90, 0xa3, 0x5b, 0x5e, 0x60,
+        0x28, 0xfd, 0x04, 0xef, 0xea, 0x88, 0x23, 0x73, 0xec, 0xf6, 0x0b, 0xa2, 0xf6, 0x37, 0xe4, 0xcd,
+        0xaa, 0x1b, 0x60, 0x89, 0xd6, 0xc0, 0xb5, 0x61, 0xa8, 0xe5, 0x20, 0xe7, 0x96, 0xde, 0x27, 0xdf
+    };
+    static const uint8_t psk[16] = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff, 0x11 };
+
+    WPEFramework::Cryptography::IDiffieHellman* idh = vault->DiffieHellman();
+    EXPECT_NE(idh, nullptr);
+
+    if (idh != nullptr) {
+        uint32_t pskKeyId = vault->Import(sizeof(psk), psk);
+        uint32_t hostPrivKeyId = 0;
+        uint32_t hostPubKeyId = 0;
+        uint32_t teePrivKeyId = 0;
+        uint32_t teePubKeyId = 0;
+
+        // Only the public key of the peer matters here, so let the vault generate that side as well
+        EXPECT_NE(pskKeyId, 0);
+        EXPECT_EQ(idh->Generate(generator, sizeof(prime1024), prime1024, hostPrivKeyId, hostPubKeyId), 0);
+        EXPECT_EQ(idh->Generate(generator, sizeof(prime1024), prime1024, teePrivKeyId, teePubKeyId), 0);
+
+        uint32_t encKeyId[3] = { 0 };
+        uint32_t hmacKeyId[3] = { 0 };
+        uint32_t wrapKeyId[3] = { 0 };
+
+        printf("> Testing a cache hit\n");
+        EXPECT_EQ(nfSecurity->DeriveKeys(teePrivKeyId, hostPubKeyId, pskKeyId, encKeyId[0], hmacKeyId[0], wrapKeyId[0]), 0);
+        EXPECT_NE(encKeyId[0], 0);
+        EXPECT_EQ(nfSecurity->DeriveKeys(teePrivKeyId, hostPubKeyId, pskKeyId, encKeyId[1], hmacKeyId[1], wrapKeyId[1]), 0);
+        EXPECT_EQ(encKeyId[1], encKeyId[0]);
+        EXPECT_EQ(hmacKeyId[1], hmacKeyId[0]);
+        EXPECT_EQ(wrapKeyId[1], wrapKeyId[0]);
+
+        printf("> Testing the invalidation by a vault delete\n");
+        EXPECT_EQ(vault->Delete(encKeyId[0]), true);
+        EXPECT_EQ(nfSecurity->DeriveKeys(teePrivKeyId, hostPubKeyId, pskKeyId, encKeyId[2], hmacKeyId[2], wrapKeyId[2]), 0);
+        EXPECT_NE(encKeyId[2], 0);
+        EXPECT_NE(encKeyId[2], encKeyId[0]);
+        EXPECT_NE(hmacKeyId[2], hmacKeyId[0]);
+        EXPECT_NE(wrapKeyId[2], wrapKeyId[0]);
+        EXPECT_EQ(vault->Size(encKeyId[2]), USHRT_MAX);
+
+        vault->Delete(hmacKeyId[0]);
+        vault->Delete(wrapKeyId[0]);
+        vault->Delete(encKeyId[2]);
+        vault->Delete(hmacKeyId[2]);
+        vault->Delete(wrapKeyId[2]);
+        vault->Delete(teePrivKeyId);
+        vault->Delete(teePubKeyId);
+        vault->Delete(hostPrivKeyId);
+        vault->Delete(hostPubKeyId);
+        vault->Delete(pskKeyId);
+
+        idh->Release();
+    }
+}
+
 int main()
 {
+    // Read once, on the first key derivation
+    setenv("CRYPTOGRAPHY_DERIVED_KEY_CACHE", "4", 1);
+
     nfSecurity = WPEFramework::Cryptography::INetflixSecurity::Instance();
     if (nfSecurity != nullptr) {
         CALL(NetflixSecurity, Security);
@@ -267,6 +338,7 @@ int main()
             vault = cg->Vault(CRYPTOGRAPHY_VAULT_NETFLIX);
             if (vault != nullptr) {
                 CALL(NetflixSecurity, AuthenticatedDerive);
+                CALL(NetflixSecurity, DerivedKeyCache);
                 vault->Release();
             } else {
                 printf("FATAL: Failed to acquire IVault\n");
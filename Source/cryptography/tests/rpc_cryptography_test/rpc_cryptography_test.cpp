@@ -6,6 +6,10 @@
 
 #include <cryptography.h>
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
 namespace Thunder = WPEFramework;
 
 static constexpr uint32_t TimeOut = 1000; //Thunder::Core::infinite;
@@ -493,6 +497,70 @@ TEST_F(BasicTest, VaultAESEncryptDecrypt)
     }
 }
 
+TEST_F(BasicTest, VaultAESEncryptDecryptConcurrent)
+{
+    static constexpr uint8_t Workers = 4;
+    static constexpr uint16_t Iterations = 100;
+
+    ASSERT_EQ(controller.ActivatePlugin(TestData::plugin), Thunder::Core::ERROR_NONE);
+    ASSERT_TRUE(controller.IsPluginActive(TestData::plugin));
+    ASSERT_NE(nullptr, cryptography);
+
+    Thunder::Cryptography::IVault* vault = cryptography->Vault(CRYPTOGRAPHY_VAULT_PLATFORM);
+
+    ASSERT_NE(nullptr, vault);
+
+    uint32_t keyId = vault->Import(sizeof(TestData::cipherkey), TestData::cipherkey);
+
+    Thunder::Cryptography::ICipher* iface = vault->AES(Thunder::Cryptography::CBC, keyId);
+
+    ASSERT_NE(nullptr, iface);
+
+    std::atomic<uint32_t> failures(0);
+    std::vector<std::thread> workers;
+
+    for (uint8_t worker = 0; worker < Workers; worker++) {
+        workers.emplace_back([&iface, &failures]() {
+            uint8_t encryptBuffer[128];
+            uint8_t clearBuffer[128];
+
+            for (uint16_t i = 0; i < Iterations; i++) {
+                memset(clearBuffer, 0x00, sizeof(clearBuffer));
+
+                int32_t encryptedSize = iface->Encrypt(
+                    sizeof(TestData::cipherkey), TestData::cipherkey,
+                    sizeof(TestData::data), reinterpret_cast<const uint8_t*>(TestData::data),
+                    sizeof(encryptBuffer), encryptBuffer);
+
+                int32_t clearSize = iface->Decrypt(
+                    sizeof(TestData::cipherkey), TestData::cipherkey,
+                    encryptedSize, encryptBuffer,
+                    sizeof(clearBuffer), clearBuffer);
+
+                if ((encryptedSize != 64) || (clearSize != sizeof(TestData::data)) || (memcmp(clearBuffer, TestData::data, sizeof(TestData::data)) != 0)) {
+                    failures++;
+                }
+            }
+        });
+    }
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    EXPECT_EQ(failures.load(), 0);
+
+    if (iface != nullptr) {
+        iface->Release();
+        iface = nullptr;
+    }
+
+    if (vault != nullptr) {
+        vault->Release();
+        vault = nullptr;
+    }
+}
+
 TEST_F(BasicTest, VaultAESEncryptDecryptDisablePlugin)
 {
     uint8_t encryptBuffer[128];
@@ -585,6 +653,59 @@ TEST_F(BasicTest, HashSHA1Calculate)
     }
 }
 
+TEST_F(BasicTest, HashSHA1CalculateChunked)
+{
+    uint8_t exportBuffer[Thunder::Cryptography::SHA1];
+    uint8_t copyBuffer[Thunder::Cryptography::SHA1];
+    memset(exportBuffer, 0, sizeof(exportBuffer));
+    memset(copyBuffer, 0, sizeof(copyBuffer));
+
+    ASSERT_EQ(controller.ActivatePlugin(TestData::plugin), Thunder::Core::ERROR_NONE);
+    ASSERT_TRUE(controller.IsPluginActive(TestData::plugin));
+    ASSERT_NE(nullptr, cryptography);
+
+    Thunder::Cryptography::IHash* hash = cryptography->Hash(Thunder::Cryptography::SHA1);
+
+    ASSERT_NE(nullptr, hash);
+
+    // Chunks smaller than the ingest buffer are collected client side and have to arrive complete and in order
+    for (uint32_t index = 0; index < sizeof(TestData::data); index++) {
+        EXPECT_EQ(hash->Ingest(1, reinterpret_cast<const uint8_t*>(TestData::data) + index), 1);
+    }
+
+    Thunder::Cryptography::IHash* copy = hash->Copy();
+
+    EXPECT_EQ(hash->Calculate(sizeof(exportBuffer), exportBuffer), Thunder::Cryptography::SHA1);
+
+    EXPECT_TRUE(ArraysMatch(exportBuffer, TestData::expectedSHA1HashOfData));
+
+    ASSERT_NE(nullptr, copy);
+
+    EXPECT_EQ(copy->Calculate(sizeof(copyBuffer), copyBuffer), Thunder::Cryptography::SHA1);
+
+    EXPECT_TRUE(ArraysMatch(copyBuffer, TestData::expectedSHA1HashOfData));
+
+    copy->Release();
+    hash->Release();
+}
+
+TEST_F(BasicTest, HashSHA1Digest)
+{
+    uint8_t exportBuffer[Thunder::Cryptography::SHA1];
+    memset(exportBuffer, 0, sizeof(exportBuffer));
+
+    ASSERT_EQ(controller.ActivatePlugin(TestData::plugin), Thunder::Core::ERROR_NONE);
+    ASSERT_TRUE(controller.IsPluginActive(TestData::plugin));
+    ASSERT_NE(nullptr, cryptography);
+
+    EXPECT_EQ(cryptography->Digest(Thunder::Cryptography::SHA1,
+                  sizeof(TestData::data), reinterpret_cast<const uint8_t*>(TestData::data),
+                  sizeof(exportBuffer), exportBuffer),
+        Thunder::Cryptography::SHA1);
+
+    EXPECT_TRUE(ArraysMatch(exportBuffer, TestData::expectedSHA1HashOfData));
+}
+
 TEST_F(BasicTest, HashSHA1CalculateDeactivate)
 {
     uint8_t exportBuffer[Thunder::Cryptography::SHA1];
@@ -654,6 +775,51 @@ TEST_F(BasicTest, HashSHA1CalculateDeactivateAndRecover)
     }
 }
 
+TEST_F(BasicTest, HybridHashIsLocal)
+{
+    uint8_t exportBuffer[Thunder::Cryptography::SHA1];
+    memset(exportBuffer, 0, sizeof(exportBuffer));
+
+    ASSERT_EQ(controller.ActivatePlugin(TestData::plugin), Thunder::Core::ERROR_NONE);
+    ASSERT_TRUE(controller.IsPluginActive(TestData::plugin));
+
+    Thunder::Cryptography::ICryptography* hybrid = Thunder::Cryptography::ICryptography::Instance(TestData::nodeId, true);
+
+    ASSERT_NE(nullptr, hybrid);
+
+    Thunder::Cryptography::IVault* vault = hybrid->Vault(CRYPTOGRAPHY_VAULT_PLATFORM);
+
+    EXPECT_NE(nullptr, vault);
+
+    Thunder::Cryptography::IHash* hash = hybrid->Hash(Thunder::Cryptography::SHA1);
+
+    ASSERT_NE(nullptr, hash);
+
+    EXPECT_EQ(hash->Ingest(sizeof(TestData::data), reinterpret_cast<const uint8_t*>(TestData::data)), sizeof(TestData::data));
+
+    // Hashing does not depend on the plugin, so it survives its deactivation
+    EXPECT_EQ(controller.DeactivatePlugin(TestData::plugin), Thunder::Core::ERROR_NONE);
+
+    EXPECT_EQ(hash->Calculate(sizeof(exportBuffer), exportBuffer), Thunder::Cryptography::SHA1);
+
+    EXPECT_TRUE(ArraysMatch(exportBuffer, TestData::expectedSHA1HashOfData));
+
+    EXPECT_EQ(hybrid->Digest(Thunder::Cryptography::SHA1,
+                  sizeof(TestData::data), reinterpret_cast<const uint8_t*>(TestData::data),
+                  sizeof(exportBuffer), exportBuffer),
+        Thunder::Cryptography::SHA1);
+
+    EXPECT_EQ(controller.ActivatePlugin(TestData::plugin), Thunder::Core::ERROR_NONE);
+
+    hash->Release();
+
+    if (vault != nullptr) {
+        vault->Release();
+    }
+
+    hybrid->Release();
+}
+
 TEST_F(BasicTest, VaultDiffieHellmanDeavtivated)
 {
     ASSERT_EQ(controller.ActivatePlugin(TestData::plugin), Thunder::Core::ERROR_NONE);